@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <ostream>
+#include <cstdint>
+#include <cstddef>
+
+// Apache Arrow IPC stream format for one dictionary-encoded string column, without
+// an Arrow dependency: the FlatBuffers metadata is encoded and decoded by hand.
+//
+// Written streams hold a Schema message (one non-nullable utf8 field, dictionary
+// encoded with int32 indices), one DictionaryBatch with the value arena as the utf8
+// offsets and data buffers, one RecordBatch with the ID column as the indices buffer,
+// and the end-of-stream marker. Body buffers are written straight from the arena and
+// column, each on a 64-byte boundary, so a reader can map the file and use them in place.
+namespace ArrowIpc {
+
+constexpr size_t BUFFER_ALIGNMENT = 64;
+
+// A column as the codec stores it: value id is value_bytes[value_offsets[id], value_offsets[id + 1])
+struct DictionaryColumnView {
+    const uint32_t* value_offsets;  // dict_size + 1 entries
+    const char* value_bytes;
+    size_t dict_size;
+    const uint32_t* ids;
+    size_t num_rows;
+};
+
+// A column read from a stream. Pointers reference the input buffer where its layout
+// already matches (32-bit indices, utf8 offsets starting at 0, aligned buffers) and
+// the owned vectors otherwise
+struct DictionaryColumn {
+    std::string name;
+    const uint32_t* value_offsets = nullptr;
+    const char* value_bytes = nullptr;
+    size_t dict_size = 0;
+    size_t value_bytes_length = 0;
+    const uint32_t* ids = nullptr;
+    size_t num_rows = 0;
+    std::vector<uint32_t> owned_offsets;
+    std::vector<uint32_t> owned_ids;
+};
+
+void writeDictionaryStream(std::ostream& out, const std::string& name, const DictionaryColumnView& column);
+
+// Parses a stream whose only field is a dictionary-encoded utf8 or binary column with
+// integer indices. Accepts several record batches (concatenated into owned_ids) but
+// not nulls, delta or replacement dictionaries, or compressed bodies; indices are
+// checked against the dictionary. Throws std::runtime_error on anything else
+DictionaryColumn readDictionaryStream(const uint8_t* data, size_t size);
+
+}  // namespace ArrowIpc
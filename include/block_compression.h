@@ -0,0 +1,139 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <istream>
+#include <cstdint>
+#include <cstddef>
+
+// Block-compressed ID column used by saveToFile/loadFromFile. The column is cut
+// into independent zstd frames of block_rows IDs, so blocks compress and decompress
+// in parallel and a reader can fetch any single block through the block index.
+// Before compression each block goes through the lightweight filter that compresses
+// a sample of it best; filters are undone with AVX2 on load.
+//
+// File layout (host byte order):
+//   ColumnFileHeader
+//   dictionary section at dictionary_offset (see DictionarySectionHeader)
+//   BlockRef[num_blocks] at index_offset
+//   BlockZone[num_blocks] right after the index
+//   compressed blocks, back to back, at data_offset; each one is a FrameHeader
+//   followed by the zstd frame
+namespace BlockCompression {
+
+constexpr char FILE_MAGIC[8] = {'D', 'C', 'B', 'L', 'O', 'C', 'K', '\0'};
+constexpr uint32_t FILE_VERSION = 1;
+constexpr size_t DEFAULT_BLOCK_ROWS = 1 << 18;  // 1 MB of IDs per frame
+constexpr int DEFAULT_LEVEL = 3;
+
+struct ColumnFileHeader {
+    char magic[8];
+    uint32_t version;
+    int32_t level;
+    uint64_t dict_size;
+    uint64_t num_rows;
+    uint64_t block_rows;
+    uint64_t num_blocks;
+    uint64_t dictionary_offset;
+    uint64_t index_offset;
+    uint64_t data_offset;
+};
+
+// Pre-compression transforms. All but None end with a byte-plane shuffle, which
+// groups the mostly-zero high bytes of the IDs into long runs
+enum class BlockFilter : uint8_t {
+    None,
+    ByteShuffle,
+    FrameOfReference,  // Subtract the block minimum, then shuffle
+    Delta              // Zigzag deltas between neighbours, then shuffle
+};
+
+struct FrameHeader {
+    uint8_t filter;  // BlockFilter
+    uint8_t reserved[3];
+    uint32_t reference;  // Block minimum for FrameOfReference
+};
+
+// Compressed frame location, relative to data_offset
+struct BlockRef {
+    uint64_t offset;
+    uint64_t length;
+};
+
+// Smallest and largest ID in a block; a scan skips blocks whose range holds none of its IDs
+struct BlockZone {
+    uint32_t min_id;
+    uint32_t max_id;
+};
+
+// Dictionary section: values sorted and front-coded in blocks of block_entries,
+// with a full value every restart_interval entries. Each block is a zstd frame,
+// compressed against a trained zstd dictionary when that comes out smaller.
+//   DictionarySectionHeader
+//   trained zstd dictionary (zdict_length bytes)
+//   zstd frame of uint32_t IDs by sorted position (permutation_length bytes, 0 if
+//   IDs already follow value order)
+//   BlockRef[num_blocks], relative to the end of the index
+//   compressed blocks
+// A decompressed block is uint32_t restart offsets[ceil(entries / restart_interval)]
+// followed by the entries; each is varint shared prefix length, varint suffix
+// length and the suffix bytes, the shared length being 0 at restart points.
+struct DictionarySectionHeader {
+    uint64_t num_entries;
+    uint64_t num_blocks;
+    uint32_t block_entries;
+    uint32_t restart_interval;
+    uint64_t zdict_length;
+    uint64_t permutation_length;
+};
+
+constexpr uint32_t DICTIONARY_BLOCK_ENTRIES = 1024;
+constexpr uint32_t DICTIONARY_RESTART_INTERVAL = 16;
+
+inline size_t blockCount(size_t num_rows, size_t block_rows) {
+    return (num_rows + block_rows - 1) / block_rows;
+}
+
+// Compresses ids into one frame per block; num_threads = 0 uses all cores.
+// With choose_filters off every block is stored unfiltered
+void compressBlocks(const uint32_t* ids, size_t num_rows, size_t block_rows, int level, int num_threads,
+                    std::vector<std::vector<uint8_t>>& frames, bool choose_filters = true);
+
+// Decompresses every block of payload (the bytes starting at header.data_offset) into out[num_rows]
+void decompressBlocks(const uint8_t* payload, const std::vector<BlockRef>& blocks,
+                      const ColumnFileHeader& header, uint32_t* out, int num_threads);
+
+// Decompresses one frame holding exactly `rows` IDs
+void decompressBlock(const uint8_t* frame, size_t length, uint32_t* out, size_t rows);
+
+// Picks the filter whose output compresses a sample of the block best
+BlockFilter chooseFilter(const uint32_t* ids, size_t rows, uint32_t reference);
+
+std::vector<BlockZone> buildZoneMap(const uint32_t* ids, size_t num_rows, size_t block_rows, int num_threads);
+
+// Encodes values (indexed by ID) as a dictionary section; num_threads = 0 uses all cores
+std::vector<uint8_t> encodeDictionary(const std::vector<std::string_view>& values, int level, int num_threads);
+
+// Decodes a dictionary section into values indexed by ID, decompressing blocks in parallel
+void decodeDictionary(const uint8_t* section, size_t length, int num_threads, std::vector<std::string>& values);
+
+// Reads the header; returns false (stream rewound) for files without the block magic
+bool readHeader(std::istream& in, ColumnFileHeader& header);
+// Throws unless every ref lies inside the payload (header.data_offset to the end of the file)
+std::vector<BlockRef> readBlockIndex(std::istream& in, const ColumnFileHeader& header);
+// Bytes of payload the refs span
+size_t payloadLength(const std::vector<BlockRef>& blocks);
+std::vector<BlockZone> readZoneMap(std::istream& in, const ColumnFileHeader& header);
+
+// Reads the dictionary of a block file into values indexed by ID
+void readDictionary(std::istream& in, const ColumnFileHeader& header, std::vector<std::string>& values);
+// Reads dict_size plain {size_t length, bytes, uint32_t id} entries from the current position,
+// as in files written before block compression
+void readDictionaryEntries(std::istream& in, size_t dict_size, std::vector<std::string>& values);
+
+// Fetches and decompresses a single block; returns the number of rows it holds
+size_t readBlock(std::istream& in, const ColumnFileHeader& header, const std::vector<BlockRef>& blocks,
+                 size_t block, std::vector<uint32_t>& ids);
+
+}  // namespace BlockCompression
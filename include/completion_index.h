@@ -0,0 +1,55 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Read-only view of a string arena: value id is bytes[offsets[id], offsets[id + 1])
+struct StringArenaView {
+    const uint32_t* offsets;
+    const char* bytes;
+
+    std::string_view operator[](uint32_t id) const {
+        return std::string_view(bytes + offsets[id], offsets[id + 1] - offsets[id]);
+    }
+};
+
+// Prefix-ordered view of the dictionary for frequency-ranked autocompletion.
+// Values are sorted so every prefix maps to one contiguous range, and a segment
+// tree over fixed-size blocks of that order keeps the most frequent IDs per node.
+// A query merges O(log n) short lists plus two partial blocks; rows are never read.
+//
+// The index keeps IDs only, so it stays usable after the arena it was built from has
+// grown or moved: queries pass the current arena, which must still map every indexed
+// ID to the same value.
+class CompletionIndex {
+private:
+    std::vector<size_t> frequencies;   // Snapshot the ranking was built from
+    std::vector<uint32_t> sorted_ids;  // IDs with non-zero frequency, in value order
+    std::vector<std::vector<uint32_t>> node_top;  // Per tree node, best first
+    size_t num_leaves;
+    size_t version;
+
+    bool ranksBefore(uint32_t a, uint32_t b) const {
+        return frequencies[a] != frequencies[b] ? frequencies[a] > frequencies[b] : a < b;
+    }
+    void mergeTop(const std::vector<uint32_t>& left, const std::vector<uint32_t>& right,
+                  std::vector<uint32_t>& out) const;
+
+public:
+    static constexpr size_t BLOCK_SIZE = 64;
+    static constexpr size_t NODE_TOP_K = 16;
+
+    // Only the first `count` IDs are indexed
+    CompletionIndex(StringArenaView values, size_t count, const std::vector<size_t>& frequencies,
+                    size_t version);
+
+    // IDs of the k most frequent values starting with `prefix`, most frequent first.
+    // k is capped at NODE_TOP_K, the longest list a node keeps
+    std::vector<uint32_t> complete(StringArenaView values, const std::string& prefix, size_t k) const;
+
+    size_t getFrequency(uint32_t id) const { return frequencies[id]; }
+    size_t getVersion() const { return version; }
+};
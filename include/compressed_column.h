@@ -0,0 +1,101 @@
+#pragma once
+
+#include "block_compression.h"
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <list>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <limits>
+#include <cstdint>
+#include <cstddef>
+
+// Read-only view of a saveToFile column that queries the compressed blocks in place,
+// for columns larger than memory. Only the dictionary is loaded up front; blocks are
+// read with pread and decompressed on demand into a byte-bounded LRU cache. Zone maps
+// (min/max ID per block) skip blocks that cannot match, and a background thread
+// decompresses the next candidate blocks ahead of the scan. Queries are thread-safe;
+// concurrent scans share the cache.
+class CompressedColumnReader {
+private:
+    using Block = std::shared_ptr<const std::vector<uint32_t>>;
+
+    struct CachedBlock {
+        Block ids;
+        std::list<size_t>::iterator lru;
+    };
+
+    int fd;
+    BlockCompression::ColumnFileHeader header;
+    std::vector<BlockCompression::BlockRef> blocks;
+    std::vector<BlockCompression::BlockZone> zones;
+    std::vector<std::string> values;
+    std::unordered_map<std::string, uint32_t> value_ids;
+
+    // Block cache: most recently used at the front of lru
+    std::unordered_map<size_t, CachedBlock> cache;
+    std::list<size_t> lru;
+    std::unordered_set<size_t> loading;  // Blocks being decompressed by some thread
+    size_t cache_bytes;
+    size_t max_cache_bytes;
+    size_t prefetch_depth;
+
+    std::deque<size_t> prefetch_queue;
+    bool stopping;
+    std::thread prefetcher;
+
+    size_t hits;
+    size_t misses;
+    size_t prefetched;
+    size_t blocks_skipped;
+
+    mutable std::mutex mutex;
+    std::condition_variable loaded_cv;
+    std::condition_variable prefetch_cv;
+
+    Block getBlock(size_t block);
+    Block loadBlock(size_t block, std::unique_lock<std::mutex>& lock);
+    void prefetchLoop();
+    void collectPrefixIds(const std::string& prefix, std::vector<uint32_t>& ids) const;
+
+    // Calls visit(data, begin, end, first_row) on every block of [begin_row, end_row)
+    // that may hold one of the sorted ids; rows are block-relative
+    template <typename Visit>
+    void scanBlocks(const std::vector<uint32_t>& ids, size_t begin_row, size_t end_row, Visit&& visit);
+    size_t countIds(const std::vector<uint32_t>& ids, size_t begin_row, size_t end_row);
+    std::vector<size_t> findIds(const std::vector<uint32_t>& ids, size_t begin_row, size_t end_row);
+
+public:
+    static constexpr size_t DEFAULT_CACHE_BYTES = 256 << 20;
+    static constexpr size_t DEFAULT_PREFETCH_DEPTH = 2;
+    static constexpr size_t ALL_ROWS = std::numeric_limits<size_t>::max();
+
+    explicit CompressedColumnReader(const std::string& filename, size_t max_cache_bytes = DEFAULT_CACHE_BYTES,
+                                    size_t prefetch_depth = DEFAULT_PREFETCH_DEPTH);
+    ~CompressedColumnReader();
+
+    CompressedColumnReader(const CompressedColumnReader&) = delete;
+    CompressedColumnReader& operator=(const CompressedColumnReader&) = delete;
+
+    // Same semantics as the DictionaryCodec queries over the rows [begin_row, end_row)
+    std::vector<size_t> findMatches(const std::string& target, size_t begin_row = 0, size_t end_row = ALL_ROWS);
+    size_t countMatches(const std::string& target, size_t begin_row = 0, size_t end_row = ALL_ROWS);
+    std::vector<size_t> prefixMatches(const std::string& prefix, size_t begin_row = 0, size_t end_row = ALL_ROWS);
+    size_t countPrefix(const std::string& prefix, size_t begin_row = 0, size_t end_row = ALL_ROWS);
+    const std::string& getValue(size_t row);
+
+    // Accessor methods
+    size_t getRowCount() const { return header.num_rows; }
+    size_t getDictionarySize() const { return values.size(); }
+    size_t getBlockCount() const { return blocks.size(); }
+    size_t getCachedBytes() const;
+    size_t getCacheHits() const;
+    size_t getCacheMisses() const;
+    size_t getBlocksPrefetched() const;
+    size_t getBlocksSkipped() const;
+};
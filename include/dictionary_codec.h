@@ -9,6 +9,21 @@
 #include <thread>
 #include <chrono>
 #include <filesystem>
+#include <string_view>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <atomic>
+#include <future>
+#include <mutex>
+#include "result_set.h"
+#include "result_cache.h"
+#include "prefix_memo.h"
+#include "completion_index.h"
+#include "mapped_vector.h"
+
+class WriteAheadLog;
+struct AppendRecord;
 
 struct QueryMetrics {
     double avg_latency_us;
@@ -25,63 +40,307 @@ struct QueryMetrics {
     }
 };
 
+// Arrow-style string column: value i is data[offsets[i], offsets[i + 1])
+// Reused across calls, so steady-state decodes do not reallocate.
+struct DecodedColumn {
+    std::vector<uint32_t> offsets;
+    std::vector<char> data;
+    
+    size_t size() const { return offsets.empty() ? 0 : offsets.size() - 1; }
+    std::string_view value(size_t i) const {
+        return std::string_view(data.data() + offsets[i], offsets[i + 1] - offsets[i]);
+    }
+    void clear() {
+        offsets.clear();
+        data.clear();
+    }
+};
+
+// Receives matching rows in ascending chunks; return false to stop the scan early.
+// Called with the codec's read lock held and its per-thread scratch buffers in use, so
+// it must not call any codec method: copy the rows out and query after the scan returns.
+using MatchSink = std::function<bool(const uint32_t* rows, size_t count)>;
+
+// Resumable position of a paginated search over the rows [next_row, end_row).
+// A fresh cursor covers the whole column; each page advances next_row past the
+// last returned match, and done is set once the window has been fully scanned.
+struct SearchCursor {
+    size_t next_row = 0;
+    size_t end_row = std::numeric_limits<size_t>::max();
+    bool done = false;
+    
+    SearchCursor() = default;
+    SearchCursor(size_t begin_row, size_t end_row) : next_row(begin_row), end_row(end_row) {}
+};
+
 class DictionaryCodec {
 private:
-    // Dictionary storage
+    // Evaluates many queries against one shared scan of encoded_data
+    friend class SharedScanScheduler;
+    // Resolves and classifies queries on its workers from the frequency table
+    friend class QueryExecutor;
+    
+    // Dictionary storage; the two dictionary containers stay empty while a snapshot is mapped
     std::unordered_map<std::string, uint32_t> dictionary;
     std::vector<std::string> reverse_dictionary;
-    std::vector<uint32_t> encoded_data;
+    MappedVector<uint32_t> encoded_data;
     std::vector<std::string> original_data;
     
+    // Per-ID occurrence counts over encoded_data, kept current by encoding and loading
+    std::vector<size_t> id_frequencies;
+    size_t original_bytes;    // Total length of all encoded rows
+    size_t dictionary_bytes;  // Total length of all distinct values
+    
+    // Contiguous copy of reverse_dictionary for gather-based decoding:
+    // value id is value_bytes[value_offsets[id], value_offsets[id + 1])
+    MappedVector<uint32_t> value_offsets;
+    MappedVector<char> value_bytes;
+    
     // Thread safety
     mutable std::shared_mutex mutex;
     
+    // Optional query result cache (null when disabled)
+    std::unique_ptr<ResultCache> result_cache;
+    
+    // Resolved prefix -> ID sets; filled lazily by collectPrefixIds
+    mutable PrefixMemo prefix_memo;
+    
+    // Frequency-ranked completion index. When frequencies or the arena change it keeps
+    // serving while a replacement is built in the background; once the column epoch it
+    // was built for has passed, queries rank the dictionary directly until that build lands
+    std::atomic<size_t> stats_version;
+    
+    // Bumped when existing rows are rewritten or replaced rather than appended to
+    size_t column_epoch;
+    mutable std::mutex completion_mutex;
+    mutable std::shared_ptr<const CompletionIndex> completion_index;
+    mutable size_t completion_epoch;
+    mutable bool completion_rebuilding;
+    mutable std::future<void> completion_build;
+    
     // Memory mapped file support
     int mmap_fd;
     void* mmap_data;
     size_t mmap_size;
     
+    // A read-only mapping a loader validates before it replaces the codec's own
+    struct FileMapping {
+        int fd = -1;
+        void* data = nullptr;
+        size_t size = 0;
+    };
+    
+    // Open-addressing value -> ID index over the arena, used instead of `dictionary` while a
+    // snapshot or stream is mapped or after loadFromFile; null when the dictionary map is in use
+    const uint32_t* hash_index;
+    size_t hash_mask;
+    
+    // Index over an owned or Arrow arena. After loadFromFile it is built in the background:
+    // lookups wait for it, and every mutation waits before touching the arena it reads.
+    // loadArrowStream builds it before the stream replaces anything
+    std::vector<uint32_t> loaded_hash_index;
+    mutable std::shared_future<void> hash_index_build;
+    
+    // Log of appendValues calls (null when disabled) and the state directory it continues
+    std::shared_ptr<WriteAheadLog> wal;
+    std::string wal_directory;
+    std::mutex checkpoint_mutex;  // Serializes snapshots into wal_directory
+    
     // Helper functions
     bool simdComparePrefix(const char* data, const char* prefix, size_t prefix_len) const;
     void simdScanChunk(__m256i* chunk, const std::string& target, std::vector<size_t>& results) const;
     void compressChunk(const char* input, size_t size, std::vector<uint8_t>& output) const;
-    void decompressChunk(const uint8_t* input, size_t size, char* output) const;
-    void memoryMapFile(const std::string& filename);
+    void decompressChunk(const uint8_t* input, size_t size, char* output, size_t capacity) const;
+    // Calls visit(id) for every ID whose value starts with prefix, in ascending order;
+    // returns true when the set came straight from the memo
+    template <typename Visit>
+    bool visitPrefixIds(const std::string& prefix, Visit&& visit) const;
+    void collectPrefixIds(const std::string& prefix, std::vector<uint32_t>& ids) const;
+    void buildIdBitmap(const std::vector<uint32_t>& ids, std::vector<uint32_t>& bitmap) const;
+    size_t scanIds(const std::vector<uint32_t>& ids, size_t begin_row, size_t end_row,
+                   const MatchSink& sink) const;
+    size_t pageIds(const std::vector<uint32_t>& ids, SearchCursor& cursor, size_t limit,
+                   size_t offset, std::vector<uint32_t>& out) const;
+    void encodeChunk(const std::vector<std::string>& chunk, size_t start_idx,
+                     std::vector<size_t>& local_counts, size_t& local_bytes);
+    void mergeFrequencies(const std::vector<size_t>& local_counts, size_t local_bytes);
+    void rebuildFrequencies();
+    void clampRowRange(size_t& begin_row, size_t& end_row) const;
+    void appendToArena(const std::string& value);
+    uint32_t addDictionaryEntry(const std::string& value);
+    // With the lock held: the matches of ids in [begin_row, end_row) over the current column
+    ResultSet resultOfIds(const std::vector<uint32_t>& ids, size_t begin_row, size_t end_row) const;
+    std::shared_ptr<const ResultSet> cachedSearch(QueryKey key) const;
+    void decodeIds(const uint32_t* ids, size_t count, DecodedColumn& out, int num_threads) const;
+    std::vector<std::pair<std::string, size_t>> selectTopK(const std::vector<size_t>& counts, size_t k) const;
+    // The k IDs among ids with the highest counts
+    std::vector<std::pair<std::string, size_t>> selectTopK(const std::vector<size_t>& counts,
+                                                           std::vector<uint32_t> ids, size_t k) const;
+    static FileMapping mapFile(const std::string& filename);
+    static void unmapFile(FileMapping& mapping);
     void unmapFile();
+    bool lookupId(const std::string& value, uint32_t& id) const;
+    std::string_view valueAt(uint32_t id) const {
+        return std::string_view(value_bytes.data() + value_offsets[id], value_offsets[id + 1] - value_offsets[id]);
+    }
+    size_t valueCount() const { return value_offsets.empty() ? 0 : value_offsets.size() - 1; }
+    StringArenaView valueArena() const { return StringArenaView{value_offsets.data(), value_bytes.data()}; }
+    void materializeSnapshot();
+    // Drops a mapped snapshot or stream with everything derived from it, before a load
+    // replaces the state or when a loaded stream is rejected
+    void releaseSnapshot();
+    static size_t hashSlotsFor(size_t count);
+    // Fills table (hashSlotsFor(count) zeroed slots) with ID + 1 for the first count values
+    // in parallel; false if check_distinct and two of them are equal
+    static bool fillHashIndex(StringArenaView values, size_t count, std::vector<uint32_t>& table,
+                              bool check_distinct);
+    void startHashIndexBuild();
+    void waitForHashIndex() const;
+    void writeSnapshot(const std::string& filename) const;
+    // With the lock held: pins the current state and returns the job that writes it to
+    // directory, copying block by block under brief shared locks (see saveStateAsync)
+    std::function<void()> captureState(const std::string& directory) const;
+    void rejectWhileLogging(const std::string& operation) const;
+    void applyAppendRecord(const AppendRecord& record);
+    void rebuildCompletionIndex() const;
+    double compressionRatio() const;  // getCompressionRatio without taking the lock
 
     static constexpr size_t MAX_DICTIONARY_SIZE = 1000000;  // 1M entries
     static constexpr size_t CHUNK_SIZE = 10 * 1024 * 1024;  // 10MB
+    static constexpr size_t MIN_ROWS_PER_THREAD = 1 << 16;  // Below this a thread costs more than it scans
+    static constexpr size_t SINK_CHUNK_ROWS = 1024;         // Rows buffered on the stack per sink call
+    static constexpr size_t MAX_LANE_HISTOGRAM_IDS = 1 << 14;  // Largest dictionary counted in lane copies
+    static constexpr size_t MIN_IDS_PER_INDEX_THREAD = 1 << 14;
+    static constexpr size_t DEFAULT_CHECKPOINT_BYTES = 64 << 20;
+    static constexpr size_t SNAPSHOT_BLOCK = 1 << 16;  // Rows or values copied per lock hold in saveStateAsync
+    static constexpr size_t EXPORT_CHUNK_ROWS = 1 << 16;  // Rows formatted per buffer in saveResults
+    static constexpr size_t ALL_ROWS = std::numeric_limits<size_t>::max();
 
 
 public:
     DictionaryCodec();
     ~DictionaryCodec();
+    // saveState writes a mappable snapshot; loadState maps it (or reads a legacy dictionary.bin)
+    // and replays the write-ahead log found beside it. Logging is off after loadState: call
+    // enableWriteAheadLog to resume it
     void saveState(const std::string& directory) const;
     void loadState(const std::string& directory);
-    void saveResults(const std::string& directory, const std::string& test_name) const;
+    
+    // Online saveState: pins the current row and dictionary counts, then writes the snapshot
+    // on a background thread, copying one block at a time under a brief shared lock, so
+    // appends and queries continue throughout. Fails if rows are rewritten (encodeFile,
+    // loadFromFile, ...) before it finishes. The codec must outlive the returned future
+    std::future<void> saveStateAsync(const std::string& directory) const;
+    
+    // Durable appends: logs every appendValues call to directory/wal.log on top of a fresh
+    // snapshot there; appendValues returns once its record and that snapshot are on disk,
+    // and concurrent appenders share one fdatasync. A log already in directory is replaced
+    // only once that snapshot is committed, so a failed enable leaves it recoverable. Snapshots (the first one, and the
+    // checkpoints that fold the log in once it passes checkpoint_bytes) are written online
+    // like saveStateAsync. Rewrites (encodeFile, encodeSingleThread, loadFromFile,
+    // loadSnapshot, loadArrowStream) throw while the log is enabled. After a failed log
+    // write every appendValues throws, though earlier failed appends stay applied in
+    // memory, until the log is enabled again
+    void enableWriteAheadLog(const std::string& directory, size_t checkpoint_bytes = DEFAULT_CHECKPOINT_BYTES);
+    void disableWriteAheadLog();
+    void checkpoint();
+    // Writes every row as "index,value,id,id" to directory/test_name_results.csv plus a
+    // summary; rows are formatted in parallel chunks and written in order. The rows are
+    // copied under a brief shared lock, so appends are not held up by the file writes
+    void saveResults(const std::string& directory, const std::string& test_name, int num_threads = 0) const;
 
     
     // Accessor methods
     const std::vector<std::string>& getOriginalData() const { return original_data; }
-    size_t getDictionarySize() const { return dictionary.size(); }
+    size_t getDictionarySize() const { return valueCount(); }
     size_t getDataSize() const { return encoded_data.size(); }
     double getCompressionRatio() const;
     size_t getMemoryUsage() const;
     
+    // Value statistics served from the per-ID frequency table
+    size_t getFrequency(const std::string& value) const;
+    std::vector<size_t> getValueHistogram() const;
+    std::vector<std::pair<std::string, size_t>> getTopFrequentValues(size_t k) const;
+    
+    // Autocomplete: the k most frequent values starting with prefix, without touching the rows.
+    // k is capped at CompletionIndex::NODE_TOP_K. Rankings trail the latest appends by one
+    // background index rebuild
+    std::vector<std::pair<std::string, size_t>> complete(const std::string& prefix, size_t k) const;
+    
+    // GROUP BY value over the rows [begin_row, end_row); num_threads = 0 uses all cores
+    std::vector<size_t> getValueHistogram(size_t begin_row, size_t end_row, int num_threads = 0) const;
+    std::vector<std::pair<std::string, size_t>> getTopFrequentValues(
+        size_t k, size_t begin_row, size_t end_row, int num_threads = 0) const;
+    
     // Core operations
     void encodeFile(const std::string& filename, int num_threads);
+    // Encodes chunk into rows [start_idx, start_idx + chunk.size()), overwriting rows
+    // already there and extending the column past its end; start_idx may not leave a gap
     void encodeSingleThread(const std::vector<std::string>& chunk, size_t start_idx);
+    void appendValues(const std::vector<std::string>& values);
     
     // Search operations
     std::vector<size_t> findMatches(const std::string& target) const;
     std::vector<size_t> findMatchesSIMD(const std::string& target) const;
+    std::vector<size_t> findMatchesSIMD(const std::string& target, size_t begin_row, size_t end_row) const;
     std::vector<size_t> baselineFind(const std::string& target) const;
     
+    // Count-only and existence queries (no positions are materialized)
+    size_t countMatches(const std::string& target) const;
+    size_t countPrefix(const std::string& prefix) const;
+    bool exists(const std::string& target) const;
+    
+    // Row-range restricted variants; only rows in [begin_row, end_row) are scanned
+    size_t countMatches(const std::string& target, size_t begin_row, size_t end_row) const;
+    size_t countPrefix(const std::string& prefix, size_t begin_row, size_t end_row) const;
+    bool exists(const std::string& target, size_t begin_row, size_t end_row) const;
+    
     // Prefix search operations
     std::vector<std::pair<std::string, std::vector<size_t>>> prefixSearch(const std::string& prefix) const;
     std::vector<std::pair<std::string, std::vector<size_t>>> prefixSearchSIMD(const std::string& prefix) const;
+    std::vector<std::pair<std::string, std::vector<size_t>>> prefixSearchSIMD(
+        const std::string& prefix, size_t begin_row, size_t end_row) const;
     std::vector<std::pair<std::string, std::vector<size_t>>> baselinePrefixSearch(const std::string& prefix) const;
     
+    // Streaming searches: rows are pushed to `sink` in chunks, nothing is allocated per query
+    void scanMatches(const std::string& target, const MatchSink& sink,
+                     size_t begin_row = 0, size_t end_row = ALL_ROWS) const;
+    void scanPrefix(const std::string& prefix, const MatchSink& sink,
+                    size_t begin_row = 0, size_t end_row = ALL_ROWS) const;
+    
+    // Searches that write 32-bit positions into a caller-owned, reused buffer; return the match count
+    size_t findMatchesInto(const std::string& target, std::vector<uint32_t>& out,
+                           size_t begin_row = 0, size_t end_row = ALL_ROWS) const;
+    size_t prefixSearchInto(const std::string& prefix, std::vector<uint32_t>& out,
+                            size_t begin_row = 0, size_t end_row = ALL_ROWS) const;
+    
+    // Paginated searches (LIMIT/OFFSET): skip `offset` matches from the cursor, return at most
+    // `limit` positions, and leave the cursor at the row to resume from on the next page
+    size_t findMatchesPage(const std::string& target, SearchCursor& cursor, size_t limit,
+                           std::vector<uint32_t>& out, size_t offset = 0) const;
+    size_t prefixSearchPage(const std::string& prefix, SearchCursor& cursor, size_t limit,
+                            std::vector<uint32_t>& out, size_t offset = 0) const;
+    
+    // Searches returning a compact ResultSet whose encoding is chosen by match density
+    ResultSet findMatchesResult(const std::string& target,
+                                size_t begin_row = 0, size_t end_row = ALL_ROWS) const;
+    ResultSet prefixSearchResult(const std::string& prefix,
+                                 size_t begin_row = 0, size_t end_row = ALL_ROWS) const;
+    
+    // Cached searches; without an enabled cache these compute the result directly.
+    // Cached results over open-ended windows are extended by scanning only appended rows.
+    void enableResultCache(size_t max_bytes);
+    void disableResultCache();
+    const ResultCache* getResultCache() const { return result_cache.get(); }
+    std::shared_ptr<const ResultSet> findMatchesCached(const std::string& target,
+                                                       size_t begin_row = 0, size_t end_row = ALL_ROWS) const;
+    std::shared_ptr<const ResultSet> prefixSearchCached(const std::string& prefix,
+                                                        size_t begin_row = 0, size_t end_row = ALL_ROWS) const;
+    
+    // Bulk decode (late materialization) into a caller-provided column
+    void decodeRange(size_t begin_row, size_t end_row, DecodedColumn& out, int num_threads = 1) const;
+    void decodePositions(const std::vector<size_t>& positions, DecodedColumn& out, int num_threads = 1) const;
+    
     // Batch operations
     std::vector<std::vector<size_t>> batchSearchSIMD(const std::vector<std::string>& queries) const;
     
@@ -92,8 +351,28 @@ public:
     // File I/O operations
     void saveToFile(const std::string& filename) const;
     void loadFromFile(const std::string& filename);
+    
+    // Zero-copy snapshots: an aligned file with the value arena, a prebuilt hash index,
+    // frequencies and the raw ID column. loadSnapshot maps it and serves queries in place;
+    // the first mutation copies everything into owned storage (materialize), at O(rows +
+    // dictionary) cost
+    void saveSnapshot(const std::string& filename) const;
+    void loadSnapshot(const std::string& filename);
+    void materialize();
+    bool isMapped() const { return mmap_data != nullptr; }
+    
+    // Arrow IPC stream of one dictionary-encoded utf8 column: the arena is written as the
+    // dictionary and the ID column as the int32 indices. loadArrowStream maps the file and
+    // serves queries from its buffers in place, like loadSnapshot; other index widths,
+    // offset layouts or several record batches are converted into owned storage
+    void saveArrowStream(const std::string& filename, const std::string& column_name = "value") const;
+    void loadArrowStream(const std::string& filename);
+
 
-    const std::unordered_map<std::string, uint32_t>& getDictionary() const { return dictionary; }
-    const std::vector<std::string>& getReverseDictionary() const { return reverse_dictionary; }
+    // Copies of the value -> ID map and the ID -> value list, built from the value arena
+    // under the read lock, so they are complete whatever storage backs the codec. Each call
+    // costs O(dictionary); a mapped snapshot or stream stays mapped
+    std::unordered_map<std::string, uint32_t> getDictionary() const;
+    std::vector<std::string> getReverseDictionary() const;
 
 };
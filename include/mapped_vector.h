@@ -0,0 +1,71 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+// Vector that either owns its elements or views a read-only range inside a
+// memory-mapped snapshot. Reads work the same in both modes; the first mutating
+// call copies a viewed range into owned storage, so callers never write to the map.
+template <typename T>
+class MappedVector {
+private:
+    std::vector<T> owned;
+    const T* view_data = nullptr;
+    size_t view_size = 0;
+    bool viewing = false;
+
+public:
+    MappedVector() = default;
+
+    // Point at count elements of mapped memory, dropping any owned contents
+    void view(const T* data, size_t count) {
+        std::vector<T>().swap(owned);
+        view_data = data;
+        view_size = count;
+        viewing = true;
+    }
+
+    // Take over values as owned storage, dropping any view
+    void assign(std::vector<T>&& values) {
+        owned = std::move(values);
+        view_data = nullptr;
+        view_size = 0;
+        viewing = false;
+    }
+
+    // Copy a viewed range into owned storage; no-op when already owned
+    void materialize() {
+        if (viewing) {
+            owned.assign(view_data, view_data + view_size);
+            view_data = nullptr;
+            view_size = 0;
+            viewing = false;
+        }
+    }
+
+    bool isView() const { return viewing; }
+
+    const T* data() const { return viewing ? view_data : owned.data(); }
+    size_t size() const { return viewing ? view_size : owned.size(); }
+    bool empty() const { return size() == 0; }
+    const T& operator[](size_t i) const { return data()[i]; }
+    const T* begin() const { return data(); }
+    const T* end() const { return data() + size(); }
+
+    T* data() { materialize(); return owned.data(); }
+    T& operator[](size_t i) { materialize(); return owned[i]; }
+
+    void push_back(const T& value) { materialize(); owned.push_back(value); }
+    void reserve(size_t count) { materialize(); owned.reserve(count); }
+    void resize(size_t count) { materialize(); owned.resize(count); }
+    void clear() {
+        owned.clear();
+        view_data = nullptr;
+        view_size = 0;
+        viewing = false;
+    }
+    template <typename Iterator>
+    void append(Iterator first, Iterator last) { materialize(); owned.insert(owned.end(), first, last); }
+
+    size_t capacity() const { return viewing ? 0 : owned.capacity(); }
+};
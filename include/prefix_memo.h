@@ -0,0 +1,47 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+#include <cstddef>
+
+// Memo of resolved prefix -> sorted dictionary ID set, indexed by a character trie.
+// A refined prefix ("ab" -> "abc") starts from its deepest memoized ancestor instead
+// of the whole dictionary. New dictionary entries are added to every memoized
+// ancestor along their path, so entries never go stale.
+//
+// The returned ID vectors are updated in place by addEntry: callers hold the codec
+// lock, shared while reading a result and exclusive while adding entries.
+//
+// The budget covers trie nodes as well as IDs, and empty results are not memoized,
+// so prefixes that match nothing cannot grow the trie.
+class PrefixMemo {
+private:
+    struct Node {
+        std::unordered_map<char, std::unique_ptr<Node>> children;
+        std::shared_ptr<std::vector<uint32_t>> ids;  // Null unless this prefix is memoized
+    };
+
+    Node root;
+    size_t memoized_ids;  // IDs held across all nodes
+    size_t charged;       // memoized_ids plus NODE_COST per trie node, kept within max_ids
+    size_t max_ids;
+    mutable std::mutex mutex;
+
+public:
+    static constexpr size_t NODE_COST = 16;  // A trie node is charged as this many IDs
+
+    explicit PrefixMemo(size_t max_ids = 1 << 22);
+
+    // IDs of the longest memoized prefix of `prefix` (null if none); its length goes to matched_length
+    std::shared_ptr<const std::vector<uint32_t>> findClosest(const std::string& prefix,
+                                                             size_t& matched_length) const;
+    void store(const std::string& prefix, const std::vector<uint32_t>& ids);
+    void addEntry(const std::string& value, uint32_t id);
+    void clear();
+
+    size_t getMemoizedIds() const;
+};
@@ -0,0 +1,138 @@
+#pragma once
+
+#include "dictionary_codec.h"
+#include <string>
+#include <vector>
+#include <deque>
+#include <future>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <limits>
+#include <cstdint>
+#include <cstddef>
+
+// Thrown through a query's future when it was cancelled or ran past its deadline
+class QueryCancelled : public std::runtime_error {
+public:
+    explicit QueryCancelled(const std::string& what) : std::runtime_error(what) {}
+};
+
+// Cancellation flag and deadline shared between a caller and its queries.
+// Copies refer to the same state, so one token can cancel a group of queries.
+class CancellationToken {
+private:
+    struct State {
+        std::atomic<bool> cancelled{false};
+        std::chrono::steady_clock::time_point deadline;
+    };
+    std::shared_ptr<State> state;
+
+public:
+    CancellationToken();
+    explicit CancellationToken(std::chrono::steady_clock::time_point deadline);
+    static CancellationToken withTimeout(std::chrono::steady_clock::duration timeout);
+
+    void cancel() const { state->cancelled = true; }
+    bool isCancelled() const { return state->cancelled; }
+    bool isExpired() const { return std::chrono::steady_clock::now() >= state->deadline; }
+    bool shouldStop() const { return isCancelled() || isExpired(); }
+    void throwIfStopped() const;
+    std::chrono::steady_clock::time_point getDeadline() const { return state->deadline; }
+};
+
+// Thrown through a query's future when its class queue is full at submission
+class QueryRejected : public std::runtime_error {
+public:
+    explicit QueryRejected(const std::string& what) : std::runtime_error(what) {}
+};
+
+// Scheduling class, picked from each query's estimated cost
+enum class QueryClass : uint8_t {
+    Short,  // Counts and scans within SHORT_COST_LIMIT: run to completion, served first
+    Long    // Costlier scans: time-sliced between row slices
+};
+
+// Runs codec queries on a worker pool and hands back futures. Scans are split
+// into row slices; the token is checked between slices, so a cancelled or
+// overdue query stops within one slice and releases the codec lock in between.
+//
+// Each scan is first planned by a Short task on a worker, which resolves its IDs and
+// estimates its cost from the row count, the number of IDs and their per-ID
+// frequencies, so the caller never waits for the dictionary index. Every slice scans
+// those IDs (and their bitmap) as planned; a scan fails if the column is rewritten
+// meanwhile. Short queries are always dispatched first. Long queries run one slice
+// per turn and requeue behind their class, so a point lookup never waits for more
+// than one slice of a long scan. Each class has its own concurrency and queue limits.
+class QueryExecutor {
+private:
+    // One schedulable unit; step() runs a slice and returns true once the query is finished
+    struct Task {
+        QueryClass query_class;
+        std::function<bool()> step;
+    };
+
+    struct ClassState {
+        std::deque<Task> queue;
+        size_t running = 0;
+        size_t max_running;
+        size_t max_queued = std::numeric_limits<size_t>::max();
+    };
+
+    const DictionaryCodec& codec;
+    std::vector<std::thread> workers;
+    ClassState classes[2];
+    mutable std::mutex mutex;
+    std::condition_variable tasks_cv;
+    bool stopping;
+
+    ClassState& stateOf(QueryClass query_class) { return classes[static_cast<size_t>(query_class)]; }
+    bool canDispatch(const ClassState& state) const;
+    void workerLoop();
+    bool enqueue(Task task);
+    QueryClass classify(size_t rows, size_t id_count, size_t matches) const;
+    template <typename Result>
+    std::future<Result> submitCount(std::function<Result()> count, const CancellationToken& token);
+    std::future<std::vector<uint32_t>> submitScan(
+        const CancellationToken& token, std::function<void(std::vector<uint32_t>&)> resolve_ids);
+    void scanSlice(const std::vector<uint32_t>& ids, const std::vector<uint32_t>& bitmap, size_t epoch,
+                   size_t begin, size_t end, std::vector<uint32_t>& positions) const;
+
+public:
+    static constexpr size_t SLICE_ROWS = 1 << 20;
+    // Cost units are rows compared by the equality kernel
+    static constexpr size_t BITMAP_ROW_COST = 3;   // Gather-based multi-ID membership test
+    static constexpr size_t MATCH_COST = 8;        // Emitting one matching row
+    // Short scans run to completion, so their cost is capped at about two slices
+    static constexpr size_t SHORT_COST_LIMIT = 2 * SLICE_ROWS;
+
+    // num_threads = 0 uses all cores; Long queries may use all but one worker
+    explicit QueryExecutor(const DictionaryCodec& codec, int num_threads = 0);
+    ~QueryExecutor();
+
+    QueryExecutor(const QueryExecutor&) = delete;
+    QueryExecutor& operator=(const QueryExecutor&) = delete;
+
+    // Futures yield sorted row positions, or throw QueryCancelled / QueryRejected (also
+    // when a scan planned as Long finds the Long queue full)
+    std::future<std::vector<uint32_t>> findMatchesAsync(const std::string& target,
+                                                        CancellationToken token = CancellationToken());
+    std::future<std::vector<uint32_t>> prefixSearchAsync(const std::string& prefix,
+                                                         CancellationToken token = CancellationToken());
+    std::future<size_t> countMatchesAsync(const std::string& target,
+                                          CancellationToken token = CancellationToken());
+    std::future<size_t> countPrefixAsync(const std::string& prefix,
+                                         CancellationToken token = CancellationToken());
+
+    // Admission control: concurrent workers and queued queries allowed per class
+    void setClassLimits(QueryClass query_class, size_t max_running, size_t max_queued);
+
+    size_t getQueuedCount() const;
+    size_t getQueuedCount(QueryClass query_class) const;
+    size_t getRunningCount(QueryClass query_class) const;
+};
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "result_set.h"
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+#include <cstddef>
+
+// Normalized query: the resolved, sorted dictionary ID set and the row window it
+// covers. Exact and prefix queries resolving to the same IDs share one entry.
+struct QueryKey {
+    std::vector<uint32_t> ids;
+    size_t begin_row;
+    size_t end_row;
+
+    bool operator==(const QueryKey& other) const {
+        return begin_row == other.begin_row && end_row == other.end_row && ids == other.ids;
+    }
+};
+
+struct QueryKeyHash {
+    size_t operator()(const QueryKey& key) const;
+};
+
+// Byte-bounded query result cache with CLOCK (second chance) eviction.
+// Every entry records how many column rows its result covers, so a result can
+// be extended over appended rows instead of being recomputed.
+class ResultCache {
+private:
+    struct Entry {
+        QueryKey key;
+        std::shared_ptr<const ResultSet> result;
+        size_t rows_covered;
+        size_t bytes;
+        bool referenced;  // CLOCK bit, set on every hit
+        bool occupied;
+    };
+
+    std::vector<Entry> slots;
+    std::vector<size_t> free_slots;
+    std::unordered_map<QueryKey, size_t, QueryKeyHash> index;
+    size_t clock_hand;
+    size_t max_bytes;
+    size_t used_bytes;
+    size_t hits;
+    size_t misses;
+    mutable std::mutex mutex;
+
+    static size_t entryBytes(const QueryKey& key, const ResultSet& result);
+    void evictUntilFits(size_t incoming_bytes);
+    void removeSlot(size_t slot);
+
+public:
+    explicit ResultCache(size_t max_bytes);
+
+    // Returns the cached result (or nullptr) and the number of rows it covers
+    std::shared_ptr<const ResultSet> lookup(const QueryKey& key, size_t& rows_covered);
+    void insert(const QueryKey& key, std::shared_ptr<const ResultSet> result, size_t rows_covered);
+    // True when the caller holds the only reference to result outside the cache; the
+    // entry is then removed, so the caller may extend result in place and insert it again
+    bool detachIfUnshared(const QueryKey& key, const std::shared_ptr<const ResultSet>& result);
+    void clear();
+
+    // Accessor methods
+    size_t getMaxBytes() const { return max_bytes; }
+    size_t getUsedBytes() const;
+    size_t getEntryCount() const;
+    size_t getHits() const;
+    size_t getMisses() const;
+};
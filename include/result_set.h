@@ -0,0 +1,71 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+enum class ResultEncoding : uint8_t {
+    Positions,    // Plain sorted uint32_t row positions
+    DeltaVarint,  // LEB128-encoded gaps between sorted positions
+    Bitmap        // One bit per row of the column
+};
+
+// Sorted set of matching row positions, stored in whichever encoding is smallest
+// for its density. All encodings convert to and from sorted uint32_t positions.
+class ResultSet {
+private:
+    ResultEncoding encoding;
+    size_t num_rows;         // Rows in the column the result was computed over
+    size_t count;            // Number of positions in the set
+    uint32_t last_position;  // Largest position, the delta base for appends
+
+    std::vector<uint32_t> positions;   // ResultEncoding::Positions
+    std::vector<uint8_t> varint_data;  // ResultEncoding::DeltaVarint
+    std::vector<uint64_t> bitmap;      // ResultEncoding::Bitmap
+
+public:
+    ResultSet();
+    ResultSet(const std::vector<uint32_t>& sorted_positions, size_t num_rows);
+    ResultSet(const std::vector<uint32_t>& sorted_positions, size_t num_rows, ResultEncoding encoding);
+    ResultSet(const std::vector<size_t>& sorted_positions, size_t num_rows);
+    // A row bitmap re-encoded by density (vector<size_t> positions would clash with a constructor)
+    static ResultSet fromBitmap(std::vector<uint64_t> row_bitmap, size_t num_rows);
+
+    // Smallest encoding for `count` positions spread over `num_rows` rows
+    static ResultEncoding chooseEncoding(size_t count, size_t num_rows);
+
+    // Accessor methods
+    ResultEncoding getEncoding() const { return encoding; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    size_t getNumRows() const { return num_rows; }
+    size_t getMemoryUsage() const;
+    const std::vector<uint32_t>& getPositions() const { return positions; }
+    const std::vector<uint64_t>& getBitmap() const { return bitmap; }
+
+    // Extends the set with positions from newly appended rows (all above the current
+    // maximum), keeping the current encoding
+    void append(const uint32_t* new_positions, size_t new_count, size_t new_num_rows);
+
+    // Conversions
+    void toPositions(std::vector<uint32_t>& out) const;
+    void toBitmap(std::vector<uint64_t>& out) const;
+    ResultSet convertTo(ResultEncoding target) const;
+    bool contains(uint32_t row) const;
+};
+
+// SIMD conversion kernels between the result encodings
+namespace ResultConversions {
+    // Indices of the set bits of `byte`, padded to 8 lanes (32-byte aligned);
+    // doubles as the left-pack permutation for an 8-lane match mask
+    const uint32_t* setBitLanes(uint32_t byte);
+
+    void narrowPositions(const size_t* positions, size_t count, uint32_t* out);
+    void bitmapToPositions(const uint64_t* words, size_t num_words, std::vector<uint32_t>& out);
+    void positionsToBitmap(const uint32_t* positions, size_t count, size_t num_rows,
+                           std::vector<uint64_t>& out);
+    // Gaps are taken relative to `base` for the first position (0 for a new list)
+    void encodeDeltaVarint(const uint32_t* positions, size_t count, uint32_t base,
+                           std::vector<uint8_t>& out);
+    void decodeDeltaVarint(const uint8_t* data, size_t count, std::vector<uint32_t>& out);
+}
@@ -0,0 +1,303 @@
+#pragma once
+
+#include <immintrin.h>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+
+// AVX2 kernels over an encoded ID column.
+// Every kernel works on the half-open row window [begin, end) of `data`.
+namespace ScanKernels {
+
+    // 8-bit match mask for 8 IDs compared against a broadcast target
+    inline uint32_t equalMask8(const uint32_t* data, __m256i target_vec) {
+        __m256i data_vec = _mm256_loadu_si256((const __m256i*)data);
+        __m256i cmp = _mm256_cmpeq_epi32(data_vec, target_vec);
+        return static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(cmp)));
+    }
+
+    // 32-bit match mask for 32 consecutive IDs
+    inline uint32_t equalMask32(const uint32_t* data, __m256i target_vec) {
+        return equalMask8(data, target_vec)
+             | (equalMask8(data + 8, target_vec) << 8)
+             | (equalMask8(data + 16, target_vec) << 16)
+             | (equalMask8(data + 24, target_vec) << 24);
+    }
+
+    // 8-bit membership mask for 8 IDs tested against an ID bitmap (one bit per ID)
+    inline uint32_t bitmapMask8(const uint32_t* data, const uint32_t* id_bitmap) {
+        __m256i ids = _mm256_loadu_si256((const __m256i*)data);
+        __m256i words = _mm256_i32gather_epi32((const int*)id_bitmap, _mm256_srli_epi32(ids, 5), 4);
+        __m256i bits = _mm256_srlv_epi32(words, _mm256_and_si256(ids, _mm256_set1_epi32(31)));
+        __m256i hit = _mm256_slli_epi32(bits, 31);  // Move the tested bit into the sign position
+        return static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(hit)));
+    }
+
+    inline bool bitmapTest(const uint32_t* id_bitmap, uint32_t id) {
+        return (id_bitmap[id >> 5] >> (id & 31)) & 1u;
+    }
+
+    // Number of rows equal to `id`
+    inline size_t countEqual(const uint32_t* data, size_t begin, size_t end, uint32_t id) {
+        const __m256i target_vec = _mm256_set1_epi32(id);
+        size_t count = 0;
+        size_t i = begin;
+        for (; i + 32 <= end; i += 32) {
+            count += _mm_popcnt_u32(equalMask32(data + i, target_vec));
+        }
+        for (; i + 8 <= end; i += 8) {
+            count += _mm_popcnt_u32(equalMask8(data + i, target_vec));
+        }
+        for (; i < end; i++) {
+            count += data[i] == id;
+        }
+        return count;
+    }
+
+    // First row equal to `id`, or `end` if there is none
+    inline size_t findFirstEqual(const uint32_t* data, size_t begin, size_t end, uint32_t id) {
+        const __m256i target_vec = _mm256_set1_epi32(id);
+        size_t i = begin;
+        for (; i + 32 <= end; i += 32) {
+            uint32_t mask = equalMask32(data + i, target_vec);
+            if (mask) {
+                return i + _tzcnt_u32(mask);
+            }
+        }
+        for (; i < end; i++) {
+            if (data[i] == id) {
+                return i;
+            }
+        }
+        return end;
+    }
+
+    // Number of rows whose ID is set in `id_bitmap`
+    inline size_t countInBitmap(const uint32_t* data, size_t begin, size_t end, const uint32_t* id_bitmap) {
+        size_t count = 0;
+        size_t i = begin;
+        for (; i + 8 <= end; i += 8) {
+            count += _mm_popcnt_u32(bitmapMask8(data + i, id_bitmap));
+        }
+        for (; i < end; i++) {
+            count += bitmapTest(id_bitmap, data[i]);
+        }
+        return count;
+    }
+
+    // First row whose ID is set in `id_bitmap`, or `end` if there is none
+    inline size_t findFirstInBitmap(const uint32_t* data, size_t begin, size_t end, const uint32_t* id_bitmap) {
+        size_t i = begin;
+        for (; i + 8 <= end; i += 8) {
+            uint32_t mask = bitmapMask8(data + i, id_bitmap);
+            if (mask) {
+                return i + _tzcnt_u32(mask);
+            }
+        }
+        for (; i < end; i++) {
+            if (bitmapTest(id_bitmap, data[i])) {
+                return i;
+            }
+        }
+        return end;
+    }
+
+    // Row of the nth (0-based) row equal to `id`, or `end`.
+    // Whole 32-row blocks are skipped by popcount without visiting their matches.
+    inline size_t findNthEqual(const uint32_t* data, size_t begin, size_t end, uint32_t id, size_t n) {
+        const __m256i target_vec = _mm256_set1_epi32(id);
+        size_t i = begin;
+        for (; i + 32 <= end; i += 32) {
+            uint32_t mask = equalMask32(data + i, target_vec);
+            size_t hits = _mm_popcnt_u32(mask);
+            if (hits > n) {
+                for (; n > 0; n--) {
+                    mask &= mask - 1;
+                }
+                return i + _tzcnt_u32(mask);
+            }
+            n -= hits;
+        }
+        for (; i < end; i++) {
+            if (data[i] == id && n-- == 0) {
+                return i;
+            }
+        }
+        return end;
+    }
+
+    // Row of the nth (0-based) row whose ID is set in `id_bitmap`, or `end`
+    inline size_t findNthInBitmap(const uint32_t* data, size_t begin, size_t end,
+                                  const uint32_t* id_bitmap, size_t n) {
+        size_t i = begin;
+        for (; i + 8 <= end; i += 8) {
+            uint32_t mask = bitmapMask8(data + i, id_bitmap);
+            size_t hits = _mm_popcnt_u32(mask);
+            if (hits > n) {
+                for (; n > 0; n--) {
+                    mask &= mask - 1;
+                }
+                return i + _tzcnt_u32(mask);
+            }
+            n -= hits;
+        }
+        for (; i < end; i++) {
+            if (bitmapTest(id_bitmap, data[i]) && n-- == 0) {
+                return i;
+            }
+        }
+        return end;
+    }
+
+    // Calls emit(row) for every row equal to `id`, in row order.
+    // emit returns false to stop; the result is the row to resume from (`end` when exhausted).
+    template <typename Emit>
+    inline size_t forEachEqual(const uint32_t* data, size_t begin, size_t end, uint32_t id, Emit&& emit) {
+        const __m256i target_vec = _mm256_set1_epi32(id);
+        size_t i = begin;
+        for (; i + 32 <= end; i += 32) {
+            uint32_t mask = equalMask32(data + i, target_vec);
+            while (mask) {
+                size_t row = i + _tzcnt_u32(mask);
+                if (!emit(row)) {
+                    return row + 1;
+                }
+                mask &= mask - 1;
+            }
+        }
+        for (; i < end; i++) {
+            if (data[i] == id && !emit(i)) {
+                return i + 1;
+            }
+        }
+        return end;
+    }
+
+    // Calls emit(row) for every row whose ID is set in `id_bitmap`, in row order.
+    // Same stop/resume contract as forEachEqual.
+    template <typename Emit>
+    inline size_t forEachInBitmap(const uint32_t* data, size_t begin, size_t end,
+                                  const uint32_t* id_bitmap, Emit&& emit) {
+        size_t i = begin;
+        for (; i + 8 <= end; i += 8) {
+            uint32_t mask = bitmapMask8(data + i, id_bitmap);
+            while (mask) {
+                size_t row = i + _tzcnt_u32(mask);
+                if (!emit(row)) {
+                    return row + 1;
+                }
+                mask &= mask - 1;
+            }
+        }
+        for (; i < end; i++) {
+            if (bitmapTest(id_bitmap, data[i]) && !emit(i)) {
+                return i + 1;
+            }
+        }
+        return end;
+    }
+
+    // Adds the rows in the window to a per-ID count array. Counting is scalar: AVX2 has no
+    // scatter, and split sub-histograms lose on large dictionaries. AVX2 only spots blocks
+    // of 8 identical IDs (runs in clustered columns), which are counted with a single add.
+    inline void histogramAdd(const uint32_t* data, size_t begin, size_t end, uint32_t* counts) {
+        size_t i = begin;
+        for (; i + 8 <= end; i += 8) {
+            __m256i ids = _mm256_loadu_si256((const __m256i*)(data + i));
+            __m256i first = _mm256_broadcastd_epi32(_mm256_castsi256_si128(ids));
+            if (_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(ids, first))) == 0xFF) {
+                counts[data[i]] += 8;
+                continue;
+            }
+            for (size_t j = i; j < i + 8; j++) {
+                counts[data[j]]++;
+            }
+        }
+        for (; i < end; i++) {
+            counts[data[i]]++;
+        }
+    }
+
+    constexpr size_t HISTOGRAM_LANES = 4;
+
+    // histogramAdd into HISTOGRAM_LANES interleaved copies, lane_counts[id * HISTOGRAM_LANES + row % 4],
+    // so runs of an ID increment different words instead of waiting on each other's store.
+    // Pays off while the copies stay cache resident (small dictionaries); the caller sums the lanes.
+    inline void histogramAddLanes(const uint32_t* data, size_t begin, size_t end, uint32_t* lane_counts) {
+        size_t i = begin;
+        for (; i + 8 <= end; i += 8) {
+            __m256i ids = _mm256_loadu_si256((const __m256i*)(data + i));
+            __m256i first = _mm256_broadcastd_epi32(_mm256_castsi256_si128(ids));
+            if (_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(ids, first))) == 0xFF) {
+                lane_counts[data[i] * HISTOGRAM_LANES] += 8;
+                continue;
+            }
+            for (size_t j = i; j < i + 8; j += HISTOGRAM_LANES) {
+                lane_counts[data[j] * HISTOGRAM_LANES]++;
+                lane_counts[data[j + 1] * HISTOGRAM_LANES + 1]++;
+                lane_counts[data[j + 2] * HISTOGRAM_LANES + 2]++;
+                lane_counts[data[j + 3] * HISTOGRAM_LANES + 3]++;
+            }
+        }
+        for (; i < end; i++) {
+            lane_counts[data[i] * HISTOGRAM_LANES]++;
+        }
+    }
+
+    // lengths[i] = length of value ids[i], gathered from an arena offset table.
+    // Returns the total number of bytes.
+    inline size_t gatherLengths(const uint32_t* ids, size_t count,
+                                const uint32_t* value_offsets, uint32_t* lengths) {
+        __m256i total = _mm256_setzero_si256();
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            __m256i id_vec = _mm256_loadu_si256((const __m256i*)(ids + i));
+            __m256i starts = _mm256_i32gather_epi32((const int*)value_offsets, id_vec, 4);
+            __m256i ends = _mm256_i32gather_epi32((const int*)(value_offsets + 1), id_vec, 4);
+            __m256i len = _mm256_sub_epi32(ends, starts);
+            _mm256_storeu_si256((__m256i*)(lengths + i), len);
+            // Widen to 64-bit lanes so the running total cannot overflow
+            total = _mm256_add_epi64(total, _mm256_cvtepu32_epi64(_mm256_castsi256_si128(len)));
+            total = _mm256_add_epi64(total, _mm256_cvtepu32_epi64(_mm256_extracti128_si256(len, 1)));
+        }
+        alignas(32) uint64_t lanes[4];
+        _mm256_store_si256((__m256i*)lanes, total);
+        size_t bytes = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+        for (; i < count; i++) {
+            lengths[i] = value_offsets[ids[i] + 1] - value_offsets[ids[i]];
+            bytes += lengths[i];
+        }
+        return bytes;
+    }
+
+    // ids[i] = data[positions[i]]
+    inline void gatherIds(const uint32_t* data, const size_t* positions, size_t count, uint32_t* ids) {
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            __m256i pos = _mm256_loadu_si256((const __m256i*)(positions + i));
+            __m128i gathered = _mm256_i64gather_epi32((const int*)data, pos, 4);
+            _mm_storeu_si128((__m128i*)(ids + i), gathered);
+        }
+        for (; i < count; i++) {
+            ids[i] = data[positions[i]];
+        }
+    }
+
+    // Largest ID in the window, or 0 for an empty one. Loads check it against the
+    // dictionary size, since the kernels above index bitmaps and counts by ID unchecked
+    inline uint32_t maxId(const uint32_t* data, size_t begin, size_t end) {
+        __m256i max_vec = _mm256_setzero_si256();
+        size_t i = begin;
+        for (; i + 8 <= end; i += 8) {
+            max_vec = _mm256_max_epu32(max_vec, _mm256_loadu_si256((const __m256i*)(data + i)));
+        }
+        alignas(32) uint32_t lanes[8];
+        _mm256_store_si256((__m256i*)lanes, max_vec);
+        uint32_t max_id = *std::max_element(lanes, lanes + 8);
+        for (; i < end; i++) {
+            max_id = std::max(max_id, data[i]);
+        }
+        return max_id;
+    }
+
+} // namespace ScanKernels
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "result_set.h"
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Boolean combination of query results (AND / OR / AND NOT).
+// Position lists must be sorted and free of duplicates; outputs are as well.
+namespace SetOperations {
+    // Skewed inputs switch from the SIMD block kernels to galloping search
+    constexpr size_t GALLOP_RATIO = 32;
+
+    // Sorted position lists
+    void intersect(const uint32_t* a, size_t a_size, const uint32_t* b, size_t b_size,
+                   std::vector<uint32_t>& out);
+    void unite(const uint32_t* a, size_t a_size, const uint32_t* b, size_t b_size,
+               std::vector<uint32_t>& out);
+    void subtract(const uint32_t* a, size_t a_size, const uint32_t* b, size_t b_size,
+                  std::vector<uint32_t>& out);
+
+    void intersect(const std::vector<uint32_t>& a, const std::vector<uint32_t>& b, std::vector<uint32_t>& out);
+    void unite(const std::vector<uint32_t>& a, const std::vector<uint32_t>& b, std::vector<uint32_t>& out);
+    void subtract(const std::vector<uint32_t>& a, const std::vector<uint32_t>& b, std::vector<uint32_t>& out);
+
+    // Row bitmaps; the shorter input is treated as zero-extended
+    void intersectBitmaps(const std::vector<uint64_t>& a, const std::vector<uint64_t>& b,
+                          std::vector<uint64_t>& out);
+    void uniteBitmaps(const std::vector<uint64_t>& a, const std::vector<uint64_t>& b,
+                      std::vector<uint64_t>& out);
+    void subtractBitmaps(const std::vector<uint64_t>& a, const std::vector<uint64_t>& b,
+                         std::vector<uint64_t>& out);
+
+    // Result sets in any encoding; the result is re-encoded by its own density
+    ResultSet intersect(const ResultSet& a, const ResultSet& b);
+    ResultSet unite(const ResultSet& a, const ResultSet& b);
+    ResultSet subtract(const ResultSet& a, const ResultSet& b);
+}
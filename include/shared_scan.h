@@ -0,0 +1,74 @@
+#pragma once
+
+#include "dictionary_codec.h"
+#include <vector>
+#include <string>
+#include <list>
+#include <future>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <exception>
+#include <cstdint>
+#include <cstddef>
+
+// Cooperative scan scheduler: concurrent queries share one circular scan of the
+// column instead of each streaming it through memory. A query attaches at the next
+// block boundary, is evaluated on every block while it is cache resident, and
+// completes once the scan has come back around to where it joined.
+//
+// Queries in flight when the codec is re-encoded or reloaded fail with a
+// runtime_error; appended rows are fine and are simply outside their windows.
+class SharedScanScheduler {
+private:
+    struct ScanQuery {
+        std::vector<uint32_t> ids;     // Sorted; a single ID uses the equality kernel
+        std::vector<uint32_t> bitmap;  // ID bitmap for multi-ID queries
+        size_t num_rows;               // Column size when the query was submitted
+        size_t epoch;                  // Column epoch the IDs and bitmap were resolved in
+        size_t rows_covered;
+        size_t wrap_index;             // Results before the scan wrapped to row 0
+        std::vector<size_t> results;
+        std::exception_ptr error;      // Set instead of scanning once the column is rewritten
+        std::promise<std::vector<size_t>> done;
+    };
+
+    const DictionaryCodec& codec;
+    std::chrono::microseconds batch_window;
+
+    std::mutex queue_mutex;
+    std::condition_variable queue_cv;
+    std::list<ScanQuery> pending;  // Owned by the submitters until attached
+    std::list<ScanQuery> active;   // Owned by the scan thread
+    size_t cursor;
+    bool stopping;
+
+    std::atomic<size_t> blocks_scanned;
+    std::atomic<size_t> queries_served;
+    std::thread scan_thread;
+
+    std::vector<size_t> submit(const std::function<void(std::vector<uint32_t>&)>& resolve_ids);
+    void scanLoop();
+    void scanBlock();
+
+public:
+    static constexpr size_t SCAN_BLOCK_ROWS = 1 << 16;  // 256 KB of IDs, sized for L2
+
+    // batch_window: how long an idle scanner waits for more queries before starting
+    explicit SharedScanScheduler(const DictionaryCodec& codec,
+                                 std::chrono::microseconds batch_window = std::chrono::microseconds(200));
+    ~SharedScanScheduler();
+
+    SharedScanScheduler(const SharedScanScheduler&) = delete;
+    SharedScanScheduler& operator=(const SharedScanScheduler&) = delete;
+
+    // Blocking; same results as findMatchesSIMD / prefixSearchInto (sorted row positions)
+    std::vector<size_t> findMatches(const std::string& target);
+    std::vector<size_t> prefixMatches(const std::string& prefix);
+
+    size_t getBlocksScanned() const { return blocks_scanned; }
+    size_t getQueriesServed() const { return queries_served; }
+};
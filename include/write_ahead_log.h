@@ -0,0 +1,97 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+// One appendValues call: the dictionary entries it created (IDs base_dict_size
+// onward) and its rows as (id, run length) pairs, starting at first_row
+struct AppendRecord {
+    uint64_t base_dict_size = 0;
+    uint64_t first_row = 0;
+    std::vector<std::string> entries;
+    std::vector<std::pair<uint32_t, uint32_t>> runs;
+
+    uint64_t rowCount() const;
+};
+
+// fsyncs the directory holding path, which makes a rename into it durable; throws on failure
+void syncDirectory(const std::string& path);
+
+// Append-only redo log with group commit. Records are buffered by append() and made
+// durable by sync(): the first waiting thread writes everything buffered and issues a
+// single fdatasync for the whole group, while later callers wait for it or lead the
+// next group. Once the log outgrows checkpoint_bytes a background thread runs the
+// checkpoint callback, which is expected to snapshot the state and truncateBefore().
+//
+// A failed write or fdatasync cuts the file back to the last durable record and fails
+// the log: the kernel may already have dropped the unsynced pages, so no later sync
+// could vouch for them, and every later append, sync or truncateBefore throws.
+//
+// Record layout: RecordHeader {magic, payload length, FNV-1a checksum} then the payload
+// {base_dict_size, first_row, entry count, run count, entries {uint32 length, bytes},
+// runs {uint32 id, uint32 length}}. A torn or corrupt tail ends the log.
+class WriteAheadLog {
+private:
+    std::string path;
+    int fd;
+    uint64_t file_base;        // Log position of the first byte in the file
+    uint64_t appended;         // Log position after the last buffered record
+    uint64_t durable;          // Log position known to be on disk
+    std::vector<uint8_t> buffer;
+    bool flushing;
+    bool failed;
+    bool holding;              // sync() waits for releaseAcknowledgements()
+    size_t sync_count;
+    std::chrono::microseconds commit_window;
+
+    size_t checkpoint_bytes;
+    std::function<void()> checkpoint;
+    bool checkpoint_requested;
+    bool closed;
+    std::thread checkpointer;
+
+    mutable std::mutex mutex;
+    std::condition_variable durable_cv;
+    std::condition_variable checkpoint_cv;
+
+    void flushLocked(std::unique_lock<std::mutex>& lock);
+    void checkpointLoop();
+
+public:
+    WriteAheadLog(const std::string& path, size_t checkpoint_bytes, std::function<void()> checkpoint,
+                  std::chrono::microseconds commit_window = std::chrono::microseconds(0));
+    ~WriteAheadLog();
+
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    // Buffers a record; returns the log position to pass to sync()
+    uint64_t append(const AppendRecord& record);
+    // Blocks until everything up to position is on disk
+    void sync(uint64_t position);
+    // While held, sync() still writes records but only returns once released, e.g. until
+    // the snapshot the log continues is on disk; abort() fails the log instead
+    void holdAcknowledgements();
+    void releaseAcknowledgements();
+    void abort();
+    // Drops the records before position (already captured by a snapshot)
+    void truncateBefore(uint64_t position);
+    // Renames the file, which stays open, to new_path and syncs the directory
+    void renameTo(const std::string& new_path);
+    // Flushes (unless the log failed), stops the checkpoint thread and closes the file
+    void close();
+
+    uint64_t getPosition() const;
+    size_t getFileSize() const;
+    size_t getSyncCount() const;
+
+    // Calls apply for each intact record in order; returns the length of the intact prefix
+    static size_t replay(const std::string& path, const std::function<void(const AppendRecord&)>& apply);
+};
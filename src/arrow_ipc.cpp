@@ -0,0 +1,691 @@
+#include "arrow_ipc.h"
+#include <algorithm>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <cstring>
+
+namespace ArrowIpc {
+namespace {
+
+constexpr uint32_t CONTINUATION = 0xFFFFFFFF;
+constexpr int16_t METADATA_V4 = 3;
+constexpr int16_t METADATA_V5 = 4;
+constexpr int64_t DICTIONARY_ID = 0;
+
+// Union tags from Message.fbs and Schema.fbs
+constexpr uint8_t HEADER_SCHEMA = 1;
+constexpr uint8_t HEADER_DICTIONARY_BATCH = 2;
+constexpr uint8_t HEADER_RECORD_BATCH = 3;
+constexpr uint8_t TYPE_BINARY = 4;
+constexpr uint8_t TYPE_UTF8 = 5;
+constexpr uint8_t TYPE_LARGE_BINARY = 19;
+constexpr uint8_t TYPE_LARGE_UTF8 = 20;
+
+struct FieldNode {
+    int64_t length;
+    int64_t null_count;
+};
+
+struct BufferRef {
+    int64_t offset;  // Bytes from the start of the message body
+    int64_t length;
+};
+
+[[noreturn]] void invalid(const std::string& reason) {
+    throw std::runtime_error("Invalid Arrow stream: " + reason);
+}
+
+size_t paddedLength(size_t length) {
+    return (length + BUFFER_ALIGNMENT - 1) & ~(BUFFER_ALIGNMENT - 1);
+}
+
+// FlatBuffers encoder. Like the reference builder it fills the buffer back to front, so
+// children are finished before the tables that point at them, and positions count
+// bytes from the end. Arrow metadata is a few hundred bytes, so prepending is cheap
+class FlatBufferBuilder {
+private:
+    std::vector<uint8_t> buffer;
+    size_t max_align = 1;
+    std::vector<std::pair<uint16_t, uint32_t>> fields;  // (slot, position) in the open table
+    uint32_t table_start = 0;
+
+    void prepend(const void* data, size_t length) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        buffer.insert(buffer.begin(), bytes, bytes + length);
+    }
+    template <typename T>
+    void push(T value) {
+        prepend(&value, sizeof(T));
+    }
+    // Pads so that the position is a multiple of alignment once length more bytes are added
+    void align(size_t alignment, size_t length = 0) {
+        max_align = std::max(max_align, alignment);
+        buffer.insert(buffer.begin(), (alignment - (buffer.size() + length) % alignment) % alignment, 0);
+    }
+    // uoffsets are relative to their own location and always point towards the end
+    void pushOffset(uint32_t target) {
+        align(sizeof(uint32_t));
+        push<uint32_t>(static_cast<uint32_t>(buffer.size() + sizeof(uint32_t) - target));
+    }
+
+public:
+    uint32_t position() const { return static_cast<uint32_t>(buffer.size()); }
+
+    uint32_t createString(const std::string& value) {
+        align(sizeof(uint32_t), value.size() + 1);
+        push<uint8_t>(0);
+        prepend(value.data(), value.size());
+        push<uint32_t>(static_cast<uint32_t>(value.size()));
+        return position();
+    }
+
+    template <typename T>
+    uint32_t createStructVector(const std::vector<T>& values) {
+        size_t length = values.size() * sizeof(T);
+        align(sizeof(uint32_t), length);
+        align(alignof(T), length);
+        prepend(values.data(), length);
+        push<uint32_t>(static_cast<uint32_t>(values.size()));
+        return position();
+    }
+
+    uint32_t createTableVector(const std::vector<uint32_t>& tables) {
+        align(sizeof(uint32_t), tables.size() * sizeof(uint32_t));
+        for (size_t i = tables.size(); i-- > 0;) {
+            pushOffset(tables[i]);
+        }
+        push<uint32_t>(static_cast<uint32_t>(tables.size()));
+        return position();
+    }
+
+    void startTable() {
+        fields.clear();
+        table_start = position();
+    }
+
+    template <typename T>
+    void addScalar(uint16_t slot, T value) {
+        align(sizeof(T));
+        push(value);
+        fields.emplace_back(slot, position());
+    }
+
+    void addOffset(uint16_t slot, uint32_t target) {
+        pushOffset(target);
+        fields.emplace_back(slot, position());
+    }
+
+    // Writes the table's vtable right in front of it: {vtable bytes, table bytes, field offsets}
+    uint32_t endTable() {
+        align(sizeof(int32_t));
+        push<int32_t>(0);
+        uint32_t table = position();
+
+        uint16_t slots = 0;
+        for (const auto& field : fields) {
+            slots = std::max<uint16_t>(slots, field.first + 1);
+        }
+        std::vector<uint16_t> vtable(slots, 0);
+        for (const auto& [slot, field_position] : fields) {
+            vtable[slot] = static_cast<uint16_t>(table - field_position);
+        }
+        for (size_t i = slots; i-- > 0;) {
+            push<uint16_t>(vtable[i]);
+        }
+        push<uint16_t>(static_cast<uint16_t>(table - table_start));
+        push<uint16_t>(static_cast<uint16_t>(sizeof(uint16_t) * (2 + slots)));
+
+        // The table starts with the signed distance back to its vtable
+        int32_t vtable_distance = static_cast<int32_t>(position() - table);
+        std::memcpy(buffer.data() + buffer.size() - table, &vtable_distance, sizeof(vtable_distance));
+        return table;
+    }
+
+    std::vector<uint8_t> finish(uint32_t root) {
+        align(max_align, sizeof(uint32_t));
+        pushOffset(root);
+        return std::move(buffer);
+    }
+};
+
+// Bounds-checked view of one FlatBuffers table; positions are bytes from the buffer start
+class FlatTable {
+private:
+    const uint8_t* data;
+    size_t size;
+    size_t table;
+    size_t vtable;
+    uint16_t vtable_size;
+
+    void check(size_t position, size_t length) const {
+        if (position > size || length > size - position) {
+            invalid("metadata out of bounds");
+        }
+    }
+    template <typename T>
+    T load(size_t position) const {
+        check(position, sizeof(T));
+        T value;
+        std::memcpy(&value, data + position, sizeof(T));
+        return value;
+    }
+    // Position of the field in slot, or 0 when it is absent
+    size_t field(uint16_t slot) const {
+        size_t entry = sizeof(uint16_t) * (2 + slot);
+        if (entry + sizeof(uint16_t) > vtable_size) {
+            return 0;
+        }
+        uint16_t offset = load<uint16_t>(vtable + entry);
+        return offset == 0 ? 0 : table + offset;
+    }
+    size_t follow(size_t position) const {
+        return position + load<uint32_t>(position);
+    }
+
+public:
+    FlatTable(const uint8_t* data, size_t size, size_t table) : data(data), size(size), table(table) {
+        int64_t distance = load<int32_t>(table);
+        if (distance > static_cast<int64_t>(table) || static_cast<int64_t>(table) - distance > static_cast<int64_t>(size)) {
+            invalid("metadata out of bounds");
+        }
+        vtable = table - distance;
+        vtable_size = load<uint16_t>(vtable);
+        check(vtable, vtable_size);
+    }
+
+    static FlatTable root(const uint8_t* data, size_t size) {
+        FlatTable probe(data, size);
+        return FlatTable(data, size, probe.follow(0));
+    }
+
+    bool has(uint16_t slot) const { return field(slot) != 0; }
+
+    template <typename T>
+    T scalar(uint16_t slot, T fallback) const {
+        size_t position = field(slot);
+        return position ? load<T>(position) : fallback;
+    }
+
+    FlatTable child(uint16_t slot, const char* what) const {
+        size_t position = field(slot);
+        if (!position) {
+            invalid(std::string("missing ") + what);
+        }
+        return FlatTable(data, size, follow(position));
+    }
+
+    // Element count of a vector field (0 when absent); elements follow its position
+    size_t vectorLength(uint16_t slot, size_t element_size, size_t& elements) const {
+        size_t position = field(slot);
+        if (!position) {
+            elements = 0;
+            return 0;
+        }
+        size_t vector = follow(position);
+        size_t count = load<uint32_t>(vector);
+        elements = vector + sizeof(uint32_t);
+        check(elements, count * element_size);
+        return count;
+    }
+
+    template <typename T>
+    std::vector<T> structs(uint16_t slot) const {
+        size_t elements;
+        std::vector<T> values(vectorLength(slot, sizeof(T), elements));
+        if (!values.empty()) {
+            std::memcpy(values.data(), data + elements, values.size() * sizeof(T));
+        }
+        return values;
+    }
+
+    FlatTable tableAt(uint16_t slot, size_t index, const char* what) const {
+        size_t elements;
+        if (index >= vectorLength(slot, sizeof(uint32_t), elements)) {
+            invalid(std::string("missing ") + what);
+        }
+        return FlatTable(data, size, follow(elements + index * sizeof(uint32_t)));
+    }
+
+    std::string string(uint16_t slot) const {
+        size_t elements;
+        size_t length = vectorLength(slot, 1, elements);
+        return std::string(reinterpret_cast<const char*>(data) + elements, length);
+    }
+
+private:
+    // Only for reading the root offset
+    FlatTable(const uint8_t* data, size_t size) : data(data), size(size), table(0), vtable(0), vtable_size(0) {}
+};
+
+// Message {version, header_type, header, bodyLength} around the finished header table
+std::vector<uint8_t> finishMessage(FlatBufferBuilder& builder, uint8_t header_type, uint32_t header,
+                                   int64_t body_length) {
+    builder.startTable();
+    builder.addScalar<int64_t>(3, body_length);
+    builder.addOffset(2, header);
+    builder.addScalar<int16_t>(0, METADATA_V5);
+    builder.addScalar<uint8_t>(1, header_type);
+    return builder.finish(builder.endTable());
+}
+
+std::vector<uint8_t> schemaMessage(const std::string& name, bool large_offsets) {
+    FlatBufferBuilder builder;
+    uint32_t field_name = builder.createString(name);
+    uint32_t children = builder.createTableVector({});
+
+    builder.startTable();  // Utf8 / LargeUtf8 have no fields
+    uint32_t value_type = builder.endTable();
+
+    builder.startTable();  // Int {bitWidth, is_signed}
+    builder.addScalar<int32_t>(0, 32);
+    builder.addScalar<uint8_t>(1, 1);
+    uint32_t index_type = builder.endTable();
+
+    builder.startTable();  // DictionaryEncoding {id, indexType, isOrdered}
+    builder.addScalar<int64_t>(0, DICTIONARY_ID);
+    builder.addOffset(1, index_type);
+    builder.addScalar<uint8_t>(2, 0);
+    uint32_t encoding = builder.endTable();
+
+    builder.startTable();  // Field {name, nullable, type_type, type, dictionary, children}
+    builder.addOffset(0, field_name);
+    builder.addOffset(3, value_type);
+    builder.addOffset(4, encoding);
+    builder.addOffset(5, children);
+    builder.addScalar<uint8_t>(1, 0);
+    builder.addScalar<uint8_t>(2, large_offsets ? TYPE_LARGE_UTF8 : TYPE_UTF8);
+    uint32_t field = builder.endTable();
+    uint32_t fields = builder.createTableVector({field});
+
+    builder.startTable();  // Schema {endianness, fields}
+    builder.addOffset(1, fields);
+    builder.addScalar<int16_t>(0, 0);
+    return finishMessage(builder, HEADER_SCHEMA, builder.endTable(), 0);
+}
+
+// RecordBatch of one column, wrapped in a DictionaryBatch for the dictionary
+std::vector<uint8_t> batchMessage(uint8_t header_type, int64_t length, const std::vector<BufferRef>& buffers,
+                                  int64_t body_length) {
+    FlatBufferBuilder builder;
+    uint32_t nodes = builder.createStructVector(std::vector<FieldNode>{{length, 0}});
+    uint32_t buffer_refs = builder.createStructVector(buffers);
+
+    builder.startTable();  // RecordBatch {length, nodes, buffers}
+    builder.addScalar<int64_t>(0, length);
+    builder.addOffset(1, nodes);
+    builder.addOffset(2, buffer_refs);
+    uint32_t header = builder.endTable();
+
+    if (header_type == HEADER_DICTIONARY_BATCH) {
+        builder.startTable();  // DictionaryBatch {id, data, isDelta}
+        builder.addScalar<int64_t>(0, DICTIONARY_ID);
+        builder.addOffset(1, header);
+        header = builder.endTable();
+    }
+    return finishMessage(builder, header_type, header, body_length);
+}
+
+class StreamWriter {
+private:
+    std::ostream& out;
+    size_t written = 0;
+
+    void write(const void* data, size_t length) {
+        out.write(static_cast<const char*>(data), length);
+        written += length;
+    }
+
+public:
+    explicit StreamWriter(std::ostream& out) : out(out) {}
+
+    // Encapsulated message: continuation marker, metadata length, metadata padded so
+    // the body that follows starts on a BUFFER_ALIGNMENT boundary
+    void message(const std::vector<uint8_t>& metadata) {
+        size_t start = written + 2 * sizeof(uint32_t);
+        uint32_t length = static_cast<uint32_t>(paddedLength(start + metadata.size()) - start);
+        write(&CONTINUATION, sizeof(CONTINUATION));
+        write(&length, sizeof(length));
+        write(metadata.data(), metadata.size());
+        pad(length - metadata.size());
+    }
+
+    void buffer(const void* data, size_t length) {
+        write(data, length);
+        pad(paddedLength(length) - length);
+    }
+
+    void pad(size_t length) {
+        static const char zeros[BUFFER_ALIGNMENT] = {};
+        write(zeros, length);
+    }
+
+    void end() {
+        uint32_t marker[2] = {CONTINUATION, 0};
+        write(marker, sizeof(marker));
+    }
+};
+
+struct Message {
+    uint8_t header_type;
+    FlatTable header;
+    const uint8_t* body;
+    size_t body_length;
+};
+
+// Reads the message at offset, accepting the pre-1.0 form without a continuation
+// marker; empty at the end-of-stream marker or the end of the data
+std::optional<Message> readMessage(const uint8_t* data, size_t size, size_t& offset) {
+    auto readLength = [&]() {
+        if (size - offset < sizeof(uint32_t)) {
+            invalid("truncated message");
+        }
+        uint32_t length;
+        std::memcpy(&length, data + offset, sizeof(length));
+        offset += sizeof(length);
+        return length;
+    };
+    if (offset == size) {
+        return std::nullopt;
+    }
+    uint32_t length = readLength();
+    if (length == CONTINUATION) {
+        length = readLength();
+    }
+    if (length == 0) {
+        return std::nullopt;
+    }
+    if (length > size - offset) {
+        invalid("truncated metadata");
+    }
+    FlatTable root = FlatTable::root(data + offset, length);
+    offset += length;
+
+    if (root.scalar<int16_t>(0, 0) < METADATA_V4) {
+        invalid("unsupported metadata version");
+    }
+    int64_t body_length = root.scalar<int64_t>(3, 0);
+    if (body_length < 0 || static_cast<uint64_t>(body_length) > size - offset) {
+        invalid("truncated message body");
+    }
+    Message message{root.scalar<uint8_t>(1, 0), root.child(2, "message header"), data + offset,
+                    static_cast<size_t>(body_length)};
+    offset += body_length;
+    return message;
+}
+
+// One-column RecordBatch: its length and the body range of each buffer
+struct ColumnBatch {
+    size_t length;
+    std::vector<std::pair<const uint8_t*, size_t>> buffers;
+};
+
+ColumnBatch readColumnBatch(const FlatTable& batch, const Message& message, size_t buffer_count, const char* what) {
+    if (batch.has(3)) {
+        invalid("compressed bodies are not supported");
+    }
+    std::vector<FieldNode> nodes = batch.structs<FieldNode>(1);
+    std::vector<BufferRef> buffers = batch.structs<BufferRef>(2);
+    if (nodes.size() != 1 || buffers.size() != buffer_count) {
+        invalid(std::string("unexpected layout for the ") + what);
+    }
+    if (nodes[0].length < 0 || nodes[0].null_count != 0) {
+        invalid(std::string("nulls are not supported in the ") + what);
+    }
+
+    ColumnBatch column{static_cast<size_t>(nodes[0].length), {}};
+    for (const auto& buffer : buffers) {
+        if (buffer.offset < 0 || buffer.length < 0 ||
+            static_cast<uint64_t>(buffer.offset) > message.body_length ||
+            static_cast<uint64_t>(buffer.length) > message.body_length - buffer.offset) {
+            invalid(std::string("buffer out of bounds in the ") + what);
+        }
+        column.buffers.emplace_back(message.body + buffer.offset, buffer.length);
+    }
+    return column;
+}
+
+template <typename Offset>
+void readOffsets(const ColumnBatch& batch, DictionaryColumn& column) {
+    size_t count = batch.length;
+    const auto& [offset_data, offset_bytes] = batch.buffers[1];
+    const auto& [value_data, value_length] = batch.buffers[2];
+    if (count == 0 && offset_bytes == 0) {
+        column.owned_offsets.assign(1, 0);
+        column.value_offsets = column.owned_offsets.data();
+        column.value_bytes = reinterpret_cast<const char*>(value_data);
+        return;
+    }
+    if (offset_bytes / sizeof(Offset) < count + 1) {
+        invalid("dictionary offsets buffer too short");
+    }
+
+    auto offsetAt = [offset_data](size_t i) {
+        Offset value;
+        std::memcpy(&value, offset_data + i * sizeof(Offset), sizeof(Offset));
+        return value;
+    };
+    Offset first = offsetAt(0);
+    Offset previous = first;
+    for (size_t i = 1; i <= count; i++) {
+        Offset current = offsetAt(i);
+        if (current < previous) {
+            invalid("dictionary offsets are not ascending");
+        }
+        previous = current;
+    }
+    if (first < 0 || static_cast<uint64_t>(previous) > value_length ||
+        static_cast<uint64_t>(previous - first) > std::numeric_limits<uint32_t>::max()) {
+        invalid("dictionary offsets out of bounds");
+    }
+
+    column.value_bytes = reinterpret_cast<const char*>(value_data) + first;
+    column.value_bytes_length = previous - first;
+    bool aligned = reinterpret_cast<uintptr_t>(offset_data) % alignof(uint32_t) == 0;
+    if (sizeof(Offset) == sizeof(uint32_t) && first == 0 && aligned) {
+        column.value_offsets = reinterpret_cast<const uint32_t*>(offset_data);
+        return;
+    }
+    column.owned_offsets.resize(count + 1);
+    for (size_t i = 0; i <= count; i++) {
+        column.owned_offsets[i] = static_cast<uint32_t>(offsetAt(i) - first);
+    }
+    column.value_offsets = column.owned_offsets.data();
+}
+
+template <typename Index>
+void appendIds(const uint8_t* data, size_t count, size_t dict_size, std::vector<uint32_t>& out) {
+    size_t start = out.size();
+    out.resize(start + count);
+    for (size_t i = 0; i < count; i++) {
+        Index id;
+        std::memcpy(&id, data + i * sizeof(Index), sizeof(Index));
+        if constexpr (std::is_signed_v<Index>) {
+            if (id < 0) {
+                invalid("dictionary index out of range");
+            }
+        }
+        if (static_cast<uint64_t>(id) >= dict_size) {
+            invalid("dictionary index out of range");
+        }
+        out[start + i] = static_cast<uint32_t>(id);
+    }
+}
+
+void appendIds(const uint8_t* data, size_t count, int32_t bit_width, bool is_signed, size_t dict_size,
+               std::vector<uint32_t>& out) {
+    switch (bit_width) {
+        case 8:
+            return is_signed ? appendIds<int8_t>(data, count, dict_size, out)
+                             : appendIds<uint8_t>(data, count, dict_size, out);
+        case 16:
+            return is_signed ? appendIds<int16_t>(data, count, dict_size, out)
+                             : appendIds<uint16_t>(data, count, dict_size, out);
+        case 32:
+            return is_signed ? appendIds<int32_t>(data, count, dict_size, out)
+                             : appendIds<uint32_t>(data, count, dict_size, out);
+        default:
+            return is_signed ? appendIds<int64_t>(data, count, dict_size, out)
+                             : appendIds<uint64_t>(data, count, dict_size, out);
+    }
+}
+
+}  // namespace
+
+void writeDictionaryStream(std::ostream& out, const std::string& name, const DictionaryColumnView& column) {
+    static const uint32_t empty_offsets[1] = {0};
+    const uint32_t* offsets = column.dict_size > 0 ? column.value_offsets : empty_offsets;
+    size_t value_length = offsets[column.dict_size];
+
+    // Utf8 offsets are int32; larger arenas go out as LargeUtf8 with widened offsets
+    bool large_offsets = value_length > static_cast<size_t>(std::numeric_limits<int32_t>::max());
+    std::vector<int64_t> wide_offsets;
+    const void* offset_data = offsets;
+    size_t offset_length = (column.dict_size + 1) * sizeof(uint32_t);
+    if (large_offsets) {
+        wide_offsets.assign(offsets, offsets + column.dict_size + 1);
+        offset_data = wide_offsets.data();
+        offset_length = wide_offsets.size() * sizeof(int64_t);
+    }
+
+    StreamWriter writer(out);
+    writer.message(schemaMessage(name, large_offsets));
+
+    // Buffers: validity (empty, no nulls), offsets, values
+    size_t values_start = paddedLength(offset_length);
+    writer.message(batchMessage(HEADER_DICTIONARY_BATCH, column.dict_size,
+                                {{0, 0},
+                                 {0, static_cast<int64_t>(offset_length)},
+                                 {static_cast<int64_t>(values_start), static_cast<int64_t>(value_length)}},
+                                values_start + paddedLength(value_length)));
+    writer.buffer(offset_data, offset_length);
+    writer.buffer(column.value_bytes, value_length);
+
+    // IDs never exceed the dictionary size, so they are valid int32 indices as stored
+    size_t id_length = column.num_rows * sizeof(uint32_t);
+    writer.message(batchMessage(HEADER_RECORD_BATCH, column.num_rows,
+                                {{0, 0}, {0, static_cast<int64_t>(id_length)}}, paddedLength(id_length)));
+    writer.buffer(column.ids, id_length);
+    writer.end();
+
+    if (!out) {
+        throw std::runtime_error("Failed to write Arrow stream");
+    }
+}
+
+DictionaryColumn readDictionaryStream(const uint8_t* data, size_t size) {
+    DictionaryColumn column;
+    bool have_schema = false;
+    bool have_dictionary = false;
+    bool large_offsets = false;
+    int64_t dictionary_id = 0;
+    int32_t bit_width = 32;
+    bool is_signed = true;
+    std::vector<ColumnBatch> batches;
+
+    size_t offset = 0;
+    while (std::optional<Message> message = readMessage(data, size, offset)) {
+        const FlatTable& header = message->header;
+        if (message->header_type == HEADER_SCHEMA) {
+            if (have_schema) {
+                invalid("more than one schema");
+            }
+            have_schema = true;
+            if (header.scalar<int16_t>(0, 0) != 0) {
+                invalid("big-endian streams are not supported");
+            }
+            size_t elements;
+            size_t field_count = header.vectorLength(1, sizeof(uint32_t), elements);
+            if (field_count != 1) {
+                invalid("expected one column, found " + std::to_string(field_count));
+            }
+            FlatTable field = header.tableAt(1, 0, "field");
+            column.name = field.string(0);
+            uint8_t type = field.scalar<uint8_t>(2, 0);
+            if (type != TYPE_UTF8 && type != TYPE_BINARY && type != TYPE_LARGE_UTF8 && type != TYPE_LARGE_BINARY) {
+                invalid("column values must be utf8 or binary");
+            }
+            if (!field.has(4)) {
+                invalid("column is not dictionary-encoded");
+            }
+            FlatTable encoding = field.child(4, "dictionary encoding");
+            dictionary_id = encoding.scalar<int64_t>(0, 0);
+            if (encoding.has(1)) {
+                FlatTable index_type = encoding.child(1, "index type");
+                bit_width = index_type.scalar<int32_t>(0, 0);
+                is_signed = index_type.scalar<uint8_t>(1, 0) != 0;
+            }
+            if (bit_width != 8 && bit_width != 16 && bit_width != 32 && bit_width != 64) {
+                invalid("unsupported index width " + std::to_string(bit_width));
+            }
+            large_offsets = type == TYPE_LARGE_UTF8 || type == TYPE_LARGE_BINARY;
+        } else if (message->header_type == HEADER_DICTIONARY_BATCH) {
+            if (!have_schema) {
+                invalid("dictionary before schema");
+            }
+            if (header.scalar<int64_t>(0, 0) != dictionary_id) {
+                invalid("unknown dictionary id");
+            }
+            if (have_dictionary || header.scalar<uint8_t>(2, 0) != 0) {
+                invalid("delta and replacement dictionaries are not supported");
+            }
+            have_dictionary = true;
+            ColumnBatch batch = readColumnBatch(header.child(1, "dictionary data"), *message, 3, "dictionary");
+            if (batch.length > static_cast<size_t>(std::numeric_limits<int32_t>::max())) {
+                invalid("dictionary too large");
+            }
+            column.dict_size = batch.length;
+            if (large_offsets) {
+                readOffsets<int64_t>(batch, column);
+            } else {
+                readOffsets<int32_t>(batch, column);
+            }
+        } else if (message->header_type == HEADER_RECORD_BATCH) {
+            if (!have_dictionary) {
+                invalid("record batch before its dictionary");
+            }
+            ColumnBatch batch = readColumnBatch(header, *message, 2, "indices");
+            if (batch.buffers[1].second / (bit_width / 8) < batch.length) {
+                invalid("indices buffer too short");
+            }
+            batches.push_back(std::move(batch));
+        } else {
+            invalid("unsupported message type " + std::to_string(message->header_type));
+        }
+    }
+    if (!have_schema) {
+        invalid("missing schema");
+    }
+    if (!have_dictionary) {
+        column.owned_offsets.assign(1, 0);
+        column.value_offsets = column.owned_offsets.data();
+    }
+
+    // A single aligned batch of 32-bit indices is used in place once checked
+    const uint8_t* first_ids = batches.empty() ? nullptr : batches[0].buffers[1].first;
+    if (batches.size() == 1 && bit_width == 32 && reinterpret_cast<uintptr_t>(first_ids) % alignof(uint32_t) == 0) {
+        const uint32_t* ids = reinterpret_cast<const uint32_t*>(first_ids);
+        size_t count = batches[0].length;
+        uint32_t limit = static_cast<uint32_t>(column.dict_size);
+        uint32_t out_of_range = 0;
+        for (size_t i = 0; i < count; i++) {
+            out_of_range |= ids[i] >= limit;
+        }
+        if (out_of_range) {
+            invalid("dictionary index out of range");
+        }
+        column.ids = ids;
+        column.num_rows = count;
+        return column;
+    }
+
+    for (const auto& batch : batches) {
+        appendIds(batch.buffers[1].first, batch.length, bit_width, is_signed, column.dict_size, column.owned_ids);
+    }
+    column.ids = column.owned_ids.data();
+    column.num_rows = column.owned_ids.size();
+    return column;
+}
+
+}  // namespace ArrowIpc
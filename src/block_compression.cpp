@@ -0,0 +1,663 @@
+#include "block_compression.h"
+#include "scan_kernels.h"
+#include <zstd.h>
+#include <zdict.h>
+#include <immintrin.h>
+#include <thread>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <cstring>
+#include <exception>
+#include <limits>
+#include <memory>
+#include <numeric>
+
+namespace BlockCompression {
+
+namespace {
+
+size_t resolveThreads(int num_threads, size_t num_blocks) {
+    size_t threads = num_threads > 0 ? num_threads : std::max(1u, std::thread::hardware_concurrency());
+    return std::max<size_t>(1, std::min(threads, num_blocks));
+}
+
+// Runs work(block) for every block, blocks interleaved across threads
+template <typename Work>
+void forEachBlockParallel(size_t num_blocks, size_t num_threads, Work&& work) {
+    if (num_threads <= 1) {
+        for (size_t block = 0; block < num_blocks; block++) {
+            work(block);
+        }
+        return;
+    }
+    std::vector<std::thread> threads;
+    std::vector<std::exception_ptr> errors(num_threads);
+    threads.reserve(num_threads);
+    for (size_t t = 0; t < num_threads; t++) {
+        threads.emplace_back([&, t] {
+            try {
+                for (size_t block = t; block < num_blocks; block += num_threads) {
+                    work(block);
+                }
+            } catch (...) {
+                errors[t] = std::current_exception();
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (auto& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+constexpr size_t SAMPLE_SLICES = 4;
+constexpr size_t SAMPLE_SLICE_ROWS = 2048;
+constexpr int SAMPLE_LEVEL = 1;
+
+uint32_t zigzag(uint32_t delta) {
+    return (delta << 1) ^ static_cast<uint32_t>(static_cast<int32_t>(delta) >> 31);
+}
+
+// values[i] byte k goes to planes[k * count + i]
+void shufflePlanes(const uint32_t* values, size_t count, uint8_t* planes) {
+    for (size_t i = 0; i < count; i++) {
+        uint32_t value = values[i];
+        planes[i] = static_cast<uint8_t>(value);
+        planes[count + i] = static_cast<uint8_t>(value >> 8);
+        planes[2 * count + i] = static_cast<uint8_t>(value >> 16);
+        planes[3 * count + i] = static_cast<uint8_t>(value >> 24);
+    }
+}
+
+// Inverse of shufflePlanes, adding reference to every value
+void unshufflePlanes(const uint8_t* planes, size_t count, uint32_t reference, uint32_t* out) {
+    const uint8_t* p0 = planes;
+    const uint8_t* p1 = planes + count;
+    const uint8_t* p2 = planes + 2 * count;
+    const uint8_t* p3 = planes + 3 * count;
+    const __m256i ref_vec = _mm256_set1_epi32(reference);
+    
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m256i b0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p0 + i));
+        __m256i b1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p1 + i));
+        __m256i b2 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p2 + i));
+        __m256i b3 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p3 + i));
+        
+        // Interleave bytes, then byte pairs; each 128-bit lane assembles its own values
+        __m256i lo01 = _mm256_unpacklo_epi8(b0, b1);
+        __m256i hi01 = _mm256_unpackhi_epi8(b0, b1);
+        __m256i lo23 = _mm256_unpacklo_epi8(b2, b3);
+        __m256i hi23 = _mm256_unpackhi_epi8(b2, b3);
+        __m256i v0 = _mm256_unpacklo_epi16(lo01, lo23);  // values 0-3 | 16-19
+        __m256i v1 = _mm256_unpackhi_epi16(lo01, lo23);  // values 4-7 | 20-23
+        __m256i v2 = _mm256_unpacklo_epi16(hi01, hi23);  // values 8-11 | 24-27
+        __m256i v3 = _mm256_unpackhi_epi16(hi01, hi23);  // values 12-15 | 28-31
+        
+        __m256i* dst = reinterpret_cast<__m256i*>(out + i);
+        _mm256_storeu_si256(dst, _mm256_add_epi32(_mm256_permute2x128_si256(v0, v1, 0x20), ref_vec));
+        _mm256_storeu_si256(dst + 1, _mm256_add_epi32(_mm256_permute2x128_si256(v2, v3, 0x20), ref_vec));
+        _mm256_storeu_si256(dst + 2, _mm256_add_epi32(_mm256_permute2x128_si256(v0, v1, 0x31), ref_vec));
+        _mm256_storeu_si256(dst + 3, _mm256_add_epi32(_mm256_permute2x128_si256(v2, v3, 0x31), ref_vec));
+    }
+    for (; i < count; i++) {
+        out[i] = reference + (p0[i] | (p1[i] << 8) | (p2[i] << 16) | (static_cast<uint32_t>(p3[i]) << 24));
+    }
+}
+
+// Zigzag-decodes deltas in place and prefix-sums them back into values
+void undoDelta(uint32_t* values, size_t count) {
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i last_lane = _mm256_set1_epi32(7);
+    __m256i carry = _mm256_setzero_si256();
+    
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i z = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i));
+        __m256i x = _mm256_xor_si256(_mm256_srli_epi32(z, 1),
+                                     _mm256_sub_epi32(_mm256_setzero_si256(), _mm256_and_si256(z, one)));
+        // In-lane inclusive scan, then carry the low lane's total into the high lane
+        x = _mm256_add_epi32(x, _mm256_slli_si256(x, 4));
+        x = _mm256_add_epi32(x, _mm256_slli_si256(x, 8));
+        __m256i low_total = _mm256_shuffle_epi32(x, _MM_SHUFFLE(3, 3, 3, 3));
+        x = _mm256_add_epi32(x, _mm256_permute2x128_si256(low_total, low_total, 0x08));
+        x = _mm256_add_epi32(x, carry);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(values + i), x);
+        carry = _mm256_permutevar8x32_epi32(x, last_lane);
+    }
+    uint32_t running = i > 0 ? values[i - 1] : 0;
+    for (; i < count; i++) {
+        uint32_t z = values[i];
+        running += (z >> 1) ^ (0u - (z & 1));
+        values[i] = running;
+    }
+}
+
+// Writes the filtered block (count * 4 bytes) to out
+void applyFilter(BlockFilter filter, const uint32_t* ids, size_t count, uint32_t reference,
+                 std::vector<uint32_t>& scratch, uint8_t* out) {
+    switch (filter) {
+        case BlockFilter::None:
+            std::memcpy(out, ids, count * sizeof(uint32_t));
+            return;
+        case BlockFilter::ByteShuffle:
+            shufflePlanes(ids, count, out);
+            return;
+        case BlockFilter::FrameOfReference:
+            scratch.resize(count);
+            for (size_t i = 0; i < count; i++) {
+                scratch[i] = ids[i] - reference;
+            }
+            break;
+        case BlockFilter::Delta:
+            scratch.resize(count);
+            for (size_t i = 0; i < count; i++) {
+                scratch[i] = zigzag(ids[i] - (i > 0 ? ids[i - 1] : 0));
+            }
+            break;
+    }
+    shufflePlanes(scratch.data(), count, out);
+}
+
+constexpr size_t MIN_TRAINING_BLOCKS = 8;
+constexpr size_t MAX_ZDICT_BYTES = 16 << 10;
+
+using CCtxPtr = std::unique_ptr<ZSTD_CCtx, decltype(&ZSTD_freeCCtx)>;
+using DCtxPtr = std::unique_ptr<ZSTD_DCtx, decltype(&ZSTD_freeDCtx)>;
+using CDictPtr = std::unique_ptr<ZSTD_CDict, decltype(&ZSTD_freeCDict)>;
+using DDictPtr = std::unique_ptr<ZSTD_DDict, decltype(&ZSTD_freeDDict)>;
+
+void putVarint(std::vector<uint8_t>& out, uint32_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+uint32_t getVarint(const uint8_t*& in, const uint8_t* end) {
+    uint32_t value = 0;
+    for (int shift = 0; shift < 35 && in < end; shift += 7) {
+        uint8_t byte = *in++;
+        value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return value;
+        }
+    }
+    throw std::runtime_error("Corrupt dictionary block");
+}
+
+// Front-codes the sorted values order[first, first + entries) into one raw block
+void frontCodeBlock(const std::vector<std::string_view>& values, const std::vector<uint32_t>& order,
+                    size_t first, size_t entries, std::vector<uint8_t>& out) {
+    size_t restarts = (entries + DICTIONARY_RESTART_INTERVAL - 1) / DICTIONARY_RESTART_INTERVAL;
+    size_t table_bytes = restarts * sizeof(uint32_t);
+    out.assign(table_bytes, 0);
+    
+    std::string_view previous;
+    for (size_t i = 0; i < entries; i++) {
+        std::string_view value = values[order[first + i]];
+        size_t shared = 0;
+        if (i % DICTIONARY_RESTART_INTERVAL == 0) {
+            uint32_t offset = static_cast<uint32_t>(out.size() - table_bytes);
+            std::memcpy(out.data() + (i / DICTIONARY_RESTART_INTERVAL) * sizeof(uint32_t), &offset, sizeof(offset));
+        } else {
+            size_t limit = std::min(previous.length(), value.length());
+            while (shared < limit && previous[shared] == value[shared]) {
+                shared++;
+            }
+        }
+        putVarint(out, static_cast<uint32_t>(shared));
+        putVarint(out, static_cast<uint32_t>(value.length() - shared));
+        out.insert(out.end(), value.begin() + shared, value.end());
+        previous = value;
+    }
+}
+
+// Compresses every raw block, against trained when it is non-empty; returns the total frame bytes
+size_t compressDictionaryBlocks(const std::vector<std::vector<uint8_t>>& raw, const std::vector<uint8_t>& trained,
+                                int level, size_t num_threads, std::vector<std::vector<uint8_t>>& frames) {
+    CDictPtr cdict(trained.empty() ? nullptr : ZSTD_createCDict(trained.data(), trained.size(), level),
+                   ZSTD_freeCDict);
+    frames.assign(raw.size(), {});
+    forEachBlockParallel(raw.size(), num_threads, [&](size_t block) {
+        CCtxPtr ctx(ZSTD_createCCtx(), ZSTD_freeCCtx);
+        std::vector<uint8_t>& frame = frames[block];
+        frame.resize(ZSTD_compressBound(raw[block].size()));
+        size_t compressed = cdict
+            ? ZSTD_compress_usingCDict(ctx.get(), frame.data(), frame.size(), raw[block].data(),
+                                       raw[block].size(), cdict.get())
+            : ZSTD_compressCCtx(ctx.get(), frame.data(), frame.size(), raw[block].data(),
+                                raw[block].size(), level);
+        if (ZSTD_isError(compressed)) {
+            throw std::runtime_error("Dictionary compression failed");
+        }
+        frame.resize(compressed);
+    });
+    
+    size_t total = 0;
+    for (const auto& frame : frames) {
+        total += frame.size();
+    }
+    return total;
+}
+
+}  // namespace
+
+BlockFilter chooseFilter(const uint32_t* ids, size_t rows, uint32_t reference) {
+    // A few evenly spaced slices stand in for the whole block
+    size_t slice_rows = std::min(rows, SAMPLE_SLICE_ROWS);
+    size_t slices = rows > slice_rows ? std::min(SAMPLE_SLICES, rows / slice_rows) : 1;
+    size_t stride = slices > 1 ? (rows - slice_rows) / (slices - 1) : 0;
+    if (slice_rows == 0) {
+        return BlockFilter::None;
+    }
+    
+    std::vector<uint32_t> scratch;
+    std::vector<uint8_t> filtered(slices * slice_rows * sizeof(uint32_t));
+    std::vector<uint8_t> compressed(ZSTD_compressBound(filtered.size()));
+    
+    BlockFilter best = BlockFilter::None;
+    size_t best_size = std::numeric_limits<size_t>::max();
+    for (BlockFilter filter : {BlockFilter::None, BlockFilter::ByteShuffle,
+                               BlockFilter::FrameOfReference, BlockFilter::Delta}) {
+        for (size_t s = 0; s < slices; s++) {
+            applyFilter(filter, ids + s * stride, slice_rows, reference, scratch,
+                        filtered.data() + s * slice_rows * sizeof(uint32_t));
+        }
+        size_t size = ZSTD_compress(compressed.data(), compressed.size(), filtered.data(), filtered.size(),
+                                    SAMPLE_LEVEL);
+        if (!ZSTD_isError(size) && size < best_size) {
+            best = filter;
+            best_size = size;
+        }
+    }
+    return best;
+}
+
+void compressBlocks(const uint32_t* ids, size_t num_rows, size_t block_rows, int level, int num_threads,
+                    std::vector<std::vector<uint8_t>>& frames, bool choose_filters) {
+    size_t num_blocks = blockCount(num_rows, block_rows);
+    frames.assign(num_blocks, {});
+    
+    forEachBlockParallel(num_blocks, resolveThreads(num_threads, num_blocks), [&](size_t block) {
+        size_t first = block * block_rows;
+        size_t rows = std::min(block_rows, num_rows - first);
+        size_t bytes = rows * sizeof(uint32_t);
+        const uint32_t* block_ids = ids + first;
+        
+        FrameHeader header{};
+        header.reference = rows > 0 ? *std::min_element(block_ids, block_ids + rows) : 0;
+        BlockFilter filter = choose_filters ? chooseFilter(block_ids, rows, header.reference) : BlockFilter::None;
+        header.filter = static_cast<uint8_t>(filter);
+        
+        const void* source = block_ids;
+        std::vector<uint8_t> filtered;
+        if (filter != BlockFilter::None) {
+            std::vector<uint32_t> scratch;
+            filtered.resize(bytes);
+            applyFilter(filter, block_ids, rows, header.reference, scratch, filtered.data());
+            source = filtered.data();
+        }
+        
+        // ZSTD_compress sets up its own context, which is cheap next to a 1 MB block
+        std::vector<uint8_t>& frame = frames[block];
+        frame.resize(sizeof(FrameHeader) + ZSTD_compressBound(bytes));
+        std::memcpy(frame.data(), &header, sizeof(header));
+        size_t compressed = ZSTD_compress(frame.data() + sizeof(FrameHeader), frame.size() - sizeof(FrameHeader),
+                                          source, bytes, level);
+        if (ZSTD_isError(compressed)) {
+            throw std::runtime_error("Compression failed");
+        }
+        frame.resize(sizeof(FrameHeader) + compressed);
+    });
+}
+
+void decompressBlock(const uint8_t* frame, size_t length, uint32_t* out, size_t rows) {
+    FrameHeader header;
+    if (length < sizeof(FrameHeader)) {
+        throw std::runtime_error("Decompression failed");
+    }
+    std::memcpy(&header, frame, sizeof(header));
+    frame += sizeof(FrameHeader);
+    length -= sizeof(FrameHeader);
+    BlockFilter filter = static_cast<BlockFilter>(header.filter);
+    if (filter > BlockFilter::Delta) {
+        throw std::runtime_error("Unknown block filter " + std::to_string(header.filter));
+    }
+    
+    // Unfiltered frames land in place; filtered ones go through a per-thread plane buffer
+    size_t bytes = rows * sizeof(uint32_t);
+    static thread_local std::vector<uint8_t> planes;
+    uint8_t* target = reinterpret_cast<uint8_t*>(out);
+    if (filter != BlockFilter::None) {
+        planes.resize(bytes);
+        target = planes.data();
+    }
+    size_t decompressed = ZSTD_decompress(target, bytes, frame, length);
+    if (ZSTD_isError(decompressed) || decompressed != bytes) {
+        throw std::runtime_error("Decompression failed");
+    }
+    
+    if (filter != BlockFilter::None) {
+        uint32_t reference = filter == BlockFilter::FrameOfReference ? header.reference : 0;
+        unshufflePlanes(planes.data(), rows, reference, out);
+        if (filter == BlockFilter::Delta) {
+            undoDelta(out, rows);
+        }
+    }
+}
+
+void decompressBlocks(const uint8_t* payload, const std::vector<BlockRef>& blocks,
+                      const ColumnFileHeader& header, uint32_t* out, int num_threads) {
+    if (blocks.size() != blockCount(header.num_rows, header.block_rows)) {
+        throw std::runtime_error("Block index does not cover the column");
+    }
+    forEachBlockParallel(blocks.size(), resolveThreads(num_threads, blocks.size()), [&](size_t block) {
+        size_t first = block * header.block_rows;
+        decompressBlock(payload + blocks[block].offset, blocks[block].length, out + first,
+                        std::min<size_t>(header.block_rows, header.num_rows - first));
+    });
+}
+
+std::vector<BlockZone> buildZoneMap(const uint32_t* ids, size_t num_rows, size_t block_rows, int num_threads) {
+    std::vector<BlockZone> zones(blockCount(num_rows, block_rows));
+    forEachBlockParallel(zones.size(), resolveThreads(num_threads, zones.size()), [&](size_t block) {
+        size_t first = block * block_rows;
+        auto [min_it, max_it] = std::minmax_element(ids + first, ids + std::min(num_rows, first + block_rows));
+        zones[block] = BlockZone{*min_it, *max_it};
+    });
+    return zones;
+}
+
+std::vector<uint8_t> encodeDictionary(const std::vector<std::string_view>& values, int level, int num_threads) {
+    size_t count = values.size();
+    std::vector<uint32_t> order(count);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&values](uint32_t a, uint32_t b) { return values[a] < values[b]; });
+    bool order_preserving = true;
+    for (size_t i = 0; i < count && order_preserving; i++) {
+        order_preserving = order[i] == i;
+    }
+    
+    DictionarySectionHeader section{};
+    section.num_entries = count;
+    section.block_entries = DICTIONARY_BLOCK_ENTRIES;
+    section.restart_interval = DICTIONARY_RESTART_INTERVAL;
+    section.num_blocks = blockCount(count, DICTIONARY_BLOCK_ENTRIES);
+    size_t threads = resolveThreads(num_threads, section.num_blocks);
+    
+    std::vector<std::vector<uint8_t>> raw(section.num_blocks);
+    forEachBlockParallel(raw.size(), threads, [&](size_t block) {
+        size_t first = block * DICTIONARY_BLOCK_ENTRIES;
+        frontCodeBlock(values, order, first, std::min<size_t>(DICTIONARY_BLOCK_ENTRIES, count - first), raw[block]);
+    });
+    
+    // Blocks share most of their vocabulary, so a trained dictionary usually pays for itself
+    std::vector<std::vector<uint8_t>> frames;
+    size_t plain_bytes = compressDictionaryBlocks(raw, {}, level, threads, frames);
+    std::vector<uint8_t> trained;
+    if (raw.size() >= MIN_TRAINING_BLOCKS) {
+        std::vector<uint8_t> samples;
+        std::vector<size_t> sample_sizes;
+        for (const auto& block : raw) {
+            samples.insert(samples.end(), block.begin(), block.end());
+            sample_sizes.push_back(block.size());
+        }
+        trained.resize(std::min(MAX_ZDICT_BYTES, samples.size() / 8));
+        size_t trained_size = ZDICT_trainFromBuffer(trained.data(), trained.size(), samples.data(),
+                                                    sample_sizes.data(), static_cast<unsigned>(sample_sizes.size()));
+        trained.resize(ZDICT_isError(trained_size) ? 0 : trained_size);
+    }
+    if (!trained.empty()) {
+        std::vector<std::vector<uint8_t>> trained_frames;
+        size_t trained_bytes = compressDictionaryBlocks(raw, trained, level, threads, trained_frames);
+        if (trained_bytes + trained.size() < plain_bytes) {
+            frames.swap(trained_frames);
+        } else {
+            trained.clear();
+        }
+    }
+    section.zdict_length = trained.size();
+    
+    // IDs are assigned in first-seen order, so the position -> ID map is usually needed;
+    // byte planes leave its high bytes as zero runs for zstd
+    std::vector<uint8_t> permutation;
+    if (!order_preserving) {
+        std::vector<uint8_t> planes(count * sizeof(uint32_t));
+        shufflePlanes(order.data(), count, planes.data());
+        permutation.resize(ZSTD_compressBound(planes.size()));
+        size_t compressed = ZSTD_compress(permutation.data(), permutation.size(), planes.data(), planes.size(), level);
+        if (ZSTD_isError(compressed)) {
+            throw std::runtime_error("Dictionary compression failed");
+        }
+        permutation.resize(compressed);
+    }
+    section.permutation_length = permutation.size();
+    
+    std::vector<BlockRef> blocks(frames.size());
+    uint64_t offset = 0;
+    for (size_t i = 0; i < frames.size(); i++) {
+        blocks[i] = BlockRef{offset, frames[i].size()};
+        offset += frames[i].size();
+    }
+    
+    std::vector<uint8_t> out(sizeof(section));
+    std::memcpy(out.data(), &section, sizeof(section));
+    out.insert(out.end(), trained.begin(), trained.end());
+    out.insert(out.end(), permutation.begin(), permutation.end());
+    const uint8_t* index = reinterpret_cast<const uint8_t*>(blocks.data());
+    out.insert(out.end(), index, index + blocks.size() * sizeof(BlockRef));
+    for (const auto& frame : frames) {
+        out.insert(out.end(), frame.begin(), frame.end());
+    }
+    return out;
+}
+
+void decodeDictionary(const uint8_t* section_data, size_t length, int num_threads, std::vector<std::string>& values) {
+    DictionarySectionHeader section;
+    if (length < sizeof(section)) {
+        throw std::runtime_error("Truncated dictionary section");
+    }
+    std::memcpy(&section, section_data, sizeof(section));
+    if (section.block_entries == 0 || section.restart_interval == 0 || section.num_entries > UINT32_MAX
+        || section.num_blocks != blockCount(section.num_entries, section.block_entries)) {
+        throw std::runtime_error("Corrupt dictionary section header");
+    }
+    size_t index_offset = sizeof(section) + section.zdict_length + section.permutation_length;
+    size_t blocks_offset = index_offset + section.num_blocks * sizeof(BlockRef);
+    if (section.zdict_length > length || section.permutation_length > length || blocks_offset > length) {
+        throw std::runtime_error("Truncated dictionary section");
+    }
+    
+    size_t count = section.num_entries;
+    const uint8_t* zdict = section_data + sizeof(section);
+    const uint8_t* permutation = zdict + section.zdict_length;
+    std::vector<BlockRef> blocks(section.num_blocks);
+    std::memcpy(blocks.data(), section_data + index_offset, blocks.size() * sizeof(BlockRef));
+    for (const auto& block : blocks) {
+        if (block.offset > length - blocks_offset || block.length > length - blocks_offset - block.offset) {
+            throw std::runtime_error("Truncated dictionary section");
+        }
+    }
+    
+    std::vector<uint32_t> order(count);
+    if (section.permutation_length > 0) {
+        std::vector<uint8_t> planes(count * sizeof(uint32_t));
+        size_t decompressed = ZSTD_decompress(planes.data(), planes.size(), permutation, section.permutation_length);
+        if (ZSTD_isError(decompressed) || decompressed != planes.size()) {
+            throw std::runtime_error("Corrupt dictionary permutation");
+        }
+        unshufflePlanes(planes.data(), count, 0, order.data());
+        for (uint32_t id : order) {
+            if (id >= count) {
+                throw std::runtime_error("Corrupt dictionary permutation");
+            }
+        }
+    } else {
+        std::iota(order.begin(), order.end(), 0);
+    }
+    
+    DDictPtr ddict(section.zdict_length > 0 ? ZSTD_createDDict(zdict, section.zdict_length) : nullptr,
+                   ZSTD_freeDDict);
+    values.assign(count, std::string());
+    
+    // Blocks cover disjoint positions, hence disjoint IDs, so they decode independently
+    const uint8_t* payload = section_data + blocks_offset;
+    forEachBlockParallel(blocks.size(), resolveThreads(num_threads, blocks.size()), [&](size_t block) {
+        const uint8_t* frame = payload + blocks[block].offset;
+        unsigned long long raw_size = ZSTD_getFrameContentSize(frame, blocks[block].length);
+        if (raw_size == ZSTD_CONTENTSIZE_ERROR || raw_size == ZSTD_CONTENTSIZE_UNKNOWN) {
+            throw std::runtime_error("Corrupt dictionary block");
+        }
+        std::vector<uint8_t> raw(raw_size);
+        DCtxPtr ctx(ZSTD_createDCtx(), ZSTD_freeDCtx);
+        size_t decompressed = ddict
+            ? ZSTD_decompress_usingDDict(ctx.get(), raw.data(), raw.size(), frame, blocks[block].length, ddict.get())
+            : ZSTD_decompressDCtx(ctx.get(), raw.data(), raw.size(), frame, blocks[block].length);
+        if (ZSTD_isError(decompressed) || decompressed != raw.size()) {
+            throw std::runtime_error("Corrupt dictionary block");
+        }
+        
+        size_t first = block * section.block_entries;
+        size_t entries = std::min<size_t>(section.block_entries, count - first);
+        size_t restarts = (entries + section.restart_interval - 1) / section.restart_interval;
+        if (restarts * sizeof(uint32_t) > raw.size()) {
+            throw std::runtime_error("Corrupt dictionary block");
+        }
+        const uint8_t* in = raw.data() + restarts * sizeof(uint32_t);
+        const uint8_t* end = raw.data() + raw.size();
+        std::string current;
+        for (size_t i = 0; i < entries; i++) {
+            uint32_t shared = getVarint(in, end);
+            uint32_t suffix = getVarint(in, end);
+            if (shared > current.length() || suffix > static_cast<size_t>(end - in)) {
+                throw std::runtime_error("Corrupt dictionary block");
+            }
+            current.resize(shared);
+            current.append(reinterpret_cast<const char*>(in), suffix);
+            in += suffix;
+            values[order[first + i]] = current;
+        }
+    });
+}
+
+bool readHeader(std::istream& in, ColumnFileHeader& header) {
+    std::streampos start = in.tellg();
+    in.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!in || std::memcmp(header.magic, FILE_MAGIC, sizeof(header.magic)) != 0) {
+        in.clear();
+        in.seekg(start);
+        return false;
+    }
+    if (header.version != FILE_VERSION) {
+        throw std::runtime_error("Unsupported column file version " + std::to_string(header.version));
+    }
+    if (header.block_rows == 0 || header.num_blocks != blockCount(header.num_rows, header.block_rows)) {
+        throw std::runtime_error("Corrupt column file header");
+    }
+    return true;
+}
+
+std::vector<BlockRef> readBlockIndex(std::istream& in, const ColumnFileHeader& header) {
+    // Readers follow the refs straight into the payload, so each must lie inside it
+    in.seekg(0, std::ios::end);
+    uint64_t file_size = static_cast<uint64_t>(in.tellg());
+    if (header.num_blocks != blockCount(header.num_rows, header.block_rows) || header.index_offset > file_size
+        || header.data_offset > file_size || header.num_blocks > (file_size - header.index_offset) / sizeof(BlockRef)) {
+        throw std::runtime_error("Corrupt column file block index");
+    }
+    std::vector<BlockRef> blocks(header.num_blocks);
+    in.seekg(header.index_offset);
+    in.read(reinterpret_cast<char*>(blocks.data()), blocks.size() * sizeof(BlockRef));
+    if (!in) {
+        throw std::runtime_error("Truncated column file block index");
+    }
+    uint64_t payload_length = file_size - header.data_offset;
+    for (const auto& block : blocks) {
+        if (block.offset > payload_length || block.length > payload_length - block.offset) {
+            throw std::runtime_error("Column file block lies outside the payload");
+        }
+    }
+    return blocks;
+}
+
+size_t payloadLength(const std::vector<BlockRef>& blocks) {
+    size_t length = 0;
+    for (const auto& block : blocks) {
+        length = std::max<size_t>(length, block.offset + block.length);
+    }
+    return length;
+}
+
+std::vector<BlockZone> readZoneMap(std::istream& in, const ColumnFileHeader& header) {
+    std::vector<BlockZone> zones(header.num_blocks);
+    in.seekg(header.index_offset + header.num_blocks * sizeof(BlockRef));
+    in.read(reinterpret_cast<char*>(zones.data()), zones.size() * sizeof(BlockZone));
+    if (!in) {
+        throw std::runtime_error("Truncated column file zone map");
+    }
+    return zones;
+}
+
+void readDictionary(std::istream& in, const ColumnFileHeader& header, std::vector<std::string>& values) {
+    in.seekg(header.dictionary_offset);
+    if (header.index_offset < header.dictionary_offset) {
+        throw std::runtime_error("Corrupt dictionary section");
+    }
+    std::vector<uint8_t> section(header.index_offset - header.dictionary_offset);
+    in.read(reinterpret_cast<char*>(section.data()), section.size());
+    if (!in) {
+        throw std::runtime_error("Truncated dictionary section");
+    }
+    decodeDictionary(section.data(), section.size(), 0, values);
+    if (values.size() != header.dict_size) {
+        throw std::runtime_error("Dictionary size mismatch");
+    }
+}
+
+void readDictionaryEntries(std::istream& in, size_t dict_size, std::vector<std::string>& values) {
+    values.assign(dict_size, std::string());
+    for (size_t i = 0; i < dict_size; i++) {
+        size_t length;
+        in.read(reinterpret_cast<char*>(&length), sizeof(length));
+        std::string value(length, '\0');
+        in.read(&value[0], length);
+        uint32_t id;
+        in.read(reinterpret_cast<char*>(&id), sizeof(id));
+        if (!in || id >= dict_size) {
+            throw std::runtime_error("Corrupt dictionary entry");
+        }
+        // Entries were stored in hash-map order, so place each one at its ID
+        values[id] = std::move(value);
+    }
+}
+
+size_t readBlock(std::istream& in, const ColumnFileHeader& header, const std::vector<BlockRef>& blocks,
+                 size_t block, std::vector<uint32_t>& ids) {
+    if (block >= blocks.size()) {
+        throw std::out_of_range("Column block out of range");
+    }
+    std::vector<uint8_t> frame(blocks[block].length);
+    in.seekg(header.data_offset + blocks[block].offset);
+    in.read(reinterpret_cast<char*>(frame.data()), frame.size());
+    if (!in) {
+        throw std::runtime_error("Truncated column file block");
+    }
+    
+    size_t first = block * header.block_rows;
+    size_t rows = std::min<size_t>(header.block_rows, header.num_rows - first);
+    ids.resize(rows);
+    decompressBlock(frame.data(), frame.size(), ids.data(), rows);
+    if (rows > 0 && ScanKernels::maxId(ids.data(), 0, rows) >= header.dict_size) {
+        throw std::runtime_error("Value ID out of range in column file block");
+    }
+    return rows;
+}
+
+}  // namespace BlockCompression
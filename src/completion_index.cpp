@@ -0,0 +1,99 @@
+#include "completion_index.h"
+#include <algorithm>
+
+CompletionIndex::CompletionIndex(StringArenaView values, size_t count,
+                                 const std::vector<size_t>& frequencies, size_t version)
+    : frequencies(frequencies), num_leaves(1), version(version) {
+    // The dictionary can briefly run ahead of the frequency table during encoding
+    count = std::min(count, frequencies.size());
+    sorted_ids.reserve(count);
+    for (uint32_t id = 0; id < count; id++) {
+        if (frequencies[id] > 0) {
+            sorted_ids.push_back(id);
+        }
+    }
+    std::sort(sorted_ids.begin(), sorted_ids.end(), [values](uint32_t a, uint32_t b) {
+        return values[a] < values[b];
+    });
+
+    size_t num_blocks = (sorted_ids.size() + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    while (num_leaves < num_blocks) {
+        num_leaves <<= 1;
+    }
+    node_top.resize(2 * num_leaves);
+
+    auto by_rank = [this](uint32_t a, uint32_t b) { return ranksBefore(a, b); };
+    for (size_t block = 0; block < num_blocks; block++) {
+        auto first = sorted_ids.begin() + block * BLOCK_SIZE;
+        auto last = sorted_ids.begin() + std::min(sorted_ids.size(), (block + 1) * BLOCK_SIZE);
+        std::vector<uint32_t>& top = node_top[num_leaves + block];
+        top.assign(first, last);
+        size_t keep = std::min(top.size(), NODE_TOP_K);
+        std::partial_sort(top.begin(), top.begin() + keep, top.end(), by_rank);
+        top.resize(keep);
+    }
+    for (size_t node = num_leaves - 1; node > 0; node--) {
+        mergeTop(node_top[2 * node], node_top[2 * node + 1], node_top[node]);
+    }
+}
+
+void CompletionIndex::mergeTop(const std::vector<uint32_t>& left, const std::vector<uint32_t>& right,
+                               std::vector<uint32_t>& out) const {
+    out.clear();
+    out.reserve(NODE_TOP_K);
+    size_t i = 0, j = 0;
+    while (out.size() < NODE_TOP_K && (i < left.size() || j < right.size())) {
+        if (j == right.size() || (i < left.size() && ranksBefore(left[i], right[j]))) {
+            out.push_back(left[i++]);
+        } else {
+            out.push_back(right[j++]);
+        }
+    }
+}
+
+std::vector<uint32_t> CompletionIndex::complete(StringArenaView values, const std::string& prefix,
+                                                size_t k) const {
+    std::vector<uint32_t> result;
+    k = std::min(k, NODE_TOP_K);
+    if (k == 0) {
+        return result;
+    }
+
+    // Values starting with the prefix form one run of the sorted order
+    size_t len = prefix.length();
+    auto lo_it = std::partition_point(sorted_ids.begin(), sorted_ids.end(), [&](uint32_t id) {
+        return values[id].compare(0, len, prefix) < 0;
+    });
+    auto hi_it = std::partition_point(lo_it, sorted_ids.end(), [&](uint32_t id) {
+        return values[id].compare(0, len, prefix) == 0;
+    });
+    size_t lo = lo_it - sorted_ids.begin();
+    size_t hi = hi_it - sorted_ids.begin();
+
+    std::vector<uint32_t> candidates;
+    size_t first_block = (lo + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    size_t last_block = hi / BLOCK_SIZE;
+    if (first_block >= last_block) {
+        // The run fits in two blocks: rank it directly
+        candidates.assign(lo_it, hi_it);
+    } else {
+        candidates.insert(candidates.end(), lo_it, sorted_ids.begin() + first_block * BLOCK_SIZE);
+        candidates.insert(candidates.end(), sorted_ids.begin() + last_block * BLOCK_SIZE, hi_it);
+        for (size_t l = first_block + num_leaves, r = last_block + num_leaves; l < r; l >>= 1, r >>= 1) {
+            if (l & 1) {
+                const auto& top = node_top[l++];
+                candidates.insert(candidates.end(), top.begin(), top.end());
+            }
+            if (r & 1) {
+                const auto& top = node_top[--r];
+                candidates.insert(candidates.end(), top.begin(), top.end());
+            }
+        }
+    }
+
+    k = std::min(k, candidates.size());
+    std::partial_sort(candidates.begin(), candidates.begin() + k, candidates.end(),
+                      [this](uint32_t a, uint32_t b) { return ranksBefore(a, b); });
+    candidates.resize(k);
+    return candidates;
+}
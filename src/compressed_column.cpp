@@ -0,0 +1,316 @@
+#include "compressed_column.h"
+#include "scan_kernels.h"
+#include <fstream>
+#include <algorithm>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+
+CompressedColumnReader::CompressedColumnReader(const std::string& filename, size_t max_cache_bytes,
+                                               size_t prefetch_depth)
+    : fd(-1), cache_bytes(0), max_cache_bytes(max_cache_bytes), prefetch_depth(prefetch_depth), stopping(false),
+      hits(0), misses(0), prefetched(0), blocks_skipped(0) {
+    std::ifstream in(filename, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("Failed to open file: " + filename);
+    }
+    if (!BlockCompression::readHeader(in, header)) {
+        throw std::runtime_error(filename + " is not block-compressed; re-save it with saveToFile");
+    }
+    BlockCompression::readDictionary(in, header, values);
+    blocks = BlockCompression::readBlockIndex(in, header);
+    zones = BlockCompression::readZoneMap(in, header);
+
+    value_ids.reserve(values.size());
+    for (uint32_t id = 0; id < values.size(); id++) {
+        value_ids.emplace(values[id], id);
+    }
+
+    // pread keeps no shared file position, so scans and the prefetcher read concurrently
+    fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open file: " + filename);
+    }
+    if (prefetch_depth > 0) {
+        prefetcher = std::thread(&CompressedColumnReader::prefetchLoop, this);
+    }
+}
+
+CompressedColumnReader::~CompressedColumnReader() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    prefetch_cv.notify_all();
+    if (prefetcher.joinable()) {
+        prefetcher.join();
+    }
+    if (fd >= 0) {
+        ::close(fd);
+    }
+}
+
+CompressedColumnReader::Block CompressedColumnReader::getBlock(size_t block) {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        auto it = cache.find(block);
+        if (it != cache.end()) {
+            lru.splice(lru.begin(), lru, it->second.lru);
+            hits++;
+            return it->second.ids;
+        }
+        if (!loading.count(block)) {
+            break;
+        }
+        // Someone (usually the prefetcher) is already decompressing it
+        loaded_cv.wait(lock);
+    }
+    misses++;
+    return loadBlock(block, lock);
+}
+
+CompressedColumnReader::Block CompressedColumnReader::loadBlock(size_t block, std::unique_lock<std::mutex>& lock) {
+    loading.insert(block);
+    lock.unlock();
+
+    Block ids;
+    try {
+        std::vector<uint8_t> frame(blocks[block].length);
+        ssize_t read = ::pread(fd, frame.data(), frame.size(), header.data_offset + blocks[block].offset);
+        if (read != static_cast<ssize_t>(frame.size())) {
+            throw std::runtime_error("Truncated column file block");
+        }
+        size_t first = block * header.block_rows;
+        auto decoded = std::make_shared<std::vector<uint32_t>>(
+            std::min<size_t>(header.block_rows, header.num_rows - first));
+        BlockCompression::decompressBlock(frame.data(), frame.size(), decoded->data(), decoded->size());
+        // getValue and the bitmap kernels index the dictionary with these IDs unchecked
+        if (!decoded->empty() && ScanKernels::maxId(decoded->data(), 0, decoded->size()) >= values.size()) {
+            throw std::runtime_error("Value ID out of range in column file block");
+        }
+        ids = std::move(decoded);
+    } catch (...) {
+        lock.lock();
+        loading.erase(block);
+        loaded_cv.notify_all();
+        throw;
+    }
+
+    lock.lock();
+    loading.erase(block);
+    size_t bytes = ids->size() * sizeof(uint32_t);
+    lru.push_front(block);
+    cache.emplace(block, CachedBlock{ids, lru.begin()});
+    cache_bytes += bytes;
+
+    // Evict least recently used blocks; scans still holding one keep it alive
+    while (cache_bytes > max_cache_bytes && lru.size() > 1) {
+        auto victim = cache.find(lru.back());
+        cache_bytes -= victim->second.ids->size() * sizeof(uint32_t);
+        cache.erase(victim);
+        lru.pop_back();
+    }
+    loaded_cv.notify_all();
+    return ids;
+}
+
+void CompressedColumnReader::prefetchLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        prefetch_cv.wait(lock, [this] { return stopping || !prefetch_queue.empty(); });
+        if (stopping) {
+            return;
+        }
+        size_t block = prefetch_queue.front();
+        prefetch_queue.pop_front();
+        if (cache.count(block) || loading.count(block)) {
+            continue;
+        }
+        try {
+            loadBlock(block, lock);
+            prefetched++;
+        } catch (const std::exception&) {
+            // Left to the scan, which reports the error when it reaches the block
+        }
+    }
+}
+
+template <typename Visit>
+void CompressedColumnReader::scanBlocks(const std::vector<uint32_t>& ids, size_t begin_row, size_t end_row,
+                                        Visit&& visit) {
+    end_row = std::min<size_t>(end_row, header.num_rows);
+    begin_row = std::min(begin_row, end_row);
+    if (ids.empty() || begin_row == end_row) {
+        return;
+    }
+
+    size_t first_block = begin_row / header.block_rows;
+    size_t last_block = (end_row - 1) / header.block_rows + 1;
+    std::vector<size_t> candidates;
+    size_t skipped = 0;
+    for (size_t block = first_block; block < last_block; block++) {
+        auto it = std::lower_bound(ids.begin(), ids.end(), zones[block].min_id);
+        if (it == ids.end() || *it > zones[block].max_id) {
+            skipped++;
+            continue;
+        }
+        candidates.push_back(block);
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        blocks_skipped += skipped;
+    }
+
+    for (size_t i = 0; i < candidates.size(); i++) {
+        if (prefetch_depth > 0) {
+            // Keep the next candidates in flight; stale requests from finished scans age out
+            std::lock_guard<std::mutex> lock(mutex);
+            for (size_t j = i + 1; j < std::min(candidates.size(), i + 1 + prefetch_depth); j++) {
+                size_t next = candidates[j];
+                if (!cache.count(next) && !loading.count(next) &&
+                    std::find(prefetch_queue.begin(), prefetch_queue.end(), next) == prefetch_queue.end()) {
+                    prefetch_queue.push_back(next);
+                }
+            }
+            while (prefetch_queue.size() > 4 * prefetch_depth) {
+                prefetch_queue.pop_front();
+            }
+            prefetch_cv.notify_one();
+        }
+
+        size_t block = candidates[i];
+        Block data = getBlock(block);
+        size_t block_first = block * header.block_rows;
+        size_t begin = std::max(begin_row, block_first) - block_first;
+        size_t end = std::min(end_row, block_first + data->size()) - block_first;
+        visit(data->data(), begin, end, block_first);
+    }
+}
+
+void CompressedColumnReader::collectPrefixIds(const std::string& prefix, std::vector<uint32_t>& ids) const {
+    ids.clear();
+    for (uint32_t id = 0; id < values.size(); id++) {
+        if (values[id].compare(0, prefix.length(), prefix) == 0) {
+            ids.push_back(id);
+        }
+    }
+}
+
+size_t CompressedColumnReader::countIds(const std::vector<uint32_t>& ids, size_t begin_row, size_t end_row) {
+    size_t count = 0;
+    if (ids.size() == 1) {
+        uint32_t id = ids[0];
+        scanBlocks(ids, begin_row, end_row, [&](const uint32_t* data, size_t begin, size_t end, size_t) {
+            count += ScanKernels::countEqual(data, begin, end, id);
+        });
+        return count;
+    }
+
+    std::vector<uint32_t> bitmap((values.size() + 31) / 32, 0);
+    for (uint32_t id : ids) {
+        bitmap[id >> 5] |= 1u << (id & 31);
+    }
+    scanBlocks(ids, begin_row, end_row, [&](const uint32_t* data, size_t begin, size_t end, size_t) {
+        count += ScanKernels::countInBitmap(data, begin, end, bitmap.data());
+    });
+    return count;
+}
+
+std::vector<size_t> CompressedColumnReader::findIds(const std::vector<uint32_t>& ids, size_t begin_row,
+                                                    size_t end_row) {
+    std::vector<size_t> results;
+    auto emitter = [&results](size_t first_row) {
+        return [&results, first_row](size_t row) {
+            results.push_back(first_row + row);
+            return true;
+        };
+    };
+    if (ids.size() == 1) {
+        uint32_t id = ids[0];
+        scanBlocks(ids, begin_row, end_row, [&](const uint32_t* data, size_t begin, size_t end, size_t first_row) {
+            ScanKernels::forEachEqual(data, begin, end, id, emitter(first_row));
+        });
+        return results;
+    }
+
+    std::vector<uint32_t> bitmap((values.size() + 31) / 32, 0);
+    for (uint32_t id : ids) {
+        bitmap[id >> 5] |= 1u << (id & 31);
+    }
+    scanBlocks(ids, begin_row, end_row, [&](const uint32_t* data, size_t begin, size_t end, size_t first_row) {
+        ScanKernels::forEachInBitmap(data, begin, end, bitmap.data(), emitter(first_row));
+    });
+    return results;
+}
+
+std::vector<size_t> CompressedColumnReader::findMatches(const std::string& target, size_t begin_row,
+                                                        size_t end_row) {
+    auto it = value_ids.find(target);
+    if (it == value_ids.end()) {
+        return {};
+    }
+    return findIds({it->second}, begin_row, end_row);
+}
+
+size_t CompressedColumnReader::countMatches(const std::string& target, size_t begin_row, size_t end_row) {
+    auto it = value_ids.find(target);
+    if (it == value_ids.end()) {
+        return 0;
+    }
+    return countIds({it->second}, begin_row, end_row);
+}
+
+std::vector<size_t> CompressedColumnReader::prefixMatches(const std::string& prefix, size_t begin_row,
+                                                          size_t end_row) {
+    // An empty prefix matches nothing, as in DictionaryCodec
+    if (prefix.empty()) {
+        return {};
+    }
+
+    std::vector<uint32_t> ids;
+    collectPrefixIds(prefix, ids);
+    return findIds(ids, begin_row, end_row);
+}
+
+size_t CompressedColumnReader::countPrefix(const std::string& prefix, size_t begin_row, size_t end_row) {
+    if (prefix.empty()) {
+        return 0;
+    }
+
+    std::vector<uint32_t> ids;
+    collectPrefixIds(prefix, ids);
+    return countIds(ids, begin_row, end_row);
+}
+
+const std::string& CompressedColumnReader::getValue(size_t row) {
+    if (row >= header.num_rows) {
+        throw std::out_of_range("Row out of range");
+    }
+    Block data = getBlock(row / header.block_rows);
+    return values[(*data)[row % header.block_rows]];
+}
+
+size_t CompressedColumnReader::getCachedBytes() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return cache_bytes;
+}
+
+size_t CompressedColumnReader::getCacheHits() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return hits;
+}
+
+size_t CompressedColumnReader::getCacheMisses() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return misses;
+}
+
+size_t CompressedColumnReader::getBlocksPrefetched() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return prefetched;
+}
+
+size_t CompressedColumnReader::getBlocksSkipped() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return blocks_skipped;
+}
@@ -1,4 +1,8 @@
 #include "dictionary_codec.h"
+#include "scan_kernels.h"
+#include "block_compression.h"
+#include "write_ahead_log.h"
+#include "arrow_ipc.h"
 #include <fstream>
 #include <algorithm>
 #include <numeric>
@@ -8,75 +12,440 @@
 #include <cstring>
 #include <zstd.h>
 #include <mutex>
+#include <condition_variable>
 #include <iostream>  
 #include <iomanip>   
+#include <limits>
 
-DictionaryCodec::DictionaryCodec() : mmap_fd(-1), mmap_data(nullptr), mmap_size(0) {}
+namespace {
 
-DictionaryCodec::~DictionaryCodec() {
-    if (mmap_data) {
-        unmapFile();
+// Snapshot file layout (host byte order). Every section starts on a 64-byte
+// boundary so the mapped arrays can be read in place by the SIMD kernels.
+constexpr char SNAPSHOT_MAGIC[8] = {'D', 'C', 'S', 'N', 'A', 'P', '\0', '\0'};
+constexpr uint32_t SNAPSHOT_VERSION = 1;
+constexpr size_t SNAPSHOT_ALIGNMENT = 64;
+
+struct SnapshotSection {
+    uint64_t offset;  // Bytes from the start of the file
+    uint64_t length;  // Bytes
+};
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint64_t num_rows;
+    uint64_t dict_size;
+    uint64_t original_bytes;
+    uint64_t hash_slots;            // Power of two, at least twice dict_size
+    SnapshotSection value_offsets;  // uint32_t[dict_size + 1]
+    SnapshotSection value_bytes;    // char[value_offsets[dict_size]]
+    SnapshotSection hash_index;     // uint32_t[hash_slots]: ID + 1, or 0 for an empty slot
+    SnapshotSection frequencies;    // uint64_t[dict_size]
+    SnapshotSection ids;            // uint32_t[num_rows], raw so scans need no decoding
+};
+
+// FNV-1a; stable across builds, unlike std::hash
+uint64_t snapshotHash(const char* data, size_t length) {
+    uint64_t hash = 1469598103934665603ull;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= static_cast<uint8_t>(data[i]);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+size_t alignSnapshotOffset(size_t offset) {
+    return (offset + SNAPSHOT_ALIGNMENT - 1) & ~(SNAPSHOT_ALIGNMENT - 1);
+}
+
+// Header for the given contents, with every section laid out back to back on aligned offsets
+SnapshotHeader planSnapshot(size_t num_rows, size_t dict_size, size_t value_bytes, size_t original_bytes) {
+    SnapshotHeader header{};
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.header_size = sizeof(SnapshotHeader);
+    header.num_rows = num_rows;
+    header.dict_size = dict_size;
+    header.original_bytes = original_bytes;
+    
+    // Prebuilt hash index: at most half full so lookups probe only a few slots
+    header.hash_slots = 16;
+    while (header.hash_slots < 2 * header.dict_size) {
+        header.hash_slots <<= 1;
+    }
+    
+    std::pair<SnapshotSection*, size_t> sections[] = {
+        {&header.value_offsets, (dict_size + 1) * sizeof(uint32_t)},
+        {&header.value_bytes, value_bytes},
+        {&header.hash_index, header.hash_slots * sizeof(uint32_t)},
+        {&header.frequencies, dict_size * sizeof(uint64_t)},
+        {&header.ids, num_rows * sizeof(uint32_t)},
+    };
+    size_t offset = alignSnapshotOffset(sizeof(SnapshotHeader));
+    for (auto& [section, length] : sections) {
+        *section = SnapshotSection{offset, length};
+        offset = alignSnapshotOffset(offset + length);
+    }
+    return header;
+}
+
+void insertSnapshotHash(std::vector<uint32_t>& slots, std::string_view value, uint32_t id) {
+    size_t mask = slots.size() - 1;
+    size_t slot = snapshotHash(value.data(), value.length()) & mask;
+    while (slots[slot] != 0) {
+        slot = (slot + 1) & mask;
+    }
+    slots[slot] = id + 1;
+}
+
+// Value IDs read from a file go on to index the frequency table and arena unchecked,
+// so every load validates them once
+bool idsInRange(const uint32_t* ids, size_t count, size_t dict_size) {
+    return count == 0 || ScanKernels::maxId(ids, 0, count) < dict_size;
+}
+
+// Zero-fills from written up to the start of section
+void padSnapshot(std::ofstream& file, size_t& written, const SnapshotSection& section) {
+    static const char padding[SNAPSHOT_ALIGNMENT] = {};
+    file.write(padding, section.offset - written);
+    written = section.offset;
+}
+
+// A temp name of its own for every writer, so concurrent saves to one directory never share a file
+std::string uniqueTempFile(const std::string& filename) {
+    static std::atomic<uint64_t> next_temp{0};
+    return filename + ".tmp." + std::to_string(getpid()) + "." + std::to_string(next_temp++);
+}
+
+// Snapshots are written beside the target and renamed, so a reader never maps a
+// half-written file. The data is on disk before the rename and the rename is on disk
+// before this returns, so a checkpoint never replaces a snapshot with a torn one, nor
+// truncates the log behind a rename a crash could still undo
+void commitSnapshot(const std::string& temp_file, const std::string& filename) {
+    int fd = open(temp_file.c_str(), O_RDONLY);
+    if (fd < 0 || fdatasync(fd) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        throw std::runtime_error("Failed to sync snapshot file: " + temp_file);
     }
+    close(fd);
+    std::filesystem::rename(temp_file, filename);
+    syncDirectory(filename);
 }
-void DictionaryCodec::memoryMapFile(const std::string& filename) {
+
+void writeStateMetadata(const std::string& filename, size_t dict_size, size_t num_rows,
+                        double compression_ratio, size_t memory_usage) {
+    std::string temp_file = uniqueTempFile(filename);
+    {
+        std::ofstream meta(temp_file);
+        meta << "Dictionary size: " << dict_size << "\n";
+        meta << "Encoded data size: " << num_rows << "\n";
+        meta << "Compression ratio: " << compression_ratio << "\n";
+        meta << "Memory usage (MB): " << memory_usage / (1024.0 * 1024.0) << "\n";
+    }
+    commitSnapshot(temp_file, filename);
+}
+
+// Writes value in decimal at out, two digits per step; returns the end. out needs 20 bytes
+char* writeDecimal(char* out, uint64_t value) {
+    static const char pairs[] =
+        "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+        "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+    char digits[20];
+    char* p = digits + sizeof(digits);
+    while (value >= 100) {
+        p -= 2;
+        std::memcpy(p, pairs + (value % 100) * 2, 2);
+        value /= 100;
+    }
+    if (value >= 10) {
+        p -= 2;
+        std::memcpy(p, pairs + value * 2, 2);
+    } else {
+        *--p = static_cast<char>('0' + value);
+    }
+    size_t length = digits + sizeof(digits) - p;
+    std::memcpy(out, p, length);
+    return out + length;
+}
+
+// Appends value as a CSV field, quoted when it holds a separator, quote or line break
+void appendCsvField(std::string& out, std::string_view value) {
+    if (value.find_first_of(",\"\r\n") == std::string_view::npos) {
+        out.append(value);
+        return;
+    }
+    out.push_back('"');
+    for (char c : value) {
+        if (c == '"') {
+            out.push_back('"');
+        }
+        out.push_back(c);
+    }
+    out.push_back('"');
+}
+
+}  // namespace
+
+DictionaryCodec::DictionaryCodec()
+    : original_bytes(0), dictionary_bytes(0), stats_version(0), column_epoch(0),
+      completion_epoch(0), completion_rebuilding(false), mmap_fd(-1), mmap_data(nullptr), mmap_size(0),
+      hash_index(nullptr), hash_mask(0) {}
+
+DictionaryCodec::~DictionaryCodec() {
+    if (completion_build.valid()) {
+        completion_build.wait();
+    }
+    disableWriteAheadLog();
+    waitForHashIndex();
     if (mmap_data) {
         unmapFile();
     }
-    
-    mmap_fd = open(filename.c_str(), O_RDONLY);
-    if (mmap_fd == -1) {
+}
+DictionaryCodec::FileMapping DictionaryCodec::mapFile(const std::string& filename) {
+    FileMapping mapping;
+    mapping.fd = open(filename.c_str(), O_RDONLY);
+    if (mapping.fd == -1) {
         throw std::runtime_error("Failed to open file for memory mapping");
     }
     
-    mmap_size = lseek(mmap_fd, 0, SEEK_END);
-    mmap_data = mmap(nullptr, mmap_size, PROT_READ, MAP_PRIVATE, mmap_fd, 0);
+    mapping.size = lseek(mapping.fd, 0, SEEK_END);
+    mapping.data = mmap(nullptr, mapping.size, PROT_READ, MAP_PRIVATE, mapping.fd, 0);
     
-    if (mmap_data == MAP_FAILED) {
-        close(mmap_fd);
+    if (mapping.data == MAP_FAILED) {
+        close(mapping.fd);
         throw std::runtime_error("Failed to memory map file");
     }
+    return mapping;
+}
+
+void DictionaryCodec::unmapFile(FileMapping& mapping) {
+    if (mapping.data) {
+        munmap(mapping.data, mapping.size);
+        close(mapping.fd);
+        mapping = FileMapping();
+    }
 }
 
 void DictionaryCodec::unmapFile() {
-    if (mmap_data) {
-        munmap(mmap_data, mmap_size);
-        close(mmap_fd);
-        mmap_data = nullptr;
-        mmap_fd = -1;
-        mmap_size = 0;
+    FileMapping mapping{mmap_fd, mmap_data, mmap_size};
+    unmapFile(mapping);
+    mmap_data = nullptr;
+    mmap_fd = -1;
+    mmap_size = 0;
+}
+bool DictionaryCodec::lookupId(const std::string& value, uint32_t& id) const {
+    waitForHashIndex();
+    if (!hash_index) {
+        auto it = dictionary.find(value);
+        if (it == dictionary.end()) {
+            return false;
+        }
+        id = it->second;
+        return true;
+    }
+    
+    // Linear probing; the table is at most half full, so probes are short
+    for (size_t slot = snapshotHash(value.data(), value.length()) & hash_mask;; slot = (slot + 1) & hash_mask) {
+        uint32_t entry = hash_index[slot];
+        if (entry == 0) {
+            return false;
+        }
+        if (valueAt(entry - 1) == value) {
+            id = entry - 1;
+            return true;
+        }
     }
 }
+
 double DictionaryCodec::getCompressionRatio() const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    return compressionRatio();
+}
+
+double DictionaryCodec::compressionRatio() const {
     if (encoded_data.empty()) {
         return 0.0;
     }
     
-    // Calculate original size (sum of all string lengths)
-    size_t original_size = 0;
-    for (const auto& entry : dictionary) {
-        const std::string& str = entry.first;
-        const uint32_t id = entry.second;
-        original_size += str.length() * std::count(encoded_data.begin(), encoded_data.end(), id);
+    // Original size comes from the running byte total kept alongside the frequency table
+    // Encoded size: dictionary strings + one ID each, plus the encoded data array
+    size_t encoded_size = dictionary_bytes + valueCount() * sizeof(uint32_t)
+                        + encoded_data.size() * sizeof(uint32_t);
+    
+    return original_bytes > 0 ? static_cast<double>(original_bytes) / encoded_size : 0.0;
+}
+
+size_t DictionaryCodec::getFrequency(const std::string& value) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    uint32_t id;
+    return lookupId(value, id) ? id_frequencies[id] : 0;
+}
+
+std::vector<size_t> DictionaryCodec::getValueHistogram() const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    return id_frequencies;
+}
+
+std::vector<std::pair<std::string, size_t>> DictionaryCodec::getTopFrequentValues(size_t k) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    return selectTopK(id_frequencies, k);
+}
+
+std::vector<size_t> DictionaryCodec::getValueHistogram(
+    size_t begin_row, size_t end_row, int num_threads) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    clampRowRange(begin_row, end_row);
+    
+    // The whole column is already aggregated
+    if (begin_row == 0 && end_row == encoded_data.size()) {
+        return id_frequencies;
+    }
+    
+    size_t rows = end_row - begin_row;
+    size_t max_threads = num_threads > 0 ? num_threads : std::max(1u, std::thread::hardware_concurrency());
+    size_t thread_count = std::max<size_t>(1, std::min(max_threads, rows / MIN_ROWS_PER_THREAD));
+    size_t rows_per_thread = rows / thread_count;
+    
+    // Privatized 32-bit counts per thread; merged into the result afterwards. Small
+    // dictionaries get interleaved lane copies to break store dependencies on repeated IDs
+    size_t lanes = valueCount() <= MAX_LANE_HISTOGRAM_IDS ? ScanKernels::HISTOGRAM_LANES : 1;
+    std::vector<std::vector<uint32_t>> thread_counts(thread_count);
+    std::vector<std::thread> threads;
+    threads.reserve(thread_count);
+    
+    for (size_t t = 0; t < thread_count; t++) {
+        size_t start = begin_row + t * rows_per_thread;
+        size_t end = (t == thread_count - 1) ? end_row : start + rows_per_thread;
+        threads.emplace_back([this, &thread_counts, t, start, end, lanes]() {
+            thread_counts[t].assign(valueCount() * lanes, 0);
+            if (lanes > 1) {
+                ScanKernels::histogramAddLanes(encoded_data.data(), start, end, thread_counts[t].data());
+            } else {
+                ScanKernels::histogramAdd(encoded_data.data(), start, end, thread_counts[t].data());
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    
+    std::vector<size_t> histogram(valueCount(), 0);
+    for (const auto& counts : thread_counts) {
+        for (size_t slot = 0; slot < counts.size(); slot++) {
+            histogram[slot / lanes] += counts[slot];
+        }
+    }
+    return histogram;
+}
+
+std::vector<std::pair<std::string, size_t>> DictionaryCodec::getTopFrequentValues(
+    size_t k, size_t begin_row, size_t end_row, int num_threads) const {
+    std::vector<size_t> histogram = getValueHistogram(begin_row, end_row, num_threads);
+    
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    return selectTopK(histogram, k);
+}
+
+std::vector<std::pair<std::string, size_t>> DictionaryCodec::complete(
+    const std::string& prefix, size_t k) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    k = std::min(k, CompletionIndex::NODE_TOP_K);
+    
+    std::shared_ptr<const CompletionIndex> index;
+    {
+        std::lock_guard<std::mutex> guard(completion_mutex);
+        bool usable = completion_index && completion_epoch == column_epoch;
+        if ((!usable || completion_index->getVersion() != stats_version) && !completion_rebuilding) {
+            // IDs only ever gain rows within an epoch, so the old index stays valid meanwhile
+            completion_rebuilding = true;
+            completion_build = std::async(std::launch::async, [this] { rebuildCompletionIndex(); });
+        }
+        if (usable) {
+            index = completion_index;
+        }
     }
     
-    // Calculate encoded size (dictionary + encoded data)
-    size_t encoded_size = 0;
-    for (const auto& entry : dictionary) {
-        encoded_size += entry.first.length() + sizeof(uint32_t);  // String + ID in dictionary
+    if (!index) {
+        // No index describes these IDs yet: rank the prefix's values directly until one lands
+        std::vector<uint32_t> ids;
+        size_t count = std::min(valueCount(), id_frequencies.size());
+        for (uint32_t id = 0; id < count; id++) {
+            if (id_frequencies[id] > 0 && valueAt(id).compare(0, prefix.length(), prefix) == 0) {
+                ids.push_back(id);
+            }
+        }
+        return selectTopK(id_frequencies, std::move(ids), k);
     }
-    encoded_size += encoded_data.size() * sizeof(uint32_t);  // Encoded data array
     
-    return original_size > 0 ? static_cast<double>(original_size) / encoded_size : 0.0;
+    std::vector<std::pair<std::string, size_t>> results;
+    for (uint32_t id : index->complete(valueArena(), prefix, k)) {
+        results.emplace_back(valueAt(id), index->getFrequency(id));
+    }
+    return results;
+}
+
+void DictionaryCodec::rebuildCompletionIndex() const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    auto index = std::make_shared<CompletionIndex>(valueArena(), valueCount(), id_frequencies, stats_version);
+    
+    std::lock_guard<std::mutex> guard(completion_mutex);
+    completion_index = std::move(index);
+    completion_epoch = column_epoch;
+    completion_rebuilding = false;
+}
+
+std::vector<std::pair<std::string, size_t>> DictionaryCodec::selectTopK(
+    const std::vector<size_t>& counts, size_t k) const {
+    std::vector<uint32_t> ids;
+    ids.reserve(counts.size());
+    for (uint32_t id = 0; id < counts.size(); id++) {
+        if (counts[id] > 0) {
+            ids.push_back(id);
+        }
+    }
+    return selectTopK(counts, std::move(ids), k);
 }
+
+std::vector<std::pair<std::string, size_t>> DictionaryCodec::selectTopK(
+    const std::vector<size_t>& counts, std::vector<uint32_t> ids, size_t k) const {
+    std::vector<std::pair<std::string, size_t>> results;
+    k = std::min(k, ids.size());
+    
+    // Select the k largest in O(dict), then order only those
+    auto by_count = [&counts](uint32_t a, uint32_t b) {
+        return counts[a] != counts[b] ? counts[a] > counts[b] : a < b;
+    };
+    std::nth_element(ids.begin(), ids.begin() + k, ids.end(), by_count);
+    std::sort(ids.begin(), ids.begin() + k, by_count);
+    
+    results.reserve(k);
+    for (size_t i = 0; i < k; i++) {
+        results.emplace_back(valueAt(ids[i]), counts[ids[i]]);
+    }
+    return results;
+}
+
+void DictionaryCodec::clampRowRange(size_t& begin_row, size_t& end_row) const {
+    end_row = std::min(end_row, encoded_data.size());
+    begin_row = std::min(begin_row, end_row);
+}
+
 size_t DictionaryCodec::getMemoryUsage() const {
     size_t usage = 0;
     for (const auto& [str, _] : dictionary) {
         usage += str.length() + sizeof(uint32_t);
     }
+    usage += loaded_hash_index.size() * sizeof(uint32_t);
     for (const auto& str : reverse_dictionary) {
         usage += str.length();
     }
     usage += encoded_data.size() * sizeof(uint32_t);
+    usage += id_frequencies.size() * sizeof(size_t);
+    usage += value_offsets.size() * sizeof(uint32_t) + value_bytes.size();
     for (const auto& str : original_data) {
         usage += str.length();
     }
@@ -93,9 +462,8 @@ void DictionaryCodec::encodeFile(const std::string& filename, int num_threads) {
     const size_t CHUNK_SIZE = 10 * 1024 * 1024;  // 10MB chunks (reduced from 100MB)
     const size_t MAX_LINES_PER_CHUNK = CHUNK_SIZE / 16;  // Estimate average line length
     
-    // Pre-allocate a fixed size for the dictionary to prevent reallocation
-    dictionary.reserve(1000000);  // Reserve space for 1M unique strings
-    reverse_dictionary.reserve(1000000);
+    // Existing IDs are kept, so a mapped snapshot has to become owned first
+    materialize();
     
     // Count lines first to properly size vectors
     size_t total_lines = 0;
@@ -107,8 +475,32 @@ void DictionaryCodec::encodeFile(const std::string& filename, int num_threads) {
         }
     }
     
-    // Reserve space once
-    encoded_data.resize(total_lines);
+    {
+        std::unique_lock<std::shared_mutex> write_lock(mutex);
+        rejectWhileLogging("encodeFile");
+        column_epoch++;
+        
+        // Pre-allocate a fixed size for the dictionary to prevent reallocation
+        dictionary.reserve(1000000);  // Reserve space for 1M unique strings
+        reverse_dictionary.reserve(1000000);
+        
+        // Reserve space once
+        encoded_data.resize(total_lines);
+        
+        // Every row is rewritten, so no cached result survives
+        if (result_cache) {
+            result_cache->clear();
+        }
+        
+        // Frequencies describe the newly encoded rows only
+        id_frequencies.assign(dictionary.size(), 0);
+        original_bytes = 0;
+        stats_version++;
+    }
+    
+    // Per-thread counters, reused across chunks and merged once at the end
+    std::vector<std::vector<size_t>> thread_counts(num_threads);
+    std::vector<size_t> thread_bytes(num_threads, 0);
     
     // Reopen file for processing
     file.clear();
@@ -155,8 +547,9 @@ void DictionaryCodec::encodeFile(const std::string& filename, int num_threads) {
             auto chunk_begin = chunk_data.begin() + start;
             auto chunk_end = chunk_data.begin() + end;
             
-            threads.emplace_back(&DictionaryCodec::encodeSingleThread, this,
-                std::vector<std::string>(chunk_begin, chunk_end), thread_offset);
+            threads.emplace_back(&DictionaryCodec::encodeChunk, this,
+                std::vector<std::string>(chunk_begin, chunk_end), thread_offset,
+                std::ref(thread_counts[i]), std::ref(thread_bytes[i]));
         }
         
         // Wait for threads to complete
@@ -176,47 +569,221 @@ void DictionaryCodec::encodeFile(const std::string& filename, int num_threads) {
         std::vector<std::string>().swap(chunk_data);
     }
     
+    for (int i = 0; i < num_threads; i++) {
+        mergeFrequencies(thread_counts[i], thread_bytes[i]);
+    }
+    
     std::cout << "\nProcessed " << processed_lines << " lines\n";
     std::cout << "Dictionary size: " << dictionary.size() << " entries\n";
 }
 
 void DictionaryCodec::encodeSingleThread(const std::vector<std::string>& chunk, size_t start_idx) {
+    materialize();
+    {
+        std::unique_lock<std::shared_mutex> write_lock(mutex);
+        rejectWhileLogging("encodeSingleThread");
+        if (start_idx > encoded_data.size()) {
+            throw std::runtime_error("encodeSingleThread would leave a gap after the last row");
+        }
+        column_epoch++;
+        
+        // The chunk's rows are rewritten, so cached results over them are stale
+        if (result_cache) {
+            result_cache->clear();
+        }
+        
+        // Rows already encoded stop counting towards their old values; rows past
+        // the end extend the column
+        size_t end_idx = start_idx + chunk.size();
+        for (size_t row = start_idx; row < std::min(end_idx, encoded_data.size()); row++) {
+            uint32_t old_id = encoded_data[row];
+            id_frequencies[old_id]--;
+            original_bytes -= valueAt(old_id).length();
+        }
+        if (end_idx > encoded_data.size()) {
+            encoded_data.resize(end_idx);
+        }
+        stats_version++;
+    }
+    std::vector<size_t> local_counts;
+    size_t local_bytes = 0;
+    encodeChunk(chunk, start_idx, local_counts, local_bytes);
+    mergeFrequencies(local_counts, local_bytes);
+}
+
+void DictionaryCodec::mergeFrequencies(const std::vector<size_t>& local_counts, size_t local_bytes) {
+    std::unique_lock<std::shared_mutex> write_lock(mutex);
+    // Local arrays grow geometrically, so they can be longer than the dictionary
+    size_t n = std::min(local_counts.size(), id_frequencies.size());
+    for (size_t id = 0; id < n; id++) {
+        id_frequencies[id] += local_counts[id];
+    }
+    original_bytes += local_bytes;
+    stats_version++;
+}
+
+void DictionaryCodec::rebuildFrequencies() {
+    id_frequencies.assign(valueCount(), 0);
+    original_bytes = 0;
+    for (uint32_t id : encoded_data) {
+        id_frequencies[id]++;
+    }
+    for (uint32_t id = 0; id < id_frequencies.size(); id++) {
+        original_bytes += id_frequencies[id] * valueAt(id).length();
+    }
+    stats_version++;
+}
+
+uint32_t DictionaryCodec::addDictionaryEntry(const std::string& value) {
+    uint32_t new_id = dictionary.size();
+    dictionary[value] = new_id;
+    reverse_dictionary.push_back(value);
+    appendToArena(value);
+    dictionary_bytes += value.length();
+    // Readers may count the ID as soon as the lock drops, before encoding merges its rows
+    id_frequencies.resize(valueCount(), 0);
+    prefix_memo.addEntry(value, new_id);
+    stats_version++;
+    return new_id;
+}
+
+void DictionaryCodec::appendValues(const std::vector<std::string>& values) {
+    std::shared_ptr<WriteAheadLog> log;
+    uint64_t log_position = 0;
+    {
+        std::unique_lock<std::shared_mutex> write_lock(mutex);
+        materializeSnapshot();
+        size_t first_row = encoded_data.size();
+        size_t base_dict_size = valueCount();
+        encoded_data.reserve(encoded_data.size() + values.size());
+        
+        for (const auto& value : values) {
+            auto it = dictionary.find(value);
+            uint32_t id = it != dictionary.end() ? it->second : addDictionaryEntry(value);
+            encoded_data.push_back(id);
+            id_frequencies[id]++;
+            original_bytes += value.length();
+        }
+        stats_version++;
+        
+        // Logged under the lock, so records land in the order they were applied
+        if (wal) {
+            AppendRecord record;
+            record.base_dict_size = base_dict_size;
+            record.first_row = first_row;
+            for (uint32_t id = base_dict_size; id < valueCount(); id++) {
+                record.entries.emplace_back(valueAt(id));
+            }
+            for (size_t row = first_row; row < encoded_data.size(); row++) {
+                if (!record.runs.empty() && record.runs.back().first == encoded_data[row]) {
+                    record.runs.back().second++;
+                } else {
+                    record.runs.emplace_back(encoded_data[row], 1);
+                }
+            }
+            log_position = wal->append(record);
+            log = wal;
+        }
+    }
+    
+    // Group commit: wait for the fdatasync covering this record without holding the lock
+    if (log) {
+        log->sync(log_position);
+    }
+}
+
+void DictionaryCodec::rejectWhileLogging(const std::string& operation) const {
+    // The log records appends only, and replaying them over a rewritten column cannot work
+    if (wal) {
+        throw std::runtime_error(operation + " rewrites the column while the write-ahead log is enabled; "
+                                 "call disableWriteAheadLog() first");
+    }
+}
+
+void DictionaryCodec::applyAppendRecord(const AppendRecord& record) {
+    // A checkpoint may have captured the record before the log was cut
+    size_t rows = encoded_data.size();
+    size_t count = valueCount();
+    if (record.first_row + record.rowCount() <= rows && record.base_dict_size + record.entries.size() <= count) {
+        return;
+    }
+    if (record.first_row != rows || record.base_dict_size != count) {
+        throw std::runtime_error("Write-ahead log does not continue the loaded state");
+    }
+    
+    materializeSnapshot();
+    for (const auto& entry : record.entries) {
+        addDictionaryEntry(entry);
+    }
+    for (const auto& [id, length] : record.runs) {
+        if (id >= valueCount()) {
+            throw std::runtime_error("Write-ahead log references unknown ID " + std::to_string(id));
+        }
+        encoded_data.resize(encoded_data.size() + length);
+        std::fill(encoded_data.data() + encoded_data.size() - length, encoded_data.data() + encoded_data.size(), id);
+        id_frequencies[id] += length;
+        original_bytes += static_cast<size_t>(length) * valueAt(id).length();
+    }
+    stats_version++;
+}
+
+void DictionaryCodec::encodeChunk(const std::vector<std::string>& chunk, size_t start_idx,
+                                  std::vector<size_t>& local_counts, size_t& local_bytes) {
     const size_t BATCH_SIZE = 100;  // Reduced batch size for better memory usage
     std::vector<std::pair<std::string, size_t>> pending_inserts;
     pending_inserts.reserve(BATCH_SIZE);
     
+    // Thread-private counts; the dictionary may grow underneath us, so size on demand
+    auto countLocal = [&local_counts](uint32_t id) {
+        if (id >= local_counts.size()) {
+            local_counts.resize(std::max<size_t>(id + 1, local_counts.size() * 2), 0);
+        }
+        local_counts[id]++;
+    };
+    
+    auto flushPending = [&]() {
+        std::unique_lock<std::shared_mutex> write_lock(mutex);
+        
+        for (const auto& [pending_str, idx] : pending_inserts) {
+            auto it = dictionary.find(pending_str);
+            if (it == dictionary.end()) {
+                uint32_t new_id = addDictionaryEntry(pending_str);
+                encoded_data[idx] = new_id;
+                countLocal(new_id);
+            } else {
+                encoded_data[idx] = it->second;
+                countLocal(it->second);
+            }
+        }
+        
+        pending_inserts.clear();
+    };
+    
     for (size_t i = 0; i < chunk.size(); i++) {
         const auto& str = chunk[i];
+        local_bytes += str.length();
         
         {
             std::shared_lock<std::shared_mutex> read_lock(mutex);
             auto it = dictionary.find(str);
             if (it != dictionary.end()) {
                 encoded_data[start_idx + i] = it->second;
+                countLocal(it->second);
                 continue;
             }
         }
         
         pending_inserts.emplace_back(str, start_idx + i);
         
-        if (pending_inserts.size() >= BATCH_SIZE || i == chunk.size() - 1) {
-            std::unique_lock<std::shared_mutex> write_lock(mutex);
-            
-            for (const auto& [pending_str, idx] : pending_inserts) {
-                auto it = dictionary.find(pending_str);
-                if (it == dictionary.end()) {
-                    uint32_t new_id = dictionary.size();
-                    dictionary[pending_str] = new_id;
-                    reverse_dictionary.push_back(pending_str);
-                    encoded_data[idx] = new_id;
-                } else {
-                    encoded_data[idx] = it->second;
-                }
-            }
-            
-            pending_inserts.clear();
+        if (pending_inserts.size() >= BATCH_SIZE) {
+            flushPending();
         }
     }
+    
+    // The chunk may end on a dictionary hit with inserts still pending
+    if (!pending_inserts.empty()) {
+        flushPending();
+    }
 }
 
 std::vector<size_t> DictionaryCodec::baselineFind(const std::string& target) const {
@@ -234,13 +801,12 @@ std::vector<size_t> DictionaryCodec::findMatches(const std::string& target) cons
     std::shared_lock<std::shared_mutex> lock(mutex);
     std::vector<size_t> results;
     
-    auto it = dictionary.find(target);
-    if (it == dictionary.end()) {
+    uint32_t target_id;
+    if (!lookupId(target, target_id)) {
         std::cout << " (not found in dictionary)\n" << std::flush;
         return results;
     }
     
-    uint32_t target_id = it->second;
     __m256i target_vec = _mm256_set1_epi32(target_id);
     
     size_t processed = 0;
@@ -268,104 +834,485 @@ std::vector<size_t> DictionaryCodec::findMatches(const std::string& target) cons
 }
 
 std::vector<size_t> DictionaryCodec::findMatchesSIMD(const std::string& target) const {
+    return findMatchesSIMD(target, 0, ALL_ROWS);
+}
+
+std::vector<size_t> DictionaryCodec::findMatchesSIMD(
+    const std::string& target, size_t begin_row, size_t end_row) const {
     std::shared_lock<std::shared_mutex> lock(mutex);
     std::vector<size_t> results;
-    results.reserve(1000);  // Pre-allocate space
+    clampRowRange(begin_row, end_row);
+    
+    uint32_t id;
+    if (!lookupId(target, id)) {
+        return results;
+    }
+    
+    // The frequency table gives the exact size for full scans
+    results.reserve(end_row - begin_row == encoded_data.size() ? id_frequencies[id] : 1000);
+    ScanKernels::forEachEqual(encoded_data.data(), begin_row, end_row, id,
+        [&results](size_t row) { results.push_back(row); return true; });
+    
+    return results;
+}
+
+template <typename Visit>
+bool DictionaryCodec::visitPrefixIds(const std::string& prefix, Visit&& visit) const {
+    // Narrow the longest memoized ancestor rather than walking the whole dictionary
+    size_t matched_length = 0;
+    auto closest = prefix_memo.findClosest(prefix, matched_length);
+    if (closest && matched_length == prefix.length()) {
+        for (uint32_t id : *closest) {
+            visit(id);
+        }
+        return true;
+    }
+    
+    if (closest) {
+        for (uint32_t id : *closest) {
+            std::string_view str = valueAt(id);
+            if (str.length() >= prefix.length() && 
+                str.compare(matched_length, prefix.length() - matched_length,
+                            prefix, matched_length, std::string::npos) == 0) {
+                visit(id);
+            }
+        }
+    } else {
+        // Walking the arena in ID order visits the set sorted
+        for (uint32_t id = 0; id < valueCount(); id++) {
+            std::string_view str = valueAt(id);
+            if (str.length() >= prefix.length() && 
+                str.compare(0, prefix.length(), prefix) == 0) {
+                visit(id);
+            }
+        }
+    }
+    return false;
+}
+
+void DictionaryCodec::collectPrefixIds(const std::string& prefix, std::vector<uint32_t>& ids) const {
+    size_t first = ids.size();
+    if (!visitPrefixIds(prefix, [&ids](uint32_t id) { ids.push_back(id); })) {
+        prefix_memo.store(prefix, std::vector<uint32_t>(ids.begin() + first, ids.end()));
+    }
+}
+
+void DictionaryCodec::buildIdBitmap(const std::vector<uint32_t>& ids, std::vector<uint32_t>& bitmap) const {
+    // One bit per dictionary ID, rounded up to whole 32-bit words for the gather kernels
+    bitmap.assign((valueCount() + 31) / 32, 0);
+    for (uint32_t id : ids) {
+        bitmap[id >> 5] |= 1u << (id & 31);
+    }
+}
+
+size_t DictionaryCodec::countMatches(const std::string& target) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    
+    uint32_t id;
+    return lookupId(target, id) ? id_frequencies[id] : 0;
+}
+
+size_t DictionaryCodec::countPrefix(const std::string& prefix) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    
+    if (prefix.empty()) {
+        return 0;
+    }
+    
+    // Sums straight from the memo or the arena walk; nothing is collected or memoized
+    size_t count = 0;
+    visitPrefixIds(prefix, [this, &count](uint32_t id) { count += id_frequencies[id]; });
+    return count;
+}
+
+bool DictionaryCodec::exists(const std::string& target) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    
+    uint32_t id;
+    return lookupId(target, id) && id_frequencies[id] > 0;
+}
+
+size_t DictionaryCodec::countMatches(
+    const std::string& target, size_t begin_row, size_t end_row) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    clampRowRange(begin_row, end_row);
+    
+    uint32_t id;
+    if (!lookupId(target, id)) {
+        return 0;
+    }
+    if (end_row - begin_row == encoded_data.size()) {
+        return id_frequencies[id];
+    }
+    
+    return ScanKernels::countEqual(encoded_data.data(), begin_row, end_row, id);
+}
+
+size_t DictionaryCodec::countPrefix(
+    const std::string& prefix, size_t begin_row, size_t end_row) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    clampRowRange(begin_row, end_row);
+    
+    if (prefix.empty()) {
+        return 0;
+    }
+    
+    if (end_row - begin_row == encoded_data.size()) {
+        size_t count = 0;
+        visitPrefixIds(prefix, [this, &count](uint32_t id) { count += id_frequencies[id]; });
+        return count;
+    }
+    
+    // Per-thread bitmap, reused across calls; nothing runs between filling and scanning it
+    thread_local std::vector<uint32_t> bitmap;
+    bitmap.assign((valueCount() + 31) / 32, 0);
+    size_t matches = 0;
+    uint32_t first_id = 0;
+    visitPrefixIds(prefix, [&](uint32_t id) {
+        if (matches++ == 0) {
+            first_id = id;
+        }
+        bitmap[id >> 5] |= 1u << (id & 31);
+    });
+    if (matches == 0) {
+        return 0;
+    }
+    
+    // A single matching ID is cheaper as a broadcast compare than a gather
+    if (matches == 1) {
+        return ScanKernels::countEqual(encoded_data.data(), begin_row, end_row, first_id);
+    }
+    return ScanKernels::countInBitmap(encoded_data.data(), begin_row, end_row, bitmap.data());
+}
+
+bool DictionaryCodec::exists(const std::string& target, size_t begin_row, size_t end_row) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    clampRowRange(begin_row, end_row);
+    
+    uint32_t id;
+    if (!lookupId(target, id) || id_frequencies[id] == 0) {
+        return false;
+    }
     
-    auto it = dictionary.find(target);
-    if (it == dictionary.end()) {
+    // Stops at the first matching block instead of scanning the whole window
+    return ScanKernels::findFirstEqual(encoded_data.data(), begin_row, end_row, id) < end_row;
+}
+
+std::vector<std::pair<std::string, std::vector<size_t>>> DictionaryCodec::prefixSearchSIMD(
+    const std::string& prefix) const {
+    return prefixSearchSIMD(prefix, 0, ALL_ROWS);
+}
+
+std::vector<std::pair<std::string, std::vector<size_t>>> DictionaryCodec::prefixSearchSIMD(
+    const std::string& prefix, size_t begin_row, size_t end_row) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    std::vector<std::pair<std::string, std::vector<size_t>>> results;
+    clampRowRange(begin_row, end_row);
+    
+    if (prefix.empty()) {
         return results;
     }
     
-    uint32_t target_id = it->second;
-    __m256i target_vec = _mm256_set1_epi32(target_id);
-    
-    // Process in larger chunks (32 integers at a time)
-    const size_t CHUNK_SIZE = 32;
-    const size_t num_chunks = encoded_data.size() / CHUNK_SIZE;
-    
-    for (size_t chunk = 0; chunk < num_chunks; chunk++) {
-        const size_t base_idx = chunk * CHUNK_SIZE;
-        
-        // Process 4 sets of 8 integers each
-        for (size_t i = 0; i < 4; i++) {
-            __m256i data_vec = _mm256_loadu_si256(
-                (__m256i*)&encoded_data[base_idx + i * 8]);
-            __m256i cmp = _mm256_cmpeq_epi32(data_vec, target_vec);
-            int mask = _mm256_movemask_ps(_mm256_castsi256_ps(cmp));
-            
-            while (mask) {
-                int idx = _tzcnt_u32(mask);
-                size_t actual_idx = base_idx + i * 8 + idx;
-                if (actual_idx < encoded_data.size()) {
-                    results.push_back(actual_idx);
-                }
-                mask &= mask - 1;
-            }
-        }
+    // First find all matching dictionary entries
+    std::vector<uint32_t> ids;
+    collectPrefixIds(prefix, ids);
+    if (ids.empty()) {
+        return results;
+    }
+    
+    // One result slot per matching ID, in ID order
+    results.reserve(ids.size());
+    for (uint32_t id : ids) {
+        results.emplace_back(valueAt(id), std::vector<size_t>());
+    }
+    
+    // The slot of a matching ID is its rank in the bitmap: set bits in earlier words
+    // plus set bits below it in its own word
+    std::vector<uint32_t> bitmap;
+    buildIdBitmap(ids, bitmap);
+    std::vector<uint32_t> word_ranks(bitmap.size());
+    uint32_t rank = 0;
+    for (size_t word = 0; word < bitmap.size(); word++) {
+        word_ranks[word] = rank;
+        rank += __builtin_popcount(bitmap[word]);
+    }
+    
+    // Then search for all matching IDs in one pass over the window
+    ScanKernels::forEachInBitmap(encoded_data.data(), begin_row, end_row, bitmap.data(),
+        [&](size_t row) {
+            uint32_t id = encoded_data[row];
+            uint32_t below = bitmap[id >> 5] & ((1u << (id & 31)) - 1);
+            results[word_ranks[id >> 5] + __builtin_popcount(below)].second.push_back(row);
+            return true;
+        });
+    
+    return results;
+}
+
+
+size_t DictionaryCodec::scanIds(const std::vector<uint32_t>& ids, size_t begin_row, size_t end_row,
+                                const MatchSink& sink) const {
+    // Matches are staged on the stack and handed over a chunk at a time
+    uint32_t buffer[SINK_CHUNK_ROWS];
+    size_t buffered = 0;
+    size_t total = 0;
+    bool stopped = false;
+    
+    auto emit = [&](size_t row) {
+        buffer[buffered++] = static_cast<uint32_t>(row);
+        if (buffered == SINK_CHUNK_ROWS) {
+            total += buffered;
+            stopped = !sink(buffer, buffered);
+            buffered = 0;
+        }
+        return !stopped;
+    };
+    
+    if (ids.size() == 1) {
+        ScanKernels::forEachEqual(encoded_data.data(), begin_row, end_row, ids[0], emit);
+    } else if (!ids.empty()) {
+        // Scratch bitmap is reused by every query on this thread
+        static thread_local std::vector<uint32_t> bitmap;
+        buildIdBitmap(ids, bitmap);
+        ScanKernels::forEachInBitmap(encoded_data.data(), begin_row, end_row, bitmap.data(), emit);
+    }
+    
+    if (buffered > 0 && !stopped) {
+        total += buffered;
+        sink(buffer, buffered);
+    }
+    return total;
+}
+
+void DictionaryCodec::scanMatches(const std::string& target, const MatchSink& sink,
+                                  size_t begin_row, size_t end_row) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    clampRowRange(begin_row, end_row);
+    
+    static thread_local std::vector<uint32_t> ids;
+    ids.clear();
+    uint32_t id;
+    if (lookupId(target, id)) {
+        ids.push_back(id);
+    }
+    scanIds(ids, begin_row, end_row, sink);
+}
+
+void DictionaryCodec::scanPrefix(const std::string& prefix, const MatchSink& sink,
+                                 size_t begin_row, size_t end_row) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    clampRowRange(begin_row, end_row);
+    
+    static thread_local std::vector<uint32_t> ids;
+    ids.clear();
+    if (!prefix.empty()) {
+        collectPrefixIds(prefix, ids);
+    }
+    scanIds(ids, begin_row, end_row, sink);
+}
+
+size_t DictionaryCodec::findMatchesInto(const std::string& target, std::vector<uint32_t>& out,
+                                        size_t begin_row, size_t end_row) const {
+    out.clear();
+    scanMatches(target, [&out](const uint32_t* rows, size_t count) {
+        out.insert(out.end(), rows, rows + count);
+        return true;
+    }, begin_row, end_row);
+    return out.size();
+}
+
+size_t DictionaryCodec::prefixSearchInto(const std::string& prefix, std::vector<uint32_t>& out,
+                                         size_t begin_row, size_t end_row) const {
+    out.clear();
+    scanPrefix(prefix, [&out](const uint32_t* rows, size_t count) {
+        out.insert(out.end(), rows, rows + count);
+        return true;
+    }, begin_row, end_row);
+    return out.size();
+}
+
+
+size_t DictionaryCodec::pageIds(const std::vector<uint32_t>& ids, SearchCursor& cursor, size_t limit,
+                                size_t offset, std::vector<uint32_t>& out) const {
+    out.clear();
+    size_t begin_row = cursor.next_row;
+    clampRowRange(begin_row, cursor.end_row);
+    
+    if (ids.empty() || cursor.done) {
+        cursor.next_row = cursor.end_row;
+        cursor.done = true;
+        return 0;
+    }
+    if (limit == 0) {
+        return 0;
+    }
+    
+    static thread_local std::vector<uint32_t> bitmap;
+    const bool single = ids.size() == 1;
+    if (!single) {
+        buildIdBitmap(ids, bitmap);
+    }
+    
+    // OFFSET: jump to the first match to return by counting, not emitting
+    if (offset > 0) {
+        begin_row = single
+            ? ScanKernels::findNthEqual(encoded_data.data(), begin_row, cursor.end_row, ids[0], offset)
+            : ScanKernels::findNthInBitmap(encoded_data.data(), begin_row, cursor.end_row, bitmap.data(), offset);
+    }
+    
+    // LIMIT: the kernel stops as soon as the page is full
+    out.reserve(std::min<size_t>(limit, SINK_CHUNK_ROWS));
+    auto emit = [&out, limit](size_t row) {
+        out.push_back(static_cast<uint32_t>(row));
+        return out.size() < limit;
+    };
+    cursor.next_row = single
+        ? ScanKernels::forEachEqual(encoded_data.data(), begin_row, cursor.end_row, ids[0], emit)
+        : ScanKernels::forEachInBitmap(encoded_data.data(), begin_row, cursor.end_row, bitmap.data(), emit);
+    cursor.done = cursor.next_row >= cursor.end_row;
+    
+    return out.size();
+}
+
+size_t DictionaryCodec::findMatchesPage(const std::string& target, SearchCursor& cursor, size_t limit,
+                                        std::vector<uint32_t>& out, size_t offset) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    
+    static thread_local std::vector<uint32_t> ids;
+    ids.clear();
+    uint32_t id;
+    if (lookupId(target, id)) {
+        ids.push_back(id);
+    }
+    return pageIds(ids, cursor, limit, offset, out);
+}
+
+size_t DictionaryCodec::prefixSearchPage(const std::string& prefix, SearchCursor& cursor, size_t limit,
+                                         std::vector<uint32_t>& out, size_t offset) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    
+    static thread_local std::vector<uint32_t> ids;
+    ids.clear();
+    if (!prefix.empty()) {
+        collectPrefixIds(prefix, ids);
+    }
+    return pageIds(ids, cursor, limit, offset, out);
+}
+
+
+ResultSet DictionaryCodec::resultOfIds(const std::vector<uint32_t>& ids, size_t begin_row, size_t end_row) const {
+    static thread_local std::vector<uint32_t> positions;
+    positions.clear();
+    scanIds(ids, begin_row, end_row, [](const uint32_t* rows, size_t count) {
+        positions.insert(positions.end(), rows, rows + count);
+        return true;
+    });
+    return ResultSet(positions, encoded_data.size());
+}
+
+ResultSet DictionaryCodec::findMatchesResult(const std::string& target,
+                                             size_t begin_row, size_t end_row) const {
+    // The positions and the row count they are encoded against come from one lock hold
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    clampRowRange(begin_row, end_row);
+    
+    static thread_local std::vector<uint32_t> ids;
+    ids.clear();
+    uint32_t id;
+    if (lookupId(target, id)) {
+        ids.push_back(id);
+    }
+    return resultOfIds(ids, begin_row, end_row);
+}
+
+ResultSet DictionaryCodec::prefixSearchResult(const std::string& prefix,
+                                              size_t begin_row, size_t end_row) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    clampRowRange(begin_row, end_row);
+    
+    static thread_local std::vector<uint32_t> ids;
+    ids.clear();
+    if (!prefix.empty()) {
+        collectPrefixIds(prefix, ids);
+    }
+    return resultOfIds(ids, begin_row, end_row);
+}
+
+
+void DictionaryCodec::enableResultCache(size_t max_bytes) {
+    std::unique_lock<std::shared_mutex> write_lock(mutex);
+    result_cache = max_bytes > 0 ? std::make_unique<ResultCache>(max_bytes) : nullptr;
+}
+
+void DictionaryCodec::disableResultCache() {
+    enableResultCache(0);
+}
+
+std::shared_ptr<const ResultSet> DictionaryCodec::cachedSearch(QueryKey key) const {
+    size_t window_end = std::min(key.end_row, encoded_data.size());
+    size_t rows_covered = 0;
+    std::shared_ptr<const ResultSet> cached;
+    if (result_cache) {
+        cached = result_cache->lookup(key, rows_covered);
+        if (cached && rows_covered >= window_end) {
+            return cached;
+        }
+    }
+    
+    // Scan only the rows the cached result does not cover yet
+    size_t scan_begin = cached ? std::max(rows_covered, key.begin_row) : key.begin_row;
+    static thread_local std::vector<uint32_t> positions;
+    positions.clear();
+    if (scan_begin < window_end) {
+        scanIds(key.ids, scan_begin, window_end, [](const uint32_t* rows, size_t count) {
+            positions.insert(positions.end(), rows, rows + count);
+            return true;
+        });
     }
     
-    // Handle remaining elements
-    for (size_t i = num_chunks * CHUNK_SIZE; i < encoded_data.size(); i++) {
-        if (encoded_data[i] == target_id) {
-            results.push_back(i);
+    std::shared_ptr<ResultSet> result;
+    if (cached) {
+        // Extend in place unless a caller still holds the result; copying it for every
+        // few appended rows would make a growing result quadratic. Cached results are
+        // created mutable below, so dropping the const is well defined
+        if (result_cache->detachIfUnshared(key, cached)) {
+            result = std::const_pointer_cast<ResultSet>(cached);
+        } else {
+            result = std::make_shared<ResultSet>(*cached);
         }
+        result->append(positions.data(), positions.size(), encoded_data.size());
+    } else {
+        result = std::make_shared<ResultSet>(positions, encoded_data.size());
     }
     
-    return results;
+    if (result_cache) {
+        result_cache->insert(key, result, window_end);
+    }
+    return result;
 }
 
-std::vector<std::pair<std::string, std::vector<size_t>>> DictionaryCodec::prefixSearchSIMD(
-    const std::string& prefix) const {
+std::shared_ptr<const ResultSet> DictionaryCodec::findMatchesCached(
+    const std::string& target, size_t begin_row, size_t end_row) const {
     std::shared_lock<std::shared_mutex> lock(mutex);
-    std::vector<std::pair<std::string, std::vector<size_t>>> results;
     
-    if (prefix.empty()) {
-        return results;
-    }
-    
-    // First find all matching dictionary entries
-    std::vector<std::pair<std::string, uint32_t>> matches;
-    matches.reserve(100);
-    
-    for (const auto& [str, id] : dictionary) {
-        if (str.length() >= prefix.length() && 
-            str.compare(0, prefix.length(), prefix) == 0) {
-            matches.emplace_back(str, id);
-        }
+    QueryKey key{{}, begin_row, end_row};
+    uint32_t id;
+    if (lookupId(target, id)) {
+        key.ids.push_back(id);
     }
+    return cachedSearch(std::move(key));
+}
+
+std::shared_ptr<const ResultSet> DictionaryCodec::prefixSearchCached(
+    const std::string& prefix, size_t begin_row, size_t end_row) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
     
-    // Now search for all matching IDs in one pass
-    if (!matches.empty()) {
-        results.reserve(matches.size());
-        std::vector<uint32_t> ids;
-        ids.reserve(matches.size());
-        for (const auto& [str, id] : matches) {
-            ids.push_back(id);
-        }
-        
-        // Create a map to collect results for each ID
-        std::unordered_map<uint32_t, std::vector<size_t>> id_results;
-        for (const auto& id : ids) {
-            id_results[id].reserve(100);
-        }
-        
-        // Scan encoded data once for all IDs
-        for (size_t i = 0; i < encoded_data.size(); i++) {
-            uint32_t current_id = encoded_data[i];
-            auto it = std::find(ids.begin(), ids.end(), current_id);
-            if (it != ids.end()) {
-                id_results[current_id].push_back(i);
-            }
-        }
-        
-        // Build final results
-        for (const auto& [str, id] : matches) {
-            results.emplace_back(str, std::move(id_results[id]));
-        }
+    QueryKey key{{}, begin_row, end_row};
+    if (!prefix.empty()) {
+        collectPrefixIds(prefix, key.ids);
+        std::sort(key.ids.begin(), key.ids.end());
     }
-    
-    return results;
+    return cachedSearch(std::move(key));
 }
 
 
@@ -385,22 +1332,23 @@ std::vector<std::pair<std::string, std::vector<size_t>>> DictionaryCodec::baseli
     std::vector<std::string> matching_strings;
     matching_strings.reserve(100);
     
-    for (const auto& [str, _] : dictionary) {
+    for (uint32_t id = 0; id < valueCount(); id++) {
+        std::string str(valueAt(id));
         if (str.length() >= prefix.length() && 
             str.compare(0, prefix.length(), prefix) == 0) {
-            matching_strings.push_back(str);
             matches[str].reserve(100);  // Pre-allocate space for positions
+            matching_strings.push_back(std::move(str));
         }
     }
     
     // Second pass: find positions
     for (size_t i = 0; i < encoded_data.size(); i++) {
         uint32_t id = encoded_data[i];
-        if (id < reverse_dictionary.size()) {  // Bounds check
-            const std::string& str = reverse_dictionary[id];
+        if (id < valueCount()) {  // Bounds check
+            std::string_view str = valueAt(id);
             if (str.length() >= prefix.length() && 
                 str.compare(0, prefix.length(), prefix) == 0) {
-                matches[str].push_back(i);
+                matches[std::string(str)].push_back(i);
             }
         }
     }
@@ -418,6 +1366,90 @@ std::vector<std::pair<std::string, std::vector<size_t>>> DictionaryCodec::baseli
 }
 
 
+void DictionaryCodec::appendToArena(const std::string& value) {
+    if (value_offsets.empty()) {
+        value_offsets.push_back(0);
+    }
+    if (value_bytes.size() + value.length() > std::numeric_limits<uint32_t>::max()) {
+        throw std::runtime_error("Dictionary arena exceeds 32-bit offsets");
+    }
+    value_bytes.append(value.begin(), value.end());
+    value_offsets.push_back(static_cast<uint32_t>(value_bytes.size()));
+}
+
+void DictionaryCodec::decodeRange(
+    size_t begin_row, size_t end_row, DecodedColumn& out, int num_threads) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    clampRowRange(begin_row, end_row);
+    decodeIds(encoded_data.data() + begin_row, end_row - begin_row, out, num_threads);
+}
+
+void DictionaryCodec::decodePositions(
+    const std::vector<size_t>& positions, DecodedColumn& out, int num_threads) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    for (size_t pos : positions) {
+        if (pos >= encoded_data.size()) {
+            throw std::out_of_range("Decode position past end of data");
+        }
+    }
+    
+    std::vector<uint32_t> ids(positions.size());
+    ScanKernels::gatherIds(encoded_data.data(), positions.data(), positions.size(), ids.data());
+    decodeIds(ids.data(), ids.size(), out, num_threads);
+}
+
+void DictionaryCodec::decodeIds(
+    const uint32_t* ids, size_t count, DecodedColumn& out, int num_threads) const {
+    size_t thread_count = std::max<size_t>(1, std::min<size_t>(std::max(num_threads, 1),
+                                                              count / MIN_ROWS_PER_THREAD));
+    size_t rows_per_thread = count / thread_count;
+    
+    // offsets[i + 1] first receives the length of row i, then becomes the running offset
+    out.offsets.resize(count + 1);
+    out.offsets[0] = 0;
+    uint32_t* lengths = out.offsets.data() + 1;
+    
+    auto runParts = [&](auto&& part) {
+        if (thread_count == 1) {
+            part(0, 0, count);
+            return;
+        }
+        std::vector<std::thread> threads;
+        threads.reserve(thread_count);
+        for (size_t t = 0; t < thread_count; t++) {
+            size_t start = t * rows_per_thread;
+            size_t end = (t == thread_count - 1) ? count : start + rows_per_thread;
+            threads.emplace_back(part, t, start, end);
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    };
+    
+    // Pass 1: gather lengths, one byte total per part
+    std::vector<size_t> part_bytes(thread_count + 1, 0);
+    runParts([&](size_t t, size_t start, size_t end) {
+        part_bytes[t + 1] = ScanKernels::gatherLengths(ids + start, end - start,
+                                                       value_offsets.data(), lengths + start);
+    });
+    std::partial_sum(part_bytes.begin(), part_bytes.end(), part_bytes.begin());
+    if (part_bytes.back() > std::numeric_limits<uint32_t>::max()) {
+        throw std::runtime_error("Decoded column exceeds 32-bit offsets");
+    }
+    out.data.resize(part_bytes.back());
+    
+    // Pass 2: turn lengths into offsets and copy the bytes out of the arena
+    runParts([&](size_t t, size_t start, size_t end) {
+        uint32_t offset = static_cast<uint32_t>(part_bytes[t]);
+        for (size_t i = start; i < end; i++) {
+            uint32_t len = lengths[i];
+            std::memcpy(out.data.data() + offset, value_bytes.data() + value_offsets[ids[i]], len);
+            offset += len;
+            lengths[i] = offset;
+        }
+    });
+}
+
 QueryMetrics DictionaryCodec::benchmarkSearch(
     const std::vector<std::string>& queries, bool use_simd) const {
     QueryMetrics metrics;
@@ -558,122 +1590,877 @@ void DictionaryCodec::compressChunk(const char* input, size_t size,
 }
 
 void DictionaryCodec::decompressChunk(const uint8_t* input, size_t size,
-                                    char* output) const {
-    size_t decompressed_size = ZSTD_decompress(output, encoded_data.size() * sizeof(uint32_t),
-                                             input, size);
+                                    char* output, size_t capacity) const {
+    size_t decompressed_size = ZSTD_decompress(output, capacity, input, size);
     
-    if (ZSTD_isError(decompressed_size)) {
+    if (ZSTD_isError(decompressed_size) || decompressed_size != capacity) {
         throw std::runtime_error("Decompression failed");
     }
 }
 
 void DictionaryCodec::saveToFile(const std::string& filename) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
     std::ofstream file(filename, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Failed to open file for writing: " + filename);
+    }
     
-    size_t dict_size = dictionary.size();
-    file.write(reinterpret_cast<const char*>(&dict_size), sizeof(dict_size));
+    size_t dict_size = valueCount();
+    size_t num_rows = encoded_data.size();
     
-    for (const auto& [str, id] : dictionary) {
-        size_t str_len = str.length();
-        file.write(reinterpret_cast<const char*>(&str_len), sizeof(str_len));
-        file.write(str.c_str(), str_len);
-        file.write(reinterpret_cast<const char*>(&id), sizeof(id));
+    // Compress first, so every section offset is known before anything is written
+    std::vector<std::string_view> values(dict_size);
+    for (uint32_t id = 0; id < dict_size; id++) {
+        values[id] = valueAt(id);
+    }
+    std::vector<uint8_t> dictionary_section = BlockCompression::encodeDictionary(
+        values, BlockCompression::DEFAULT_LEVEL, 0);
+    std::vector<std::vector<uint8_t>> frames;
+    BlockCompression::compressBlocks(encoded_data.data(), num_rows, BlockCompression::DEFAULT_BLOCK_ROWS,
+                                     BlockCompression::DEFAULT_LEVEL, 0, frames);
+    std::vector<BlockCompression::BlockZone> zones = BlockCompression::buildZoneMap(
+        encoded_data.data(), num_rows, BlockCompression::DEFAULT_BLOCK_ROWS, 0);
+    
+    BlockCompression::ColumnFileHeader header{};
+    std::memcpy(header.magic, BlockCompression::FILE_MAGIC, sizeof(header.magic));
+    header.version = BlockCompression::FILE_VERSION;
+    header.level = BlockCompression::DEFAULT_LEVEL;
+    header.dict_size = dict_size;
+    header.num_rows = num_rows;
+    header.block_rows = BlockCompression::DEFAULT_BLOCK_ROWS;
+    header.num_blocks = frames.size();
+    header.dictionary_offset = sizeof(header);
+    header.index_offset = header.dictionary_offset + dictionary_section.size();
+    header.data_offset = header.index_offset
+                       + frames.size() * (sizeof(BlockCompression::BlockRef) + sizeof(BlockCompression::BlockZone));
+    
+    std::vector<BlockCompression::BlockRef> blocks(frames.size());
+    uint64_t offset = 0;
+    for (size_t i = 0; i < frames.size(); i++) {
+        blocks[i] = BlockCompression::BlockRef{offset, frames[i].size()};
+        offset += frames[i].size();
     }
     
-    std::vector<uint8_t> compressed_data;
-    compressChunk(reinterpret_cast<const char*>(encoded_data.data()), 
-                 encoded_data.size() * sizeof(uint32_t),
-                 compressed_data);
-    
-    size_t comp_size = compressed_data.size();
-    file.write(reinterpret_cast<const char*>(&comp_size), sizeof(comp_size));
-    file.write(reinterpret_cast<const char*>(compressed_data.data()), comp_size);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(dictionary_section.data()), dictionary_section.size());
+    file.write(reinterpret_cast<const char*>(blocks.data()), blocks.size() * sizeof(blocks[0]));
+    file.write(reinterpret_cast<const char*>(zones.data()), zones.size() * sizeof(zones[0]));
+    for (const auto& frame : frames) {
+        file.write(reinterpret_cast<const char*>(frame.data()), frame.size());
+    }
+    if (!file) {
+        throw std::runtime_error("Failed to write file: " + filename);
+    }
 }
-
 void DictionaryCodec::loadFromFile(const std::string& filename) {
+    std::unique_lock<std::shared_mutex> write_lock(mutex);
+    rejectWhileLogging("loadFromFile");
     std::ifstream file(filename, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Failed to open file: " + filename);
+    }
     
-    size_t dict_size;
-    file.read(reinterpret_cast<char*>(&dict_size), sizeof(dict_size));
+    // Files written before block compression start directly with the dictionary size
+    BlockCompression::ColumnFileHeader header;
+    bool blocked = BlockCompression::readHeader(file, header);
+    
+    // Decoded into locals and swapped in once everything has validated, so a truncated
+    // or corrupt file leaves the current state untouched
+    std::vector<std::string> values;
+    std::vector<uint32_t> ids;
+    if (blocked) {
+        BlockCompression::readDictionary(file, header, values);
+        
+        // One read for all frames, then independent blocks decompress in parallel
+        std::vector<BlockCompression::BlockRef> blocks = BlockCompression::readBlockIndex(file, header);
+        size_t payload_size = BlockCompression::payloadLength(blocks);
+        std::vector<uint8_t> payload(payload_size);
+        file.seekg(header.data_offset);
+        file.read(reinterpret_cast<char*>(payload.data()), payload_size);
+        if (!file) {
+            throw std::runtime_error("Truncated compressed column in " + filename);
+        }
+        
+        ids.resize(header.num_rows);
+        BlockCompression::decompressBlocks(payload.data(), blocks, header, ids.data(), 0);
+    } else {
+        size_t dict_size;
+        file.read(reinterpret_cast<char*>(&dict_size), sizeof(dict_size));
+        BlockCompression::readDictionaryEntries(file, dict_size, values);
+        
+        size_t comp_size;
+        file.read(reinterpret_cast<char*>(&comp_size), sizeof(comp_size));
+        if (!file) {
+            throw std::runtime_error("Truncated compressed column in " + filename);
+        }
+        
+        std::vector<uint8_t> compressed_data(comp_size);
+        file.read(reinterpret_cast<char*>(compressed_data.data()), comp_size);
+        if (!file) {
+            throw std::runtime_error("Truncated compressed column in " + filename);
+        }
+        
+        // Size the column from the frame header; the current column says nothing about the file
+        unsigned long long decom_size = ZSTD_getFrameContentSize(compressed_data.data(), comp_size);
+        if (decom_size == ZSTD_CONTENTSIZE_ERROR || decom_size == ZSTD_CONTENTSIZE_UNKNOWN) {
+            throw std::runtime_error("Invalid compressed column in " + filename);
+        }
+        ids.resize(decom_size / sizeof(uint32_t));
+        decompressChunk(compressed_data.data(), comp_size, reinterpret_cast<char*>(ids.data()),
+                        ids.size() * sizeof(uint32_t));
+    }
+    if (!idsInRange(ids.data(), ids.size(), values.size())) {
+        throw std::runtime_error("Value ID out of range in " + filename);
+    }
     
+    column_epoch++;
+    releaseSnapshot();
     dictionary.clear();
-    reverse_dictionary.clear();
-    reverse_dictionary.reserve(dict_size);
+    reverse_dictionary = std::move(values);
+    encoded_data.assign(std::move(ids));
+    prefix_memo.clear();
+    if (result_cache) {
+        result_cache->clear();
+    }
+    
+    dictionary_bytes = 0;
+    for (const auto& str : reverse_dictionary) {
+        dictionary_bytes += str.length();
+    }
+    value_offsets.clear();
+    value_bytes.clear();
+    value_bytes.reserve(dictionary_bytes);
+    for (const auto& str : reverse_dictionary) {
+        appendToArena(str);
+    }
+    
+    rebuildFrequencies();
+    
+    // Only the ID -> value side is ready; the value -> ID index follows in the background
+    startHashIndexBuild();
+}
+
+void DictionaryCodec::saveSnapshot(const std::string& filename) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    writeSnapshot(filename);
+}
+
+void DictionaryCodec::writeSnapshot(const std::string& filename) const {
+    static_assert(sizeof(size_t) == sizeof(uint64_t), "Snapshot frequencies are stored as uint64_t");
+    SnapshotHeader header = planSnapshot(encoded_data.size(), valueCount(), value_bytes.size(), original_bytes);
+    
+    std::vector<uint32_t> slots(header.hash_slots, 0);
+    for (uint32_t id = 0; id < header.dict_size; id++) {
+        insertSnapshotHash(slots, valueAt(id), id);
+    }
+    
+    const uint32_t empty_offsets[1] = {0};
+    std::vector<size_t> frequencies(header.dict_size, 0);
+    std::copy_n(id_frequencies.begin(), std::min(id_frequencies.size(), frequencies.size()), frequencies.begin());
     
-    for (size_t i = 0; i < dict_size; i++) {
-        size_t str_len;
-        file.read(reinterpret_cast<char*>(&str_len), sizeof(str_len));
+    std::pair<const SnapshotSection*, const void*> payloads[] = {
+        {&header.value_offsets, value_offsets.empty() ? empty_offsets : value_offsets.data()},
+        {&header.value_bytes, value_bytes.data()},
+        {&header.hash_index, slots.data()},
+        {&header.frequencies, frequencies.data()},
+        {&header.ids, encoded_data.data()},
+    };
+    
+    std::string temp_file = uniqueTempFile(filename);
+    {
+        std::ofstream file(temp_file, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            throw std::runtime_error("Failed to open snapshot file: " + temp_file);
+        }
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        size_t written = sizeof(header);
+        for (const auto& [section, data] : payloads) {
+            padSnapshot(file, written, *section);
+            file.write(static_cast<const char*>(data), section->length);
+            written += section->length;
+        }
+        if (!file) {
+            throw std::runtime_error("Failed to write snapshot file: " + temp_file);
+        }
+    }
+    commitSnapshot(temp_file, filename);
+}
+
+std::future<void> DictionaryCodec::saveStateAsync(const std::string& directory) const {
+    std::filesystem::create_directories(directory);
+    std::function<void()> write;
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        write = captureState(directory);
+    }
+    return std::async(std::launch::async, std::move(write));
+}
+
+std::function<void()> DictionaryCodec::captureState(const std::string& directory) const {
+    static_assert(sizeof(size_t) == sizeof(uint64_t), "Snapshot frequencies are stored as uint64_t");
+    
+    // Point-in-time view: rows and values are append-only, so their counts pin them;
+    // frequencies, byte totals and the metadata figures are taken while they still match
+    size_t count = valueCount();
+    SnapshotHeader header = planSnapshot(encoded_data.size(), count, count > 0 ? value_offsets[count] : 0,
+                                         original_bytes);
+    std::vector<size_t> frequencies(count, 0);
+    std::copy_n(id_frequencies.begin(), std::min(id_frequencies.size(), count), frequencies.begin());
+    size_t epoch = column_epoch;
+    double compression_ratio = compressionRatio();
+    size_t memory_usage = getMemoryUsage();
+    
+    return [this, directory, header, frequencies = std::move(frequencies), epoch, compression_ratio, memory_usage] {
+        std::string filename = directory + "/snapshot.bin";
+        std::string temp_file = uniqueTempFile(filename);
+        size_t dict_size = header.dict_size;
+        size_t num_rows = header.num_rows;
+        
+        // Each block is copied under a brief shared lock, then written without it
+        auto copyLocked = [this, epoch, &filename](auto&& copy) {
+            std::shared_lock<std::shared_mutex> lock(mutex);
+            if (column_epoch != epoch) {
+                throw std::runtime_error("Rows were rewritten during the online snapshot of " + filename);
+            }
+            copy();
+        };
         
-        std::string str(str_len, '\0');
-        file.read(&str[0], str_len);
+        try {
+            std::ofstream file(temp_file, std::ios::binary | std::ios::trunc);
+            if (!file) {
+                throw std::runtime_error("Failed to open snapshot file: " + temp_file);
+            }
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            size_t written = sizeof(header);
+            
+            std::vector<uint32_t> offsets;
+            padSnapshot(file, written, header.value_offsets);
+            for (size_t first = 0; first <= dict_size; first += SNAPSHOT_BLOCK) {
+                size_t last = std::min(dict_size + 1, first + SNAPSHOT_BLOCK);
+                offsets.assign(last - first, 0);
+                copyLocked([&] {
+                    if (!value_offsets.empty()) {
+                        std::copy(value_offsets.begin() + first, value_offsets.begin() + last, offsets.begin());
+                    }
+                });
+                file.write(reinterpret_cast<const char*>(offsets.data()), offsets.size() * sizeof(uint32_t));
+            }
+            written += header.value_offsets.length;
+            
+            // The hash index is built from the same copies that go to the value section
+            std::vector<uint32_t> slots(header.hash_slots, 0);
+            std::vector<char> bytes;
+            padSnapshot(file, written, header.value_bytes);
+            for (size_t first = 0; first < dict_size; first += SNAPSHOT_BLOCK) {
+                size_t last = std::min(dict_size, first + SNAPSHOT_BLOCK);
+                copyLocked([&] {
+                    offsets.assign(value_offsets.begin() + first, value_offsets.begin() + last + 1);
+                    bytes.assign(value_bytes.begin() + offsets.front(), value_bytes.begin() + offsets.back());
+                });
+                for (size_t id = first; id < last; id++) {
+                    std::string_view value(bytes.data() + offsets[id - first] - offsets.front(),
+                                           offsets[id - first + 1] - offsets[id - first]);
+                    insertSnapshotHash(slots, value, static_cast<uint32_t>(id));
+                }
+                file.write(bytes.data(), bytes.size());
+            }
+            written += header.value_bytes.length;
+            
+            padSnapshot(file, written, header.hash_index);
+            file.write(reinterpret_cast<const char*>(slots.data()), header.hash_index.length);
+            written += header.hash_index.length;
+            padSnapshot(file, written, header.frequencies);
+            file.write(reinterpret_cast<const char*>(frequencies.data()), header.frequencies.length);
+            written += header.frequencies.length;
+            
+            std::vector<uint32_t> ids;
+            padSnapshot(file, written, header.ids);
+            for (size_t first = 0; first < num_rows; first += SNAPSHOT_BLOCK) {
+                size_t last = std::min(num_rows, first + SNAPSHOT_BLOCK);
+                copyLocked([&] { ids.assign(encoded_data.begin() + first, encoded_data.begin() + last); });
+                file.write(reinterpret_cast<const char*>(ids.data()), ids.size() * sizeof(uint32_t));
+            }
+            if (!file) {
+                throw std::runtime_error("Failed to write snapshot file: " + temp_file);
+            }
+        } catch (...) {
+            std::filesystem::remove(temp_file);
+            throw;
+        }
+        commitSnapshot(temp_file, filename);
         
-        uint32_t id;
-        file.read(reinterpret_cast<char*>(&id), sizeof(id));
+        writeStateMetadata(directory + "/metadata.txt", dict_size, num_rows, compression_ratio, memory_usage);
+    };
+}
+
+void DictionaryCodec::loadSnapshot(const std::string& filename) {
+    std::unique_lock<std::shared_mutex> write_lock(mutex);
+    rejectWhileLogging("loadSnapshot");
+    
+    // Validated in a mapping of its own and swapped in only once everything has checked
+    // out, so a truncated or corrupt file leaves the current state untouched
+    FileMapping mapping = mapFile(filename);
+    const char* base = static_cast<const char*>(mapping.data);
+    auto fail = [&mapping, &filename](const std::string& reason) {
+        unmapFile(mapping);
+        throw std::runtime_error("Invalid snapshot " + filename + ": " + reason);
+    };
+    
+    SnapshotHeader header;
+    if (mapping.size < sizeof(header)) {
+        fail("truncated header");
+    }
+    std::memcpy(&header, base, sizeof(header));
+    if (std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0) {
+        fail("bad magic");
+    }
+    if (header.version != SNAPSHOT_VERSION || header.header_size != sizeof(SnapshotHeader)) {
+        fail("unsupported version " + std::to_string(header.version));
+    }
+    // Every counted element takes at least a byte, which also keeps the size products below from overflowing
+    if (header.dict_size >= mapping.size || header.num_rows > mapping.size || header.hash_slots > mapping.size) {
+        fail("counts exceed file size");
+    }
+    if (header.hash_slots == 0 || (header.hash_slots & (header.hash_slots - 1)) != 0 ||
+        header.hash_slots < 2 * header.dict_size) {
+        fail("bad hash index size");
+    }
+    
+    auto checkSection = [&](const SnapshotSection& section, size_t expected_length) {
+        if (section.offset % SNAPSHOT_ALIGNMENT != 0 || section.length != expected_length ||
+            section.offset > mapping.size || section.length > mapping.size - section.offset) {
+            fail("section out of bounds");
+        }
+    };
+    checkSection(header.value_offsets, (header.dict_size + 1) * sizeof(uint32_t));
+    const uint32_t* offsets = reinterpret_cast<const uint32_t*>(base + header.value_offsets.offset);
+    // valueAt trusts the offsets, so every value must lie inside the bytes section
+    if (offsets[0] != 0) {
+        fail("bad value offsets");
+    }
+    for (size_t id = 0; id < header.dict_size; id++) {
+        if (offsets[id + 1] < offsets[id]) {
+            fail("bad value offsets");
+        }
+    }
+    checkSection(header.value_bytes, offsets[header.dict_size]);
+    checkSection(header.hash_index, header.hash_slots * sizeof(uint32_t));
+    // Lookups follow hash entries (ID + 1) straight into the arena, and probe until an
+    // empty slot, so entries must be in range and no more numerous than the values
+    const uint32_t* slots = reinterpret_cast<const uint32_t*>(base + header.hash_index.offset);
+    size_t used_slots = 0;
+    for (size_t slot = 0; slot < header.hash_slots; slot++) {
+        if (slots[slot] > header.dict_size) {
+            fail("bad hash index entry");
+        }
+        used_slots += slots[slot] != 0;
+    }
+    if (used_slots > header.dict_size) {
+        fail("bad hash index entry");
+    }
+    checkSection(header.frequencies, header.dict_size * sizeof(uint64_t));
+    checkSection(header.ids, header.num_rows * sizeof(uint32_t));
+    // Faults the column in once, sequentially, instead of trusting it to every query
+    if (!idsInRange(reinterpret_cast<const uint32_t*>(base + header.ids.offset), header.num_rows,
+                    header.dict_size)) {
+        fail("value ID out of range");
+    }
+    
+    column_epoch++;
+    releaseSnapshot();
+    mmap_fd = mapping.fd;
+    mmap_data = mapping.data;
+    mmap_size = mapping.size;
+    
+    // Point the column and arena at the mapping; pages are faulted in as queries touch them
+    value_offsets.view(offsets, header.dict_size + 1);
+    value_bytes.view(base + header.value_bytes.offset, header.value_bytes.length);
+    encoded_data.view(reinterpret_cast<const uint32_t*>(base + header.ids.offset), header.num_rows);
+    hash_index = slots;
+    hash_mask = header.hash_slots - 1;
+    
+    const uint64_t* frequencies = reinterpret_cast<const uint64_t*>(base + header.frequencies.offset);
+    id_frequencies.assign(frequencies, frequencies + header.dict_size);
+    original_bytes = header.original_bytes;
+    dictionary_bytes = header.value_bytes.length;
+    
+    dictionary.clear();
+    reverse_dictionary.clear();
+    original_data.clear();
+    prefix_memo.clear();
+    if (result_cache) {
+        result_cache->clear();
+    }
+    stats_version++;
+}
+
+void DictionaryCodec::saveArrowStream(const std::string& filename, const std::string& column_name) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    std::ofstream file(filename, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Failed to open file: " + filename);
+    }
+    // Buffers go out straight from the arena and column, mapped or owned
+    ArrowIpc::writeDictionaryStream(file, column_name,
+        ArrowIpc::DictionaryColumnView{value_offsets.data(), value_bytes.data(), valueCount(),
+                                       encoded_data.data(), encoded_data.size()});
+}
+
+void DictionaryCodec::loadArrowStream(const std::string& filename) {
+    std::unique_lock<std::shared_mutex> write_lock(mutex);
+    rejectWhileLogging("loadArrowStream");
+    
+    // Parsed and indexed in a mapping of its own, so a malformed stream, or one the codec
+    // cannot represent, leaves the current state untouched
+    FileMapping mapping = mapFile(filename);
+    ArrowIpc::DictionaryColumn column;
+    std::vector<uint32_t> table;
+    try {
+        column = ArrowIpc::readDictionaryStream(static_cast<const uint8_t*>(mapping.data), mapping.size);
         
-        dictionary[str] = id;
-        reverse_dictionary.push_back(str);  // Fixed the incomplete push_ to push_back
+        // Arrow allows repeated dictionary values, which the codec's value -> ID index
+        // cannot represent; building that index is what finds them
+        StringArenaView values{column.owned_offsets.empty() ? column.value_offsets : column.owned_offsets.data(),
+                               column.value_bytes};
+        table.assign(hashSlotsFor(column.dict_size), 0);
+        if (!fillHashIndex(values, column.dict_size, table, true)) {
+            throw std::runtime_error("Unsupported Arrow stream " + filename + ": dictionary values repeat");
+        }
+    } catch (...) {
+        unmapFile(mapping);
+        throw;
     }
     
-    // Read compressed encoded data
-    size_t comp_size;
-    file.read(reinterpret_cast<char*>(&comp_size), sizeof(comp_size));
+    column_epoch++;
+    releaseSnapshot();
+    mmap_fd = mapping.fd;
+    mmap_data = mapping.data;
+    mmap_size = mapping.size;
+    
+    // The value bytes always stay in the mapping; offsets and IDs do when their layout matches
+    if (column.owned_offsets.empty()) {
+        value_offsets.view(column.value_offsets, column.dict_size + 1);
+    } else {
+        value_offsets.assign(std::move(column.owned_offsets));
+    }
+    value_bytes.view(column.value_bytes, column.value_bytes_length);
+    if (column.owned_ids.empty()) {
+        encoded_data.view(column.ids, column.num_rows);
+    } else {
+        encoded_data.assign(std::move(column.owned_ids));
+    }
+    loaded_hash_index = std::move(table);
+    hash_index = loaded_hash_index.data();
+    hash_mask = loaded_hash_index.size() - 1;
+    
+    dictionary.clear();
+    reverse_dictionary.clear();
+    original_data.clear();
+    prefix_memo.clear();
+    if (result_cache) {
+        result_cache->clear();
+    }
+    dictionary_bytes = value_bytes.size();
+    rebuildFrequencies();
+}
+
+std::unordered_map<std::string, uint32_t> DictionaryCodec::getDictionary() const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    size_t count = valueCount();
+    std::unordered_map<std::string, uint32_t> values;
+    values.reserve(count);
+    for (uint32_t id = 0; id < count; id++) {
+        values.emplace(valueAt(id), id);
+    }
+    return values;
+}
+
+std::vector<std::string> DictionaryCodec::getReverseDictionary() const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    size_t count = valueCount();
+    std::vector<std::string> values;
+    values.reserve(count);
+    for (uint32_t id = 0; id < count; id++) {
+        values.emplace_back(valueAt(id));
+    }
+    return values;
+}
+
+void DictionaryCodec::materialize() {
+    std::unique_lock<std::shared_mutex> write_lock(mutex);
+    materializeSnapshot();
+}
+
+void DictionaryCodec::materializeSnapshot() {
+    if (hash_index_build.valid()) {
+        waitForHashIndex();
+        hash_index_build = std::shared_future<void>();
+        std::vector<uint32_t>().swap(loaded_hash_index);
+        hash_index = nullptr;
+        hash_mask = 0;
+        if (!mmap_data) {
+            // Loaded from a file: everything is owned already except the map
+            dictionary.clear();
+            dictionary.reserve(reverse_dictionary.size());
+            for (uint32_t id = 0; id < reverse_dictionary.size(); id++) {
+                dictionary.emplace(reverse_dictionary[id], id);
+            }
+            return;
+        }
+    }
+    if (!mmap_data) {
+        return;
+    }
+    
+    encoded_data.materialize();
+    value_offsets.materialize();
+    value_bytes.materialize();
+    
+    size_t count = valueCount();
+    dictionary.clear();
+    dictionary.reserve(count);
+    reverse_dictionary.clear();
+    reverse_dictionary.reserve(count);
+    for (uint32_t id = 0; id < count; id++) {
+        std::string value(valueAt(id));
+        dictionary.emplace(value, id);
+        reverse_dictionary.push_back(std::move(value));
+    }
     
-    std::vector<uint8_t> compressed_data(comp_size);
-    file.read(reinterpret_cast<char*>(compressed_data.data()), comp_size);
+    std::vector<uint32_t>().swap(loaded_hash_index);
+    hash_index = nullptr;
+    hash_mask = 0;
+    unmapFile();
+    stats_version++;
+}
+
+void DictionaryCodec::releaseSnapshot() {
+    if (hash_index_build.valid()) {
+        waitForHashIndex();
+        hash_index_build = std::shared_future<void>();
+        std::vector<uint32_t>().swap(loaded_hash_index);
+        hash_index = nullptr;
+        hash_mask = 0;
+    }
+    if (!mmap_data) {
+        return;
+    }
+    // Dropping the mapping empties the column, so the figures derived from it go too
+    encoded_data.clear();
+    value_offsets.clear();
+    value_bytes.clear();
+    id_frequencies.clear();
+    original_bytes = 0;
+    dictionary_bytes = 0;
+    std::vector<uint32_t>().swap(loaded_hash_index);
+    hash_index = nullptr;
+    hash_mask = 0;
+    unmapFile();
+    stats_version++;
+}
+
+size_t DictionaryCodec::hashSlotsFor(size_t count) {
+    size_t slots = 16;
+    while (slots < 2 * count) {
+        slots <<= 1;
+    }
+    return slots;
+}
+
+bool DictionaryCodec::fillHashIndex(StringArenaView values, size_t count, std::vector<uint32_t>& table,
+                                    bool check_distinct) {
+    size_t mask = table.size() - 1;
+    size_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+    size_t num_threads = std::max<size_t>(1, std::min(max_threads, count / MIN_IDS_PER_INDEX_THREAD));
+    size_t ids_per_thread = (count + num_threads - 1) / num_threads;
+    std::atomic<bool> distinct{true};
+    
+    // Workers claim slots with CAS over contiguous ID ranges. Equal values probe the same
+    // chain, so whichever lands later passes the other's slot, where the distinct check sees it
+    auto insertRange = [&](size_t t) {
+        size_t end = std::min(count, (t + 1) * ids_per_thread);
+        for (size_t id = t * ids_per_thread; id < end; id++) {
+            std::string_view value = values[id];
+            uint32_t entry = static_cast<uint32_t>(id + 1);
+            size_t slot = snapshotHash(value.data(), value.length()) & mask;
+            uint32_t expected = 0;
+            while (!__atomic_compare_exchange_n(&table[slot], &expected, entry, false,
+                                                __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                if (check_distinct && values[expected - 1] == value) {
+                    distinct.store(false, std::memory_order_relaxed);
+                }
+                slot = (slot + 1) & mask;
+                expected = 0;
+            }
+        }
+    };
     
-    // Decompress data
-    size_t decom_size = encoded_data.size() * sizeof(uint32_t);
-    encoded_data.resize(decom_size / sizeof(uint32_t));
-    decompressChunk(compressed_data.data(), comp_size, 
-                    reinterpret_cast<char*>(encoded_data.data()));
+    std::vector<std::thread> threads;
+    for (size_t t = 1; t < num_threads; t++) {
+        threads.emplace_back(insertRange, t);
+    }
+    insertRange(0);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    return distinct.load();
+}
+
+void DictionaryCodec::startHashIndexBuild() {
+    size_t count = valueCount();
+    loaded_hash_index.assign(hashSlotsFor(count), 0);
+    hash_index = loaded_hash_index.data();
+    hash_mask = loaded_hash_index.size() - 1;
+    
+    // The future's completion publishes the table to every waiting lookup
+    hash_index_build = std::async(std::launch::async, [this, count] {
+        fillHashIndex(valueArena(), count, loaded_hash_index, false);
+    }).share();
+}
+
+void DictionaryCodec::waitForHashIndex() const {
+    if (hash_index_build.valid()) {
+        hash_index_build.wait();
+    }
 }
+
 void DictionaryCodec::saveState(const std::string& directory) const {
     // Create directory if it doesn't exist
     std::filesystem::create_directories(directory);
     
-    // Save dictionary and encoded data
+    // Mappable snapshot, so loadState needs no parsing or decompression
+    size_t dict_size;
+    size_t num_rows;
+    double compression_ratio;
+    size_t memory_usage;
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        writeSnapshot(directory + "/snapshot.bin");
+        dict_size = valueCount();
+        num_rows = encoded_data.size();
+        compression_ratio = compressionRatio();
+        memory_usage = getMemoryUsage();
+    }
+    writeStateMetadata(directory + "/metadata.txt", dict_size, num_rows, compression_ratio, memory_usage);
+}
+
+void DictionaryCodec::loadState(const std::string& directory) {
+    std::string snapshot_file = directory + "/snapshot.bin";
     std::string dict_file = directory + "/dictionary.bin";
-    std::string data_file = directory + "/encoded_data.bin";
-    std::string metadata_file = directory + "/metadata.txt";
     
-    // Save dictionary and encoded data using existing method
-    saveToFile(dict_file);
+    std::string log_file = directory + "/wal.log";
+    
+    // The log being written describes the state we are about to replace
+    disableWriteAheadLog();
+    
+    if (std::filesystem::exists(snapshot_file)) {
+        loadSnapshot(snapshot_file);
+    } else {
+        // States saved before snapshots existed
+        if (!std::filesystem::exists(dict_file)) {
+            throw std::runtime_error("No saved state found in directory: " + directory);
+        }
+        loadFromFile(dict_file);
+    }
     
-    // Save metadata
-    std::ofstream meta(metadata_file);
-    meta << "Dictionary size: " << dictionary.size() << "\n";
-    meta << "Encoded data size: " << encoded_data.size() << "\n";
-    meta << "Compression ratio: " << getCompressionRatio() << "\n";
-    meta << "Memory usage (MB): " << getMemoryUsage() / (1024.0 * 1024.0) << "\n";
+    // Appends made since the last checkpoint; a mapped snapshot stays mapped if none are left
+    std::unique_lock<std::shared_mutex> write_lock(mutex);
+    WriteAheadLog::replay(log_file, [this](const AppendRecord& record) { applyAppendRecord(record); });
 }
 
-void DictionaryCodec::loadState(const std::string& directory) {
-    std::string dict_file = directory + "/dictionary.bin";
+void DictionaryCodec::enableWriteAheadLog(const std::string& directory, size_t checkpoint_bytes) {
+    disableWriteAheadLog();
+    std::filesystem::create_directories(directory);
     
-    if (!std::filesystem::exists(dict_file)) {
-        throw std::runtime_error("No saved state found in directory: " + directory);
+    // The log continues a snapshot of exactly the state captured here. Appends are logged
+    // from the capture on, but not acknowledged until the snapshot is on disk. The new log
+    // is written beside wal.log and replaces it only after that, so a failed or interrupted
+    // snapshot leaves the previous snapshot and log, appends included, to recover from
+    std::unique_lock<std::mutex> checkpoint_guard(checkpoint_mutex);
+    std::string log_file = directory + "/wal.log";
+    std::string new_log_file = log_file + ".new";
+    std::shared_ptr<WriteAheadLog> log;
+    std::function<void()> write;
+    {
+        std::unique_lock<std::shared_mutex> write_lock(mutex);
+        write = captureState(directory);
+        std::filesystem::remove(new_log_file);
+        log = std::make_shared<WriteAheadLog>(new_log_file, checkpoint_bytes, [this] { checkpoint(); });
+        log->holdAcknowledgements();
+        wal = log;
+        wal_directory = directory;
     }
     
-    loadFromFile(dict_file);
+    try {
+        // Until the rename, a crash recovers the new snapshot plus the old log, whose
+        // records the snapshot already holds and replay skips
+        write();
+        log->renameTo(log_file);
+    } catch (...) {
+        log->abort();
+        checkpoint_guard.unlock();
+        {
+            std::unique_lock<std::shared_mutex> write_lock(mutex);
+            if (wal == log) {
+                wal.reset();
+                wal_directory.clear();
+            }
+        }
+        log->close();
+        std::filesystem::remove(new_log_file);
+        throw;
+    }
+    log->releaseAcknowledgements();
+}
+
+void DictionaryCodec::disableWriteAheadLog() {
+    std::shared_ptr<WriteAheadLog> log;
+    {
+        std::unique_lock<std::shared_mutex> write_lock(mutex);
+        log.swap(wal);
+        wal_directory.clear();
+    }
+    // Outside the lock: closing joins the checkpoint thread, which may be waiting for it
+    if (log) {
+        log->close();
+    }
+}
+
+void DictionaryCodec::checkpoint() {
+    // One checkpoint at a time, so snapshots and log cuts land in capture order
+    std::lock_guard<std::mutex> checkpoint_guard(checkpoint_mutex);
+    std::shared_ptr<WriteAheadLog> log;
+    uint64_t position;
+    std::function<void()> write;
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        if (!wal) {
+            return;
+        }
+        // Appends log under the exclusive lock, so the capture holds exactly the records before position
+        log = wal;
+        position = wal->getPosition();
+        write = captureState(wal_directory);
+    }
+    // Written block by block like saveStateAsync, so appends and queries continue meanwhile
+    write();
+    log->truncateBefore(position);
 }
 
-void DictionaryCodec::saveResults(const std::string& directory, const std::string& test_name) const {
+void DictionaryCodec::saveResults(const std::string& directory, const std::string& test_name,
+                                  int num_threads) const {
     std::filesystem::create_directories(directory);
     
     std::string results_file = directory + "/" + test_name + "_results.csv";
-    std::ofstream file(results_file);
-    
-    // Write header
+    std::ofstream file(results_file, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Failed to open file: " + results_file);
+    }
     file << "Index,Original,Encoded,Dictionary_ID\n";
     
-    // Write data
-    for (size_t i = 0; i < encoded_data.size(); i++) {
-        if (i < original_data.size()) {
-            file << i << ","
-                 << original_data[i] << ","
-                 << encoded_data[i] << ","
-                 << dictionary.at(original_data[i]) << "\n";
+    // Everything after the index depends only on the ID, so each distinct
+    // ",value,id,id\n" tail is formatted once and rows just copy theirs. The tails, a
+    // copy of the IDs and the summary figures are taken under the lock; the export
+    // itself runs without it, so appends do not wait for the disk
+    std::string tails;
+    std::vector<size_t> tail_offsets;
+    std::vector<uint32_t> ids;
+    size_t num_rows;
+    size_t dict_size;
+    double compression_ratio;
+    size_t memory_usage;
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        num_rows = encoded_data.size();
+        dict_size = valueCount();
+        compression_ratio = compressionRatio();
+        memory_usage = getMemoryUsage();
+        ids.assign(encoded_data.begin(), encoded_data.end());
+        
+        tail_offsets.assign(dict_size + 1, 0);
+        char number[20];
+        for (uint32_t id = 0; id < dict_size; id++) {
+            char* end = writeDecimal(number, id);
+            tails.push_back(',');
+            appendCsvField(tails, valueAt(id));
+            tails.push_back(',');
+            tails.append(number, end);
+            tails.push_back(',');
+            tails.append(number, end);
+            tails.push_back('\n');
+            tail_offsets[id + 1] = tails.size();
+        }
+    }
+    
+    // Worker t formats chunks t, t + T, ... into its own buffer, and the calling thread
+    // writes the buffers in chunk order, so formatting overlaps with the writes
+    size_t chunk_count = (num_rows + EXPORT_CHUNK_ROWS - 1) / EXPORT_CHUNK_ROWS;
+    size_t max_threads = num_threads > 0 ? num_threads : std::max(1u, std::thread::hardware_concurrency());
+    size_t thread_count = std::max<size_t>(1, std::min(max_threads, chunk_count));
+    std::vector<std::vector<char>> buffers(thread_count);
+    std::vector<size_t> lengths(thread_count, 0);
+    std::vector<bool> ready(thread_count, false);
+    bool failed = false;
+    std::mutex export_mutex;
+    std::condition_variable export_cv;
+    
+    auto formatChunks = [&](size_t t) {
+        for (size_t chunk = t; chunk < chunk_count; chunk += thread_count) {
+            {
+                std::unique_lock<std::mutex> guard(export_mutex);
+                export_cv.wait(guard, [&] { return !ready[t] || failed; });
+                if (failed) {
+                    return;
+                }
+            }
+            std::vector<char>& buffer = buffers[t];
+            size_t start = chunk * EXPORT_CHUNK_ROWS;
+            size_t end = std::min(num_rows, start + EXPORT_CHUNK_ROWS);
+            size_t length = 0;
+            for (size_t row = start; row < end; row++) {
+                uint32_t id = ids[row];
+                size_t tail_length = tail_offsets[id + 1] - tail_offsets[id];
+                if (buffer.size() - length < 20 + tail_length) {
+                    buffer.resize(std::max(2 * buffer.size(), length + 20 + tail_length + (1 << 16)));
+                }
+                length = writeDecimal(buffer.data() + length, row) - buffer.data();
+                std::memcpy(buffer.data() + length, tails.data() + tail_offsets[id], tail_length);
+                length += tail_length;
+            }
+            {
+                std::lock_guard<std::mutex> guard(export_mutex);
+                lengths[t] = length;
+                ready[t] = true;
+            }
+            export_cv.notify_all();
         }
+    };
+    
+    std::vector<std::thread> threads;
+    threads.reserve(thread_count);
+    for (size_t t = 0; t < thread_count; t++) {
+        threads.emplace_back(formatChunks, t);
+    }
+    for (size_t chunk = 0; chunk < chunk_count && !failed; chunk++) {
+        size_t t = chunk % thread_count;
+        std::unique_lock<std::mutex> guard(export_mutex);
+        export_cv.wait(guard, [&] { return ready[t]; });
+        guard.unlock();
+        
+        file.write(buffers[t].data(), lengths[t]);
+        
+        guard.lock();
+        failed = !file;
+        ready[t] = false;
+        guard.unlock();
+        export_cv.notify_all();
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    file.close();
+    if (failed || !file) {
+        throw std::runtime_error("Failed to write file: " + results_file);
     }
     
     // Save summary
@@ -681,9 +2468,9 @@ void DictionaryCodec::saveResults(const std::string& directory, const std::strin
     std::ofstream summary(summary_file);
     summary << "Test Summary: " << test_name << "\n"
            << "-------------------\n"
-           << "Total entries: " << encoded_data.size() << "\n"
-           << "Dictionary size: " << dictionary.size() << "\n"
-           << "Compression ratio: " << getCompressionRatio() << "\n"
-           << "Memory usage (MB): " << getMemoryUsage() / (1024.0 * 1024.0) << "\n";
+           << "Total entries: " << num_rows << "\n"
+           << "Dictionary size: " << dict_size << "\n"
+           << "Compression ratio: " << compression_ratio << "\n"
+           << "Memory usage (MB): " << memory_usage / (1024.0 * 1024.0) << "\n";
 }
 
@@ -0,0 +1,100 @@
+#include "prefix_memo.h"
+
+PrefixMemo::PrefixMemo(size_t max_ids) : memoized_ids(0), charged(0), max_ids(max_ids) {}
+
+std::shared_ptr<const std::vector<uint32_t>> PrefixMemo::findClosest(
+    const std::string& prefix, size_t& matched_length) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::shared_ptr<const std::vector<uint32_t>> closest;
+    matched_length = 0;
+
+    const Node* node = &root;
+    for (size_t depth = 0; depth < prefix.length(); depth++) {
+        auto it = node->children.find(prefix[depth]);
+        if (it == node->children.end()) {
+            break;
+        }
+        node = it->second.get();
+        if (node->ids) {
+            closest = node->ids;
+            matched_length = depth + 1;
+        }
+    }
+    return closest;
+}
+
+void PrefixMemo::store(const std::string& prefix, const std::vector<uint32_t>& ids) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (prefix.empty() || ids.empty()) {
+        return;
+    }
+
+    // Nodes already on the path cost nothing
+    const Node* existing = &root;
+    size_t depth = 0;
+    for (; depth < prefix.length(); depth++) {
+        auto it = existing->children.find(prefix[depth]);
+        if (it == existing->children.end()) {
+            break;
+        }
+        existing = it->second.get();
+    }
+    if (depth == prefix.length() && existing->ids) {
+        return;
+    }
+    size_t cost = ids.size() + (prefix.length() - depth) * NODE_COST;
+
+    // Over budget: start over rather than track per-node recency
+    if (charged + cost > max_ids) {
+        cost = ids.size() + prefix.length() * NODE_COST;
+        if (cost > max_ids) {
+            return;
+        }
+        root.children.clear();
+        memoized_ids = 0;
+        charged = 0;
+    }
+
+    Node* node = &root;
+    for (char c : prefix) {
+        auto& child = node->children[c];
+        if (!child) {
+            child = std::make_unique<Node>();
+        }
+        node = child.get();
+    }
+    node->ids = std::make_shared<std::vector<uint32_t>>(ids);
+    memoized_ids += ids.size();
+    charged += cost;
+}
+
+void PrefixMemo::addEntry(const std::string& value, uint32_t id) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // IDs are assigned in increasing order, so appending keeps every set sorted
+    Node* node = &root;
+    for (char c : value) {
+        auto it = node->children.find(c);
+        if (it == node->children.end()) {
+            return;
+        }
+        node = it->second.get();
+        if (node->ids) {
+            node->ids->push_back(id);
+            memoized_ids++;
+            charged++;
+        }
+    }
+}
+
+void PrefixMemo::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    root.children.clear();
+    memoized_ids = 0;
+    charged = 0;
+}
+
+size_t PrefixMemo::getMemoizedIds() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return memoized_ids;
+}
@@ -0,0 +1,271 @@
+#include "query_executor.h"
+#include "scan_kernels.h"
+#include <algorithm>
+
+CancellationToken::CancellationToken()
+    : CancellationToken(std::chrono::steady_clock::time_point::max()) {}
+
+CancellationToken::CancellationToken(std::chrono::steady_clock::time_point deadline)
+    : state(std::make_shared<State>()) {
+    state->deadline = deadline;
+}
+
+CancellationToken CancellationToken::withTimeout(std::chrono::steady_clock::duration timeout) {
+    return CancellationToken(std::chrono::steady_clock::now() + timeout);
+}
+
+void CancellationToken::throwIfStopped() const {
+    if (isCancelled()) {
+        throw QueryCancelled("Query cancelled");
+    }
+    if (isExpired()) {
+        throw QueryCancelled("Query deadline exceeded");
+    }
+}
+
+QueryExecutor::QueryExecutor(const DictionaryCodec& codec, int num_threads)
+    : codec(codec), stopping(false) {
+    size_t count = num_threads > 0 ? num_threads : std::max(1u, std::thread::hardware_concurrency());
+    // Keep a worker free for short queries whenever there is more than one
+    stateOf(QueryClass::Short).max_running = count;
+    stateOf(QueryClass::Long).max_running = std::max<size_t>(1, count - 1);
+    
+    workers.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        workers.emplace_back(&QueryExecutor::workerLoop, this);
+    }
+}
+
+QueryExecutor::~QueryExecutor() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    tasks_cv.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+bool QueryExecutor::canDispatch(const ClassState& state) const {
+    return !state.queue.empty() && state.running < state.max_running;
+}
+
+void QueryExecutor::workerLoop() {
+    ClassState& short_state = stateOf(QueryClass::Short);
+    ClassState& long_state = stateOf(QueryClass::Long);
+    
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        tasks_cv.wait(lock, [&] {
+            return canDispatch(short_state) || canDispatch(long_state) ||
+                   (stopping && short_state.queue.empty() && long_state.queue.empty());
+        });
+        
+        // Short queries always go first
+        ClassState* state = canDispatch(short_state) ? &short_state
+                          : canDispatch(long_state) ? &long_state : nullptr;
+        if (!state) {
+            return;
+        }
+        Task task = std::move(state->queue.front());
+        state->queue.pop_front();
+        state->running++;
+        
+        lock.unlock();
+        bool finished = task.step();
+        lock.lock();
+        
+        state->running--;
+        if (!finished) {
+            // Yield at the slice boundary; anything queued meanwhile runs first
+            state->queue.push_back(std::move(task));
+        }
+        tasks_cv.notify_all();
+    }
+}
+
+bool QueryExecutor::enqueue(Task task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ClassState& state = stateOf(task.query_class);
+        if (state.queue.size() >= state.max_queued) {
+            return false;
+        }
+        state.queue.push_back(std::move(task));
+    }
+    tasks_cv.notify_all();
+    return true;
+}
+
+QueryClass QueryExecutor::classify(size_t rows, size_t id_count, size_t matches) const {
+    // Equality-scan row units: every row is tested once, every match is emitted once
+    size_t cost = rows * (id_count > 1 ? BITMAP_ROW_COST : 1) + matches * MATCH_COST;
+    return cost <= SHORT_COST_LIMIT ? QueryClass::Short : QueryClass::Long;
+}
+
+template <typename Result>
+std::future<Result> QueryExecutor::submitCount(std::function<Result()> count,
+                                               const CancellationToken& token) {
+    // Counts are served from the frequency table, so they are always short
+    auto promise = std::make_shared<std::promise<Result>>();
+    std::future<Result> result = promise->get_future();
+    Task task{QueryClass::Short, [promise, count = std::move(count), token] {
+        try {
+            token.throwIfStopped();
+            promise->set_value(count());
+        } catch (...) {
+            promise->set_exception(std::current_exception());
+        }
+        return true;
+    }};
+    if (!enqueue(std::move(task))) {
+        promise->set_exception(std::make_exception_ptr(QueryRejected("Short query queue is full")));
+    }
+    return result;
+}
+
+void QueryExecutor::scanSlice(const std::vector<uint32_t>& ids, const std::vector<uint32_t>& bitmap,
+                              size_t epoch, size_t begin, size_t end, std::vector<uint32_t>& positions) const {
+    std::shared_lock<std::shared_mutex> lock(codec.mutex);
+    // The IDs and bitmap describe the rows as they were when the query was planned
+    if (codec.column_epoch != epoch) {
+        throw std::runtime_error("Column was rewritten during the query");
+    }
+    auto emit = [&positions](size_t row) { positions.push_back(row); return true; };
+    if (ids.size() == 1) {
+        ScanKernels::forEachEqual(codec.encoded_data.data(), begin, end, ids[0], emit);
+    } else {
+        ScanKernels::forEachInBitmap(codec.encoded_data.data(), begin, end, bitmap.data(), emit);
+    }
+}
+
+std::future<std::vector<uint32_t>> QueryExecutor::submitScan(
+    const CancellationToken& token, std::function<void(std::vector<uint32_t>&)> resolve_ids) {
+    struct ScanState {
+        std::promise<std::vector<uint32_t>> promise;
+        std::vector<uint32_t> ids;
+        std::vector<uint32_t> bitmap;
+        size_t epoch = 0;
+        std::vector<uint32_t> positions;
+        size_t next_row = 0;
+        size_t total_rows = 0;
+    };
+    auto scan = std::make_shared<ScanState>();
+    std::future<std::vector<uint32_t>> result = scan->promise.get_future();
+    
+    // Runs slices until the window is done; a yielding step stops after one slice
+    auto step = [this, scan, token](bool yield) {
+        try {
+            do {
+                token.throwIfStopped();
+                if (scan->next_row < scan->total_rows) {
+                    size_t end = std::min(scan->next_row + SLICE_ROWS, scan->total_rows);
+                    scanSlice(scan->ids, scan->bitmap, scan->epoch, scan->next_row, end, scan->positions);
+                    scan->next_row = end;
+                }
+            } while (!yield && scan->next_row < scan->total_rows);
+            
+            if (scan->next_row < scan->total_rows) {
+                return false;
+            }
+            scan->promise.set_value(std::move(scan->positions));
+        } catch (...) {
+            scan->promise.set_exception(std::current_exception());
+        }
+        return true;
+    };
+    
+    // Resolving the IDs may wait for the dictionary index, so it runs on a worker too;
+    // the IDs and bitmap are resolved once and shared by all of the query's slices
+    Task plan{QueryClass::Short, [this, scan, resolve_ids = std::move(resolve_ids), step, token] {
+        size_t matches = 0;
+        try {
+            token.throwIfStopped();
+            std::shared_lock<std::shared_mutex> lock(codec.mutex);
+            resolve_ids(scan->ids);
+            for (uint32_t id : scan->ids) {
+                matches += codec.id_frequencies[id];
+            }
+            if (scan->ids.size() > 1) {
+                codec.buildIdBitmap(scan->ids, scan->bitmap);
+            }
+            // Rows appended after planning are outside the query's window. The row count
+            // is read with the epoch, so a reload can't pair a shorter column with it
+            scan->epoch = codec.column_epoch;
+            scan->total_rows = codec.encoded_data.size();
+        } catch (...) {
+            scan->promise.set_exception(std::current_exception());
+            return true;
+        }
+        if (scan->ids.empty()) {
+            scan->promise.set_value({});
+            return true;
+        }
+        
+        // Short scans finish in this turn; long scans requeue and yield after each slice
+        if (classify(scan->total_rows, scan->ids.size(), matches) == QueryClass::Short) {
+            return step(false);
+        }
+        if (!enqueue(Task{QueryClass::Long, [step] { return step(true); }})) {
+            scan->promise.set_exception(std::make_exception_ptr(QueryRejected("Long query queue is full")));
+        }
+        return true;
+    }};
+    if (!enqueue(std::move(plan))) {
+        scan->promise.set_exception(std::make_exception_ptr(QueryRejected("Short query queue is full")));
+    }
+    return result;
+}
+
+std::future<std::vector<uint32_t>> QueryExecutor::findMatchesAsync(const std::string& target,
+                                                                   CancellationToken token) {
+    return submitScan(token, [this, target](std::vector<uint32_t>& ids) {
+        uint32_t id;
+        if (codec.lookupId(target, id)) {
+            ids.push_back(id);
+        }
+    });
+}
+
+std::future<std::vector<uint32_t>> QueryExecutor::prefixSearchAsync(const std::string& prefix,
+                                                                    CancellationToken token) {
+    return submitScan(token, [this, prefix](std::vector<uint32_t>& ids) {
+        if (!prefix.empty()) {
+            codec.collectPrefixIds(prefix, ids);
+        }
+    });
+}
+
+std::future<size_t> QueryExecutor::countMatchesAsync(const std::string& target, CancellationToken token) {
+    return submitCount<size_t>([this, target] { return codec.countMatches(target); }, token);
+}
+
+std::future<size_t> QueryExecutor::countPrefixAsync(const std::string& prefix, CancellationToken token) {
+    return submitCount<size_t>([this, prefix] { return codec.countPrefix(prefix); }, token);
+}
+
+void QueryExecutor::setClassLimits(QueryClass query_class, size_t max_running, size_t max_queued) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ClassState& state = stateOf(query_class);
+        state.max_running = std::max<size_t>(1, max_running);
+        state.max_queued = max_queued;
+    }
+    tasks_cv.notify_all();
+}
+
+size_t QueryExecutor::getQueuedCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return classes[0].queue.size() + classes[1].queue.size();
+}
+
+size_t QueryExecutor::getQueuedCount(QueryClass query_class) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return classes[static_cast<size_t>(query_class)].queue.size();
+}
+
+size_t QueryExecutor::getRunningCount(QueryClass query_class) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return classes[static_cast<size_t>(query_class)].running;
+}
@@ -0,0 +1,139 @@
+#include "result_cache.h"
+
+size_t QueryKeyHash::operator()(const QueryKey& key) const {
+    // FNV-1a over the window and the ID set
+    uint64_t hash = 1469598103934665603ull;
+    auto mix = [&hash](uint64_t value) {
+        hash ^= value;
+        hash *= 1099511628211ull;
+    };
+    mix(key.begin_row);
+    mix(key.end_row);
+    for (uint32_t id : key.ids) {
+        mix(id);
+    }
+    return static_cast<size_t>(hash);
+}
+
+ResultCache::ResultCache(size_t max_bytes)
+    : clock_hand(0), max_bytes(max_bytes), used_bytes(0), hits(0), misses(0) {}
+
+size_t ResultCache::entryBytes(const QueryKey& key, const ResultSet& result) {
+    return sizeof(Entry) + key.ids.size() * sizeof(uint32_t) + result.getMemoryUsage();
+}
+
+std::shared_ptr<const ResultSet> ResultCache::lookup(const QueryKey& key, size_t& rows_covered) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = index.find(key);
+    if (it == index.end()) {
+        misses++;
+        return nullptr;
+    }
+
+    Entry& entry = slots[it->second];
+    entry.referenced = true;
+    rows_covered = entry.rows_covered;
+    hits++;
+    return entry.result;
+}
+
+void ResultCache::insert(const QueryKey& key, std::shared_ptr<const ResultSet> result,
+                         size_t rows_covered) {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t bytes = entryBytes(key, *result);
+    if (bytes > max_bytes) {
+        return;
+    }
+
+    // A racing query may already have stored a result covering more rows
+    auto it = index.find(key);
+    if (it != index.end()) {
+        if (slots[it->second].rows_covered > rows_covered) {
+            return;
+        }
+        removeSlot(it->second);
+    }
+
+    evictUntilFits(bytes);
+
+    size_t slot;
+    if (!free_slots.empty()) {
+        slot = free_slots.back();
+        free_slots.pop_back();
+    } else {
+        slot = slots.size();
+        slots.emplace_back();
+    }
+    slots[slot] = Entry{key, std::move(result), rows_covered, bytes, true, true};
+    index.emplace(key, slot);
+    used_bytes += bytes;
+}
+
+bool ResultCache::detachIfUnshared(const QueryKey& key, const std::shared_ptr<const ResultSet>& result) {
+    // New references are only handed out under this mutex, so the count cannot grow meanwhile
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = index.find(key);
+    if (it == index.end() || slots[it->second].result != result) {
+        return result.use_count() == 1;
+    }
+    if (result.use_count() != 2) {
+        return false;
+    }
+    removeSlot(it->second);
+    return true;
+}
+
+void ResultCache::evictUntilFits(size_t incoming_bytes) {
+    // Sweep the hand, giving referenced entries a second chance
+    while (used_bytes + incoming_bytes > max_bytes && !index.empty()) {
+        if (clock_hand >= slots.size()) {
+            clock_hand = 0;
+        }
+        Entry& entry = slots[clock_hand];
+        if (entry.occupied) {
+            if (entry.referenced) {
+                entry.referenced = false;
+            } else {
+                removeSlot(clock_hand);
+            }
+        }
+        clock_hand++;
+    }
+}
+
+void ResultCache::removeSlot(size_t slot) {
+    Entry& entry = slots[slot];
+    index.erase(entry.key);
+    used_bytes -= entry.bytes;
+    entry = Entry{};
+    free_slots.push_back(slot);
+}
+
+void ResultCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    slots.clear();
+    free_slots.clear();
+    index.clear();
+    clock_hand = 0;
+    used_bytes = 0;
+}
+
+size_t ResultCache::getUsedBytes() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return used_bytes;
+}
+
+size_t ResultCache::getEntryCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return index.size();
+}
+
+size_t ResultCache::getHits() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return hits;
+}
+
+size_t ResultCache::getMisses() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return misses;
+}
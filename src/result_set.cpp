@@ -0,0 +1,355 @@
+#include "result_set.h"
+#include <immintrin.h>
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+
+namespace {
+
+    size_t varintLength(size_t value) {
+        size_t bytes = 1;
+        while (value >= 0x80) {
+            value >>= 7;
+            bytes++;
+        }
+        return bytes;
+    }
+
+    // For every byte value, the indices of its set bits padded to 8 lanes
+    struct BitPositionTable {
+        alignas(32) std::array<std::array<uint32_t, 8>, 256> lanes;
+
+        BitPositionTable() {
+            for (uint32_t byte = 0; byte < 256; byte++) {
+                uint32_t n = 0;
+                for (uint32_t bit = 0; bit < 8; bit++) {
+                    if (byte & (1u << bit)) {
+                        lanes[byte][n++] = bit;
+                    }
+                }
+                for (; n < 8; n++) {
+                    lanes[byte][n] = 0;
+                }
+            }
+        }
+    };
+
+    const BitPositionTable& bitPositionTable() {
+        static const BitPositionTable table;
+        return table;
+    }
+
+} // namespace
+
+ResultSet::ResultSet()
+    : encoding(ResultEncoding::Positions), num_rows(0), count(0), last_position(0) {}
+
+ResultSet::ResultSet(const std::vector<uint32_t>& sorted_positions, size_t num_rows)
+    : ResultSet(sorted_positions, num_rows, chooseEncoding(sorted_positions.size(), num_rows)) {}
+
+ResultSet::ResultSet(const std::vector<uint32_t>& sorted_positions, size_t num_rows,
+                     ResultEncoding encoding)
+    : encoding(encoding), num_rows(num_rows), count(sorted_positions.size()),
+      last_position(sorted_positions.empty() ? 0 : sorted_positions.back()) {
+    if (!sorted_positions.empty() && last_position >= num_rows) {
+        throw std::out_of_range("Result position past end of column");
+    }
+
+    switch (encoding) {
+        case ResultEncoding::Positions:
+            positions = sorted_positions;
+            break;
+        case ResultEncoding::DeltaVarint:
+            ResultConversions::encodeDeltaVarint(sorted_positions.data(), count, 0, varint_data);
+            varint_data.shrink_to_fit();
+            break;
+        case ResultEncoding::Bitmap:
+            ResultConversions::positionsToBitmap(sorted_positions.data(), count, num_rows, bitmap);
+            break;
+    }
+}
+
+ResultSet::ResultSet(const std::vector<size_t>& sorted_positions, size_t num_rows)
+    : ResultSet([&sorted_positions]() {
+          std::vector<uint32_t> narrowed(sorted_positions.size());
+          ResultConversions::narrowPositions(sorted_positions.data(), sorted_positions.size(),
+                                             narrowed.data());
+          return narrowed;
+      }(), num_rows) {}
+
+ResultSet ResultSet::fromBitmap(std::vector<uint64_t> row_bitmap, size_t num_rows) {
+    ResultSet result;
+    result.num_rows = num_rows;
+    row_bitmap.resize((num_rows + 63) / 64, 0);
+    for (size_t w = 0; w < row_bitmap.size(); w++) {
+        result.count += _mm_popcnt_u64(row_bitmap[w]);
+        if (row_bitmap[w]) {
+            result.last_position = static_cast<uint32_t>(w * 64 + 63 - _lzcnt_u64(row_bitmap[w]));
+        }
+    }
+
+    ResultEncoding encoding = chooseEncoding(result.count, num_rows);
+    if (encoding == ResultEncoding::Bitmap) {
+        result.encoding = encoding;
+        result.bitmap = std::move(row_bitmap);
+        return result;
+    }
+    std::vector<uint32_t> sorted;
+    ResultConversions::bitmapToPositions(row_bitmap.data(), row_bitmap.size(), sorted);
+    return ResultSet(sorted, num_rows, encoding);
+}
+
+ResultEncoding ResultSet::chooseEncoding(size_t count, size_t num_rows) {
+    if (count == 0) {
+        return ResultEncoding::Positions;
+    }
+
+    size_t position_bytes = count * sizeof(uint32_t);
+    size_t bitmap_bytes = (num_rows + 63) / 64 * sizeof(uint64_t);
+    size_t varint_bytes = count * varintLength(num_rows / count);
+
+    if (bitmap_bytes <= position_bytes && bitmap_bytes <= varint_bytes) {
+        return ResultEncoding::Bitmap;
+    }
+    // Delta-varint pays a sequential decode, so it must save at least a quarter
+    if (varint_bytes * 4 <= position_bytes * 3) {
+        return ResultEncoding::DeltaVarint;
+    }
+    return ResultEncoding::Positions;
+}
+
+size_t ResultSet::getMemoryUsage() const {
+    return positions.capacity() * sizeof(uint32_t)
+         + varint_data.capacity()
+         + bitmap.capacity() * sizeof(uint64_t);
+}
+
+void ResultSet::append(const uint32_t* new_positions, size_t new_count, size_t new_num_rows) {
+    if (new_num_rows < num_rows) {
+        throw std::invalid_argument("Result column cannot shrink");
+    }
+    if (new_count > 0 && ((count > 0 && new_positions[0] <= last_position) ||
+                          new_positions[new_count - 1] >= new_num_rows)) {
+        throw std::invalid_argument("Appended positions must follow the existing ones");
+    }
+
+    switch (encoding) {
+        case ResultEncoding::Positions:
+            positions.insert(positions.end(), new_positions, new_positions + new_count);
+            break;
+        case ResultEncoding::DeltaVarint:
+            ResultConversions::encodeDeltaVarint(new_positions, new_count, last_position, varint_data);
+            break;
+        case ResultEncoding::Bitmap:
+            bitmap.resize((new_num_rows + 63) / 64, 0);
+            for (size_t i = 0; i < new_count; i++) {
+                bitmap[new_positions[i] >> 6] |= uint64_t(1) << (new_positions[i] & 63);
+            }
+            break;
+    }
+
+    num_rows = new_num_rows;
+    count += new_count;
+    if (new_count > 0) {
+        last_position = new_positions[new_count - 1];
+    }
+}
+
+void ResultSet::toPositions(std::vector<uint32_t>& out) const {
+    switch (encoding) {
+        case ResultEncoding::Positions:
+            out = positions;
+            break;
+        case ResultEncoding::DeltaVarint:
+            ResultConversions::decodeDeltaVarint(varint_data.data(), count, out);
+            break;
+        case ResultEncoding::Bitmap:
+            ResultConversions::bitmapToPositions(bitmap.data(), bitmap.size(), out);
+            break;
+    }
+}
+
+void ResultSet::toBitmap(std::vector<uint64_t>& out) const {
+    if (encoding == ResultEncoding::Bitmap) {
+        out = bitmap;
+        return;
+    }
+    std::vector<uint32_t> sorted;
+    toPositions(sorted);
+    ResultConversions::positionsToBitmap(sorted.data(), sorted.size(), num_rows, out);
+}
+
+ResultSet ResultSet::convertTo(ResultEncoding target) const {
+    if (target == encoding) {
+        return *this;
+    }
+    std::vector<uint32_t> sorted;
+    toPositions(sorted);
+    return ResultSet(sorted, num_rows, target);
+}
+
+bool ResultSet::contains(uint32_t row) const {
+    switch (encoding) {
+        case ResultEncoding::Positions:
+            return std::binary_search(positions.begin(), positions.end(), row);
+        case ResultEncoding::Bitmap:
+            return row < num_rows && ((bitmap[row >> 6] >> (row & 63)) & 1);
+        case ResultEncoding::DeltaVarint:
+            break;
+    }
+
+    // Gaps have to be walked in order
+    const uint8_t* data = varint_data.data();
+    uint32_t position = 0;
+    for (size_t i = 0; i < count; i++) {
+        uint32_t delta = 0;
+        for (int shift = 0;; shift += 7) {
+            uint8_t byte = *data++;
+            delta |= static_cast<uint32_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) {
+                break;
+            }
+        }
+        position += delta;
+        if (position >= row) {
+            return position == row;
+        }
+    }
+    return false;
+}
+
+namespace ResultConversions {
+
+    const uint32_t* setBitLanes(uint32_t byte) {
+        return bitPositionTable().lanes[byte].data();
+    }
+
+    void narrowPositions(const size_t* positions, size_t count, uint32_t* out) {
+        // Low halves of two 4 x 64-bit vectors packed into one 8 x 32-bit vector
+        const __m256i low_halves = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            __m256i lo = _mm256_permutevar8x32_epi32(
+                _mm256_loadu_si256((const __m256i*)(positions + i)), low_halves);
+            __m256i hi = _mm256_permutevar8x32_epi32(
+                _mm256_loadu_si256((const __m256i*)(positions + i + 4)), low_halves);
+            _mm256_storeu_si256((__m256i*)(out + i), _mm256_blend_epi32(lo, hi, 0xF0));
+        }
+        for (; i < count; i++) {
+            out[i] = static_cast<uint32_t>(positions[i]);
+        }
+    }
+
+    void bitmapToPositions(const uint64_t* words, size_t num_words, std::vector<uint32_t>& out) {
+        size_t total = 0;
+        for (size_t w = 0; w < num_words; w++) {
+            total += _mm_popcnt_u64(words[w]);
+        }
+
+        // Every byte stores a full 8-lane vector, so keep 8 lanes of slack at the end
+        out.resize(total + 8);
+        uint32_t* dst = out.data();
+
+        for (size_t w = 0; w < num_words; w++) {
+            uint64_t word = words[w];
+            for (uint32_t byte_index = 0; word != 0; byte_index++, word >>= 8) {
+                uint32_t byte = word & 0xFF;
+                if (byte == 0) {
+                    continue;
+                }
+                __m256i lanes = _mm256_load_si256((const __m256i*)setBitLanes(byte));
+                __m256i base = _mm256_set1_epi32(static_cast<uint32_t>(w * 64 + byte_index * 8));
+                _mm256_storeu_si256((__m256i*)dst, _mm256_add_epi32(lanes, base));
+                dst += _mm_popcnt_u32(byte);
+            }
+        }
+        out.resize(total);
+    }
+
+    void positionsToBitmap(const uint32_t* positions, size_t count, size_t num_rows,
+                           std::vector<uint64_t>& out) {
+        out.assign((num_rows + 63) / 64, 0);
+        for (size_t i = 0; i < count; i++) {
+            out[positions[i] >> 6] |= uint64_t(1) << (positions[i] & 63);
+        }
+    }
+
+    void encodeDeltaVarint(const uint32_t* positions, size_t count, uint32_t base,
+                           std::vector<uint8_t>& out) {
+        alignas(32) uint32_t deltas[8];
+        // Lane i of `previous` holds position i - 1; lane 0 is patched with the carry
+        const __m256i shift_up = _mm256_setr_epi32(0, 0, 1, 2, 3, 4, 5, 6);
+        __m256i carry = _mm256_set1_epi32(base);
+
+        auto writeVarint = [&out](uint32_t value) {
+            while (value >= 0x80) {
+                out.push_back(static_cast<uint8_t>(value | 0x80));
+                value >>= 7;
+            }
+            out.push_back(static_cast<uint8_t>(value));
+        };
+
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            __m256i current = _mm256_loadu_si256((const __m256i*)(positions + i));
+            __m256i previous = _mm256_blend_epi32(
+                _mm256_permutevar8x32_epi32(current, shift_up), carry, 0x01);
+            _mm256_store_si256((__m256i*)deltas, _mm256_sub_epi32(current, previous));
+            carry = _mm256_set1_epi32(positions[i + 7]);
+            for (uint32_t delta : deltas) {
+                writeVarint(delta);
+            }
+        }
+        uint32_t previous = i > 0 ? positions[i - 1] : base;
+        for (; i < count; i++) {
+            writeVarint(positions[i] - previous);
+            previous = positions[i];
+        }
+    }
+
+    void decodeDeltaVarint(const uint8_t* data, size_t count, std::vector<uint32_t>& out) {
+        out.resize(count);
+        uint32_t* dst = out.data();
+
+        // Unpack the gaps, with a fast path for the common one-byte case
+        for (size_t i = 0; i < count; i++) {
+            uint32_t byte = *data++;
+            if (byte < 0x80) {
+                dst[i] = byte;
+                continue;
+            }
+            uint32_t delta = byte & 0x7F;
+            for (int shift = 7;; shift += 7) {
+                byte = *data++;
+                delta |= (byte & 0x7F) << shift;
+                if (byte < 0x80) {
+                    break;
+                }
+            }
+            dst[i] = delta;
+        }
+
+        // Inclusive prefix sum, 8 lanes at a time: two in-lane shift-adds, then the
+        // low lane's total is carried into the high lane, then the running carry is added
+        __m256i carry = _mm256_setzero_si256();
+        const __m256i last_lane = _mm256_set1_epi32(7);
+        const __m256i low_total = _mm256_set1_epi32(3);
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            __m256i x = _mm256_loadu_si256((const __m256i*)(dst + i));
+            x = _mm256_add_epi32(x, _mm256_slli_si256(x, 4));
+            x = _mm256_add_epi32(x, _mm256_slli_si256(x, 8));
+            __m256i spill = _mm256_permutevar8x32_epi32(x, low_total);
+            x = _mm256_add_epi32(x, _mm256_blend_epi32(_mm256_setzero_si256(), spill, 0xF0));
+            x = _mm256_add_epi32(x, carry);
+            _mm256_storeu_si256((__m256i*)(dst + i), x);
+            carry = _mm256_permutevar8x32_epi32(x, last_lane);
+        }
+        uint32_t running = i > 0 ? dst[i - 1] : 0;
+        for (; i < count; i++) {
+            running += dst[i];
+            dst[i] = running;
+        }
+    }
+
+} // namespace ResultConversions
@@ -0,0 +1,350 @@
+#include "set_operations.h"
+#include <immintrin.h>
+#include <algorithm>
+
+namespace {
+
+    // Mask of the lanes of `a` equal to any lane of `b` (all 8 rotations of b)
+    inline uint32_t matchMask8(__m256i a, __m256i b) {
+        const __m256i rotate = _mm256_setr_epi32(1, 2, 3, 4, 5, 6, 7, 0);
+        __m256i hits = _mm256_cmpeq_epi32(a, b);
+        for (int r = 1; r < 8; r++) {
+            b = _mm256_permutevar8x32_epi32(b, rotate);
+            hits = _mm256_or_si256(hits, _mm256_cmpeq_epi32(a, b));
+        }
+        return static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(hits)));
+    }
+
+    // Appends the lanes of `v` selected by `mask` in order; dst needs 8 lanes of room
+    inline uint32_t* leftPack(uint32_t* dst, __m256i v, uint32_t mask) {
+        __m256i permutation = _mm256_load_si256((const __m256i*)ResultConversions::setBitLanes(mask));
+        _mm256_storeu_si256((__m256i*)dst, _mm256_permutevar8x32_epi32(v, permutation));
+        return dst + _mm_popcnt_u32(mask);
+    }
+
+    // Sorts a bitonic 8-lane vector (the three half-cleaner stages of a bitonic merge)
+    inline __m256i sortBitonic8(__m256i x) {
+        __m256i t = _mm256_permute2x128_si256(x, x, 1);
+        x = _mm256_blend_epi32(_mm256_min_epu32(x, t), _mm256_max_epu32(x, t), 0xF0);
+        t = _mm256_shuffle_epi32(x, _MM_SHUFFLE(1, 0, 3, 2));
+        x = _mm256_blend_epi32(_mm256_min_epu32(x, t), _mm256_max_epu32(x, t), 0xCC);
+        t = _mm256_shuffle_epi32(x, _MM_SHUFFLE(2, 3, 0, 1));
+        x = _mm256_blend_epi32(_mm256_min_epu32(x, t), _mm256_max_epu32(x, t), 0xAA);
+        return x;
+    }
+
+    // Merges two sorted vectors: `a` receives the 8 smallest, `b` the 8 largest, both sorted
+    inline void bitonicMerge8(__m256i& a, __m256i& b) {
+        const __m256i reverse = _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+        b = _mm256_permutevar8x32_epi32(b, reverse);
+        __m256i lo = _mm256_min_epu32(a, b);
+        __m256i hi = _mm256_max_epu32(a, b);
+        a = sortBitonic8(lo);
+        b = sortBitonic8(hi);
+    }
+
+    // First index in [from, size) with data[index] >= value, probing 1, 2, 4, ... ahead
+    size_t gallop(const uint32_t* data, size_t from, size_t size, uint32_t value) {
+        size_t lo = from;
+        size_t hi = from;
+        size_t step = 1;
+        while (hi < size && data[hi] < value) {
+            lo = hi + 1;
+            hi += step;
+            step *= 2;
+        }
+        hi = std::min(hi + 1, size);
+        return std::lower_bound(data + lo, data + hi, value) - data;
+    }
+
+    template <typename Op>
+    void combineBitmaps(const std::vector<uint64_t>& a, const std::vector<uint64_t>& b,
+                        std::vector<uint64_t>& out, Op op) {
+        size_t common = std::min(a.size(), b.size());
+        out.resize(std::max(a.size(), b.size()));
+        size_t w = 0;
+        for (; w + 4 <= common; w += 4) {
+            __m256i va = _mm256_loadu_si256((const __m256i*)(a.data() + w));
+            __m256i vb = _mm256_loadu_si256((const __m256i*)(b.data() + w));
+            _mm256_storeu_si256((__m256i*)(out.data() + w), op(va, vb));
+        }
+        // Scalar tail, with the shorter input zero-extended
+        for (; w < out.size(); w++) {
+            __m256i va = _mm256_set1_epi64x(w < a.size() ? a[w] : 0);
+            __m256i vb = _mm256_set1_epi64x(w < b.size() ? b[w] : 0);
+            out[w] = static_cast<uint64_t>(_mm256_extract_epi64(op(va, vb), 0));
+        }
+    }
+
+    // Positions of `list` whose bit in `bitmap` equals `keep_set`
+    ResultSet filterByBitmap(const ResultSet& list, const ResultSet& bitmap, bool keep_set) {
+        std::vector<uint32_t> positions;
+        list.toPositions(positions);
+        const auto& words = bitmap.getBitmap();
+        auto end = std::remove_if(positions.begin(), positions.end(), [&](uint32_t row) {
+            size_t w = row >> 6;
+            bool set = w < words.size() && ((words[w] >> (row & 63)) & 1);
+            return set != keep_set;
+        });
+        positions.erase(end, positions.end());
+        return ResultSet(positions, std::max(list.getNumRows(), bitmap.getNumRows()));
+    }
+
+} // namespace
+
+namespace SetOperations {
+
+    void intersect(const uint32_t* a, size_t a_size, const uint32_t* b, size_t b_size,
+                   std::vector<uint32_t>& out) {
+        if (a_size > b_size) {
+            std::swap(a, b);
+            std::swap(a_size, b_size);
+        }
+        out.resize(a_size + 8);
+        uint32_t* dst = out.data();
+
+        if (a_size > 0 && b_size / a_size >= GALLOP_RATIO) {
+            size_t j = 0;
+            for (size_t i = 0; i < a_size && j < b_size; i++) {
+                j = gallop(b, j, b_size, a[i]);
+                if (j < b_size && b[j] == a[i]) {
+                    *dst++ = a[i];
+                }
+            }
+            out.resize(dst - out.data());
+            return;
+        }
+
+        // All-pairs 8x8 block compare; the block with the smaller maximum advances
+        size_t i = 0;
+        size_t j = 0;
+        while (i + 8 <= a_size && j + 8 <= b_size) {
+            __m256i va = _mm256_loadu_si256((const __m256i*)(a + i));
+            __m256i vb = _mm256_loadu_si256((const __m256i*)(b + j));
+            dst = leftPack(dst, va, matchMask8(va, vb));
+            uint32_t a_max = a[i + 7];
+            uint32_t b_max = b[j + 7];
+            i += (a_max <= b_max) ? 8 : 0;
+            j += (b_max <= a_max) ? 8 : 0;
+        }
+        while (i < a_size && j < b_size) {
+            if (a[i] < b[j]) {
+                i++;
+            } else if (b[j] < a[i]) {
+                j++;
+            } else {
+                *dst++ = a[i];
+                i++;
+                j++;
+            }
+        }
+        out.resize(dst - out.data());
+    }
+
+    void unite(const uint32_t* a, size_t a_size, const uint32_t* b, size_t b_size,
+               std::vector<uint32_t>& out) {
+        out.resize(a_size + b_size + 8);
+        uint32_t* dst = out.data();
+
+        if (a_size < 8 || b_size < 8) {
+            dst = std::set_union(a, a + a_size, b, b + b_size, dst);
+            out.resize(dst - out.data());
+            return;
+        }
+
+        // Duplicates (one from each input) come out adjacent, so each merged block
+        // drops the lanes equal to their predecessor
+        const __m256i shift_up = _mm256_setr_epi32(0, 0, 1, 2, 3, 4, 5, 6);
+        uint32_t last = a[0] < b[0] ? a[0] - 1 : b[0] - 1;
+        auto emit = [&](__m256i v) {
+            __m256i previous = _mm256_blend_epi32(
+                _mm256_permutevar8x32_epi32(v, shift_up), _mm256_set1_epi32(last), 0x01);
+            uint32_t duplicate = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(v, previous)));
+            dst = leftPack(dst, v, ~duplicate & 0xFF);
+            last = static_cast<uint32_t>(_mm256_extract_epi32(v, 7));
+        };
+
+        __m256i lo = _mm256_loadu_si256((const __m256i*)a);
+        __m256i hi = _mm256_loadu_si256((const __m256i*)b);
+        size_t i = 8;
+        size_t j = 8;
+        bitonicMerge8(lo, hi);
+        emit(lo);
+
+        // Always pull the next block from the input with the smaller head
+        while (i + 8 <= a_size && j + 8 <= b_size) {
+            if (a[i] <= b[j]) {
+                lo = _mm256_loadu_si256((const __m256i*)(a + i));
+                i += 8;
+            } else {
+                lo = _mm256_loadu_si256((const __m256i*)(b + j));
+                j += 8;
+            }
+            bitonicMerge8(lo, hi);
+            emit(lo);
+        }
+
+        // Scalar tail: the carried block plus what is left of both inputs
+        uint32_t carried[8];
+        _mm256_storeu_si256((__m256i*)carried, hi);
+        std::vector<uint32_t> merged(8 + (a_size - i));
+        std::merge(carried, carried + 8, a + i, a + a_size, merged.begin());
+        std::vector<uint32_t> tail(merged.size() + (b_size - j));
+        std::merge(merged.begin(), merged.end(), b + j, b + b_size, tail.begin());
+        for (uint32_t value : tail) {
+            if (value != last) {
+                *dst++ = value;
+                last = value;
+            }
+        }
+        out.resize(dst - out.data());
+    }
+
+    void subtract(const uint32_t* a, size_t a_size, const uint32_t* b, size_t b_size,
+                  std::vector<uint32_t>& out) {
+        out.resize(a_size + 8);
+        uint32_t* dst = out.data();
+
+        if (a_size > 0 && b_size / a_size >= GALLOP_RATIO) {
+            size_t j = 0;
+            for (size_t i = 0; i < a_size; i++) {
+                j = gallop(b, j, b_size, a[i]);
+                if (j == b_size || b[j] != a[i]) {
+                    *dst++ = a[i];
+                }
+            }
+            out.resize(dst - out.data());
+            return;
+        }
+        if (b_size > 0 && a_size / b_size >= GALLOP_RATIO) {
+            // Few removals: copy the runs of `a` between them
+            size_t i = 0;
+            for (size_t j = 0; j < b_size && i < a_size; j++) {
+                size_t next = gallop(a, i, a_size, b[j]);
+                dst = std::copy(a + i, a + next, dst);
+                i = (next < a_size && a[next] == b[j]) ? next + 1 : next;
+            }
+            dst = std::copy(a + i, a + a_size, dst);
+            out.resize(dst - out.data());
+            return;
+        }
+
+        // Matches against every b block are accumulated until the a block is retired
+        size_t i = 0;
+        size_t j = 0;
+        uint32_t found = 0;
+        while (i + 8 <= a_size && j + 8 <= b_size) {
+            __m256i va = _mm256_loadu_si256((const __m256i*)(a + i));
+            __m256i vb = _mm256_loadu_si256((const __m256i*)(b + j));
+            found |= matchMask8(va, vb);
+            uint32_t a_max = a[i + 7];
+            uint32_t b_max = b[j + 7];
+            if (a_max <= b_max) {
+                dst = leftPack(dst, va, ~found & 0xFF);
+                found = 0;
+                i += 8;
+            }
+            if (b_max <= a_max) {
+                j += 8;
+            }
+        }
+        for (size_t k = i; k < a_size; k++) {
+            if (k - i < 8 && ((found >> (k - i)) & 1)) {
+                continue;
+            }
+            while (j < b_size && b[j] < a[k]) {
+                j++;
+            }
+            if (j == b_size || b[j] != a[k]) {
+                *dst++ = a[k];
+            }
+        }
+        out.resize(dst - out.data());
+    }
+
+    void intersect(const std::vector<uint32_t>& a, const std::vector<uint32_t>& b, std::vector<uint32_t>& out) {
+        intersect(a.data(), a.size(), b.data(), b.size(), out);
+    }
+
+    void unite(const std::vector<uint32_t>& a, const std::vector<uint32_t>& b, std::vector<uint32_t>& out) {
+        unite(a.data(), a.size(), b.data(), b.size(), out);
+    }
+
+    void subtract(const std::vector<uint32_t>& a, const std::vector<uint32_t>& b, std::vector<uint32_t>& out) {
+        subtract(a.data(), a.size(), b.data(), b.size(), out);
+    }
+
+    void intersectBitmaps(const std::vector<uint64_t>& a, const std::vector<uint64_t>& b,
+                          std::vector<uint64_t>& out) {
+        combineBitmaps(a, b, out, [](__m256i x, __m256i y) { return _mm256_and_si256(x, y); });
+    }
+
+    void uniteBitmaps(const std::vector<uint64_t>& a, const std::vector<uint64_t>& b,
+                      std::vector<uint64_t>& out) {
+        combineBitmaps(a, b, out, [](__m256i x, __m256i y) { return _mm256_or_si256(x, y); });
+    }
+
+    void subtractBitmaps(const std::vector<uint64_t>& a, const std::vector<uint64_t>& b,
+                         std::vector<uint64_t>& out) {
+        combineBitmaps(a, b, out, [](__m256i x, __m256i y) { return _mm256_andnot_si256(y, x); });
+    }
+
+    ResultSet intersect(const ResultSet& a, const ResultSet& b) {
+        size_t num_rows = std::max(a.getNumRows(), b.getNumRows());
+        bool a_bitmap = a.getEncoding() == ResultEncoding::Bitmap;
+        bool b_bitmap = b.getEncoding() == ResultEncoding::Bitmap;
+
+        if (a_bitmap && b_bitmap) {
+            std::vector<uint64_t> words;
+            intersectBitmaps(a.getBitmap(), b.getBitmap(), words);
+            return ResultSet::fromBitmap(std::move(words), num_rows);
+        }
+        if (a_bitmap || b_bitmap) {
+            return a_bitmap ? filterByBitmap(b, a, true) : filterByBitmap(a, b, true);
+        }
+
+        std::vector<uint32_t> a_positions, b_positions, result;
+        a.toPositions(a_positions);
+        b.toPositions(b_positions);
+        intersect(a_positions, b_positions, result);
+        return ResultSet(result, num_rows);
+    }
+
+    ResultSet unite(const ResultSet& a, const ResultSet& b) {
+        size_t num_rows = std::max(a.getNumRows(), b.getNumRows());
+
+        if (a.getEncoding() == ResultEncoding::Bitmap || b.getEncoding() == ResultEncoding::Bitmap) {
+            std::vector<uint64_t> a_words, b_words, words;
+            a.toBitmap(a_words);
+            b.toBitmap(b_words);
+            uniteBitmaps(a_words, b_words, words);
+            return ResultSet::fromBitmap(std::move(words), num_rows);
+        }
+
+        std::vector<uint32_t> a_positions, b_positions, result;
+        a.toPositions(a_positions);
+        b.toPositions(b_positions);
+        unite(a_positions, b_positions, result);
+        return ResultSet(result, num_rows);
+    }
+
+    ResultSet subtract(const ResultSet& a, const ResultSet& b) {
+        size_t num_rows = std::max(a.getNumRows(), b.getNumRows());
+
+        if (b.getEncoding() == ResultEncoding::Bitmap) {
+            if (a.getEncoding() != ResultEncoding::Bitmap) {
+                return filterByBitmap(a, b, false);
+            }
+            std::vector<uint64_t> words;
+            subtractBitmaps(a.getBitmap(), b.getBitmap(), words);
+            return ResultSet::fromBitmap(std::move(words), num_rows);
+        }
+
+        std::vector<uint32_t> a_positions, b_positions, result;
+        a.toPositions(a_positions);
+        b.toPositions(b_positions);
+        subtract(a_positions, b_positions, result);
+        return ResultSet(result, num_rows);
+    }
+
+} // namespace SetOperations
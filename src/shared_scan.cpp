@@ -0,0 +1,143 @@
+#include "shared_scan.h"
+#include "scan_kernels.h"
+#include <algorithm>
+#include <stdexcept>
+
+SharedScanScheduler::SharedScanScheduler(const DictionaryCodec& codec,
+                                         std::chrono::microseconds batch_window)
+    : codec(codec), batch_window(batch_window), cursor(0), stopping(false),
+      blocks_scanned(0), queries_served(0) {
+    scan_thread = std::thread(&SharedScanScheduler::scanLoop, this);
+}
+
+SharedScanScheduler::~SharedScanScheduler() {
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        stopping = true;
+    }
+    queue_cv.notify_all();
+    scan_thread.join();
+}
+
+std::vector<size_t> SharedScanScheduler::findMatches(const std::string& target) {
+    return submit([this, &target](std::vector<uint32_t>& ids) {
+        uint32_t id;
+        if (codec.lookupId(target, id)) {
+            ids.push_back(id);
+        }
+    });
+}
+
+std::vector<size_t> SharedScanScheduler::prefixMatches(const std::string& prefix) {
+    // An empty prefix matches nothing, as in prefixSearchInto
+    if (prefix.empty()) {
+        queries_served++;
+        return {};
+    }
+    return submit([this, &prefix](std::vector<uint32_t>& ids) { codec.collectPrefixIds(prefix, ids); });
+}
+
+std::vector<size_t> SharedScanScheduler::submit(const std::function<void(std::vector<uint32_t>&)>& resolve_ids) {
+    // The IDs, their bitmap and the window are taken from one version of the column
+    ScanQuery query;
+    {
+        std::shared_lock<std::shared_mutex> lock(codec.mutex);
+        resolve_ids(query.ids);
+        query.num_rows = codec.encoded_data.size();
+        query.epoch = codec.column_epoch;
+        if (query.ids.size() > 1) {
+            codec.buildIdBitmap(query.ids, query.bitmap);
+        }
+    }
+    if (query.ids.empty() || query.num_rows == 0) {
+        queries_served++;
+        return {};
+    }
+    query.rows_covered = 0;
+    query.wrap_index = 0;
+
+    std::future<std::vector<size_t>> result = query.done.get_future();
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        pending.push_back(std::move(query));
+    }
+    queue_cv.notify_one();
+    return result.get();
+}
+
+void SharedScanScheduler::scanLoop() {
+    std::unique_lock<std::mutex> lock(queue_mutex);
+    while (true) {
+        if (active.empty()) {
+            queue_cv.wait(lock, [this] { return stopping || !pending.empty(); });
+            if (pending.empty()) {
+                return;
+            }
+            // Give concurrent callers a moment to join before the scan starts
+            if (batch_window.count() > 0) {
+                queue_cv.wait_for(lock, batch_window, [this] { return stopping; });
+            }
+        }
+
+        // New queries join at this block boundary
+        active.splice(active.end(), pending);
+        lock.unlock();
+
+        scanBlock();
+
+        for (auto it = active.begin(); it != active.end();) {
+            if (it->error) {
+                it->done.set_exception(it->error);
+                it = active.erase(it);
+            } else if (it->rows_covered >= it->num_rows) {
+                // Rows after the wrap are the low ones, so they go first
+                std::rotate(it->results.begin(), it->results.begin() + it->wrap_index, it->results.end());
+                // Counted before the caller is woken, so it sees its own query served
+                queries_served++;
+                it->done.set_value(std::move(it->results));
+                it = active.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        lock.lock();
+    }
+}
+
+void SharedScanScheduler::scanBlock() {
+    std::shared_lock<std::shared_mutex> lock(codec.mutex);
+    const uint32_t* data = codec.encoded_data.data();
+    size_t total_rows = codec.encoded_data.size();
+
+    if (cursor >= total_rows) {
+        cursor = 0;
+        for (auto& query : active) {
+            query.wrap_index = query.results.size();
+        }
+    }
+    size_t block_begin = cursor;
+    size_t block_end = std::min(block_begin + SCAN_BLOCK_ROWS, total_rows);
+
+    // The first query pulls the block into cache; the rest evaluate it from there
+    for (auto& query : active) {
+        // The IDs and bitmap no longer describe the rows, which may even be fewer now
+        if (query.epoch != codec.column_epoch) {
+            query.error = std::make_exception_ptr(std::runtime_error("Column was rewritten during the shared scan"));
+            continue;
+        }
+        size_t end = std::min(block_end, query.num_rows);
+        if (block_begin >= end) {
+            continue;
+        }
+        auto emit = [&query](size_t row) { query.results.push_back(row); return true; };
+        if (query.ids.size() == 1) {
+            ScanKernels::forEachEqual(data, block_begin, end, query.ids[0], emit);
+        } else {
+            ScanKernels::forEachInBitmap(data, block_begin, end, query.bitmap.data(), emit);
+        }
+        query.rows_covered += end - block_begin;
+    }
+
+    cursor = block_end;
+    blocks_scanned++;
+}
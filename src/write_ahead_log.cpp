@@ -0,0 +1,392 @@
+#include "write_ahead_log.h"
+#include <fstream>
+#include <iostream>
+#include <filesystem>
+#include <stdexcept>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr uint32_t RECORD_MAGIC = 0x4c574344;  // "DCWL"
+
+struct RecordHeader {
+    uint32_t magic;
+    uint32_t length;
+    uint64_t checksum;
+};
+
+uint64_t checksum(const uint8_t* data, size_t length) {
+    uint64_t hash = 1469598103934665603ull;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= data[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+template <typename T>
+void put(std::vector<uint8_t>& out, T value) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+template <typename T>
+bool get(const uint8_t*& in, const uint8_t* end, T& value) {
+    if (static_cast<size_t>(end - in) < sizeof(T)) {
+        return false;
+    }
+    std::memcpy(&value, in, sizeof(T));
+    in += sizeof(T);
+    return true;
+}
+
+bool parsePayload(const uint8_t* in, const uint8_t* end, AppendRecord& record) {
+    uint32_t entry_count;
+    uint32_t run_count;
+    if (!get(in, end, record.base_dict_size) || !get(in, end, record.first_row) ||
+        !get(in, end, entry_count) || !get(in, end, run_count)) {
+        return false;
+    }
+    record.entries.clear();
+    record.runs.clear();
+    for (uint32_t i = 0; i < entry_count; i++) {
+        uint32_t length;
+        if (!get(in, end, length) || static_cast<size_t>(end - in) < length) {
+            return false;
+        }
+        record.entries.emplace_back(reinterpret_cast<const char*>(in), length);
+        in += length;
+    }
+    if (static_cast<size_t>(end - in) != static_cast<size_t>(run_count) * 2 * sizeof(uint32_t)) {
+        return false;
+    }
+    record.runs.resize(run_count);
+    for (auto& [id, length] : record.runs) {
+        get(in, end, id);
+        get(in, end, length);
+    }
+    return true;
+}
+
+void writeAll(int fd, const uint8_t* data, size_t length) {
+    while (length > 0) {
+        ssize_t written = ::write(fd, data, length);
+        if (written < 0) {
+            throw std::runtime_error("Failed to write write-ahead log");
+        }
+        data += written;
+        length -= written;
+    }
+}
+
+}  // namespace
+
+void syncDirectory(const std::string& path) {
+    std::string directory = std::filesystem::path(path).parent_path().string();
+    if (directory.empty()) {
+        directory = ".";
+    }
+    int fd = ::open(directory.c_str(), O_RDONLY);
+    if (fd < 0 || ::fsync(fd) != 0) {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        throw std::runtime_error("Failed to sync directory: " + directory);
+    }
+    ::close(fd);
+}
+
+uint64_t AppendRecord::rowCount() const {
+    uint64_t rows = 0;
+    for (const auto& run : runs) {
+        rows += run.second;
+    }
+    return rows;
+}
+
+WriteAheadLog::WriteAheadLog(const std::string& path, size_t checkpoint_bytes, std::function<void()> checkpoint,
+                             std::chrono::microseconds commit_window)
+    : path(path), fd(-1), file_base(0), appended(0), durable(0), flushing(false), failed(false),
+      holding(false), sync_count(0),
+      commit_window(commit_window), checkpoint_bytes(checkpoint_bytes), checkpoint(std::move(checkpoint)),
+      checkpoint_requested(false), closed(false) {
+    // Cut a torn tail off, so new records directly follow the last intact one
+    size_t valid = replay(path, nullptr);
+    fd = ::open(path.c_str(), O_WRONLY | O_CREAT, 0644);
+    if (fd < 0 || ::ftruncate(fd, valid) != 0 || ::lseek(fd, 0, SEEK_END) < 0) {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        throw std::runtime_error("Failed to open write-ahead log: " + path);
+    }
+    appended = durable = valid;
+
+    if (this->checkpoint) {
+        checkpointer = std::thread(&WriteAheadLog::checkpointLoop, this);
+    }
+}
+
+WriteAheadLog::~WriteAheadLog() {
+    try {
+        close();
+    } catch (const std::exception& e) {
+        std::cerr << "Error closing write-ahead log: " << e.what() << std::endl;
+    }
+}
+
+uint64_t WriteAheadLog::append(const AppendRecord& record) {
+    std::vector<uint8_t> payload;
+    put<uint64_t>(payload, record.base_dict_size);
+    put<uint64_t>(payload, record.first_row);
+    put<uint32_t>(payload, static_cast<uint32_t>(record.entries.size()));
+    put<uint32_t>(payload, static_cast<uint32_t>(record.runs.size()));
+    for (const auto& entry : record.entries) {
+        put<uint32_t>(payload, static_cast<uint32_t>(entry.length()));
+        payload.insert(payload.end(), entry.begin(), entry.end());
+    }
+    for (const auto& [id, length] : record.runs) {
+        put<uint32_t>(payload, id);
+        put<uint32_t>(payload, length);
+    }
+
+    RecordHeader header{RECORD_MAGIC, static_cast<uint32_t>(payload.size()), checksum(payload.data(), payload.size())};
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (closed) {
+        throw std::runtime_error("Write-ahead log is closed");
+    }
+    if (failed) {
+        throw std::runtime_error("Write-ahead log failed: " + path);
+    }
+    const uint8_t* header_bytes = reinterpret_cast<const uint8_t*>(&header);
+    buffer.insert(buffer.end(), header_bytes, header_bytes + sizeof(header));
+    buffer.insert(buffer.end(), payload.begin(), payload.end());
+    appended += sizeof(header) + payload.size();
+
+    if (checkpoint && !checkpoint_requested && appended - file_base > checkpoint_bytes) {
+        checkpoint_requested = true;
+        checkpoint_cv.notify_one();
+    }
+    return appended;
+}
+
+void WriteAheadLog::sync(uint64_t position) {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        if (failed) {
+            throw std::runtime_error("Write-ahead log failed: " + path);
+        }
+        if (durable >= position && !holding) {
+            return;
+        }
+        if (flushing || durable >= position) {
+            durable_cv.wait(lock);
+        } else {
+            flushLocked(lock);
+        }
+    }
+}
+
+void WriteAheadLog::holdAcknowledgements() {
+    std::lock_guard<std::mutex> lock(mutex);
+    holding = true;
+}
+
+void WriteAheadLog::releaseAcknowledgements() {
+    std::lock_guard<std::mutex> lock(mutex);
+    holding = false;
+    durable_cv.notify_all();
+}
+
+void WriteAheadLog::abort() {
+    std::lock_guard<std::mutex> lock(mutex);
+    failed = true;
+    durable_cv.notify_all();
+}
+
+void WriteAheadLog::flushLocked(std::unique_lock<std::mutex>& lock) {
+    flushing = true;
+    if (commit_window.count() > 0) {
+        // Let more appenders join this group before it is cut
+        lock.unlock();
+        std::this_thread::sleep_for(commit_window);
+        lock.lock();
+    }
+    std::vector<uint8_t> batch;
+    batch.swap(buffer);
+    uint64_t target = appended;
+    lock.unlock();
+
+    bool ok = true;
+    try {
+        writeAll(fd, batch.data(), batch.size());
+        ok = ::fdatasync(fd) == 0;
+    } catch (...) {
+        ok = false;
+    }
+
+    lock.lock();
+    flushing = false;
+    if (ok) {
+        durable = target;
+        sync_count++;
+    } else {
+        // Nothing after the last durable record can be trusted, including a torn one
+        failed = true;
+        if (::ftruncate(fd, durable - file_base) != 0) {
+            std::cerr << "Failed to cut write-ahead log back to its durable end: " << path << std::endl;
+        }
+    }
+    durable_cv.notify_all();
+    if (!ok) {
+        throw std::runtime_error("Failed to sync write-ahead log: " + path);
+    }
+}
+
+void WriteAheadLog::truncateBefore(uint64_t position) {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!closed && !failed && (flushing || durable < appended)) {
+        if (flushing) {
+            durable_cv.wait(lock);
+        } else {
+            flushLocked(lock);
+        }
+    }
+    if (failed) {
+        throw std::runtime_error("Write-ahead log failed: " + path);
+    }
+    if (closed || position <= file_base) {
+        return;
+    }
+    position = std::min(position, appended);
+
+    // Copy the surviving tail beside the log and rename it into place
+    std::vector<char> tail(appended - position);
+    {
+        std::ifstream in(path, std::ios::binary);
+        in.seekg(position - file_base);
+        in.read(tail.data(), tail.size());
+        if (!in) {
+            throw std::runtime_error("Failed to read write-ahead log: " + path);
+        }
+    }
+    std::string temp_path = path + ".tmp";
+    int temp_fd = ::open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (temp_fd < 0) {
+        throw std::runtime_error("Failed to open write-ahead log: " + temp_path);
+    }
+    try {
+        writeAll(temp_fd, reinterpret_cast<const uint8_t*>(tail.data()), tail.size());
+        if (::fdatasync(temp_fd) != 0) {
+            throw std::runtime_error("Failed to sync write-ahead log: " + temp_path);
+        }
+    } catch (...) {
+        ::close(temp_fd);
+        throw;
+    }
+    std::filesystem::rename(temp_path, path);
+    ::close(fd);
+    fd = temp_fd;
+    file_base = position;
+    // Appends already go to the renamed file, so swap first and report a failed sync after
+    syncDirectory(path);
+}
+
+void WriteAheadLog::renameTo(const std::string& new_path) {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::filesystem::rename(path, new_path);
+    path = new_path;
+    syncDirectory(path);
+}
+
+void WriteAheadLog::close() {
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (closed) {
+            return;
+        }
+        // A failed flush was already reported to the appenders waiting on it
+        while (!failed && (flushing || durable < appended)) {
+            if (flushing) {
+                durable_cv.wait(lock);
+            } else {
+                try {
+                    flushLocked(lock);
+                } catch (const std::exception&) {
+                }
+            }
+        }
+        closed = true;
+        checkpoint_cv.notify_all();
+    }
+    if (checkpointer.joinable()) {
+        if (checkpointer.get_id() == std::this_thread::get_id()) {
+            checkpointer.detach();
+        } else {
+            checkpointer.join();
+        }
+    }
+    ::close(fd);
+    fd = -1;
+}
+
+void WriteAheadLog::checkpointLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        checkpoint_cv.wait(lock, [this] { return closed || checkpoint_requested; });
+        if (closed) {
+            return;
+        }
+        lock.unlock();
+        try {
+            checkpoint();
+        } catch (const std::exception& e) {
+            // The log stays intact, so the next append over the threshold retries
+            std::cerr << "Checkpoint failed: " << e.what() << std::endl;
+        }
+        lock.lock();
+        checkpoint_requested = false;
+    }
+}
+
+uint64_t WriteAheadLog::getPosition() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return appended;
+}
+
+size_t WriteAheadLog::getFileSize() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return appended - file_base;
+}
+
+size_t WriteAheadLog::getSyncCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return sync_count;
+}
+
+size_t WriteAheadLog::replay(const std::string& path, const std::function<void(const AppendRecord&)>& apply) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        return 0;
+    }
+
+    size_t valid = 0;
+    std::vector<uint8_t> payload;
+    AppendRecord record;
+    RecordHeader header;
+    while (in.read(reinterpret_cast<char*>(&header), sizeof(header)) && header.magic == RECORD_MAGIC) {
+        payload.resize(header.length);
+        if (!in.read(reinterpret_cast<char*>(payload.data()), payload.size()) ||
+            checksum(payload.data(), payload.size()) != header.checksum ||
+            !parsePayload(payload.data(), payload.data() + payload.size(), record)) {
+            break;
+        }
+        if (apply) {
+            apply(record);
+        }
+        valid += sizeof(header) + payload.size();
+    }
+    return valid;
+}
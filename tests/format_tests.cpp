@@ -0,0 +1,758 @@
+#include "dictionary_codec.h"
+#include "block_compression.h"
+#include "compressed_column.h"
+#include "write_ahead_log.h"
+#include "arrow_ipc.h"
+#include <zstd.h>
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <functional>
+#include <random>
+#include <thread>
+#include <future>
+#include <memory>
+#include <algorithm>
+#include <cstddef>
+#include <csignal>
+#include <sys/resource.h>
+
+// Round-trip and crash-recovery checks for every on-disk format: block-compressed
+// columns (filters, front-coded dictionary, lazy index load), snapshots, the
+// write-ahead log, online snapshots, Arrow IPC streams and CSV exports, plus the
+// statistics and query semantics they are loaded into. Run with `make test`.
+
+namespace fs = std::filesystem;
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(condition) check((condition), #condition, __FILE__, __LINE__)
+
+void check(bool ok, const char* condition, const char* file, int line) {
+    if (!ok) {
+        std::cerr << file << ":" << line << ": check failed: " << condition << "\n";
+        failures++;
+    }
+}
+
+template <typename Action>
+bool throwsRuntimeError(Action&& action) {
+    try {
+        action();
+    } catch (const std::runtime_error&) {
+        return true;
+    }
+    return false;
+}
+
+fs::path freshDirectory(const std::string& name) {
+    fs::path directory = fs::temp_directory_path() / "dictionary_codec_tests" / name;
+    fs::remove_all(directory);
+    fs::create_directories(directory);
+    return directory;
+}
+
+std::vector<std::string> rowsOf(const DictionaryCodec& codec) {
+    DecodedColumn column;
+    codec.decodeRange(0, codec.getDataSize(), column);
+    std::vector<std::string> rows;
+    for (size_t i = 0; i < column.size(); i++) {
+        rows.emplace_back(column.value(i));
+    }
+    return rows;
+}
+
+std::unique_ptr<DictionaryCodec> codecOf(const std::vector<std::string>& rows) {
+    auto codec = std::make_unique<DictionaryCodec>();
+    codec->appendValues(rows);
+    return codec;
+}
+
+// Column shapes that favour different block filters
+std::vector<std::string> randomRows(size_t count, size_t distinct, uint32_t seed) {
+    std::mt19937 gen(seed);
+    std::uniform_int_distribution<size_t> pick(0, distinct - 1);
+    std::vector<std::string> rows(count);
+    for (auto& row : rows) {
+        row = "value_" + std::to_string(pick(gen));
+    }
+    return rows;
+}
+
+std::vector<std::string> runRows(size_t count, size_t run_length) {
+    std::vector<std::string> rows(count);
+    for (size_t i = 0; i < count; i++) {
+        rows[i] = "run_" + std::to_string(i / run_length);
+    }
+    return rows;
+}
+
+// Dictionary values with long shared prefixes, an empty value and non-ASCII bytes
+std::vector<std::string> awkwardValues(size_t count) {
+    std::vector<std::string> values = {"", std::string(5000, 'x'), std::string("\xff\x00\x01", 3)};
+    for (size_t i = 0; values.size() < count; i++) {
+        values.push_back("shared/prefix/path/" + std::to_string(i % 97) + "/" + std::to_string(i));
+    }
+    return values;
+}
+
+void truncateFile(const fs::path& path, size_t bytes_removed) {
+    fs::resize_file(path, fs::file_size(path) - bytes_removed);
+}
+
+void copyState(const fs::path& from, const fs::path& to) {
+    fs::remove_all(to);
+    fs::create_directories(to);
+    for (const char* name : {"snapshot.bin", "wal.log"}) {
+        if (fs::exists(from / name)) {
+            fs::copy_file(from / name, to / name);
+        }
+    }
+}
+
+void testBlockColumnRoundTrip() {
+    fs::path directory = freshDirectory("block");
+    std::vector<std::vector<std::string>> shapes = {
+        randomRows(600000, 5000, 1),  // Several blocks and a partial last one
+        runRows(300000, 37),
+        randomRows(20000, 3, 2),
+        std::vector<std::string>(1000, "same"),
+    };
+    for (const auto& rows : shapes) {
+        auto codec = codecOf(rows);
+        std::string file = (directory / "column.bin").string();
+        codec->saveToFile(file);
+
+        DictionaryCodec loaded;
+        loaded.loadFromFile(file);
+        CHECK(rowsOf(loaded) == rows);
+
+        CompressedColumnReader reader(file);
+        CHECK(reader.getRowCount() == rows.size());
+        CHECK(reader.countMatches(rows[rows.size() / 2]) == codec->countMatches(rows[rows.size() / 2]));
+        CHECK(reader.getValue(rows.size() - 1) == rows.back());
+        CHECK(reader.countPrefix(rows[0].substr(0, 5)) == codec->countPrefix(rows[0].substr(0, 5)));
+        CHECK(reader.countPrefix("") == 0 && codec->countPrefix("") == 0);
+        CHECK(reader.prefixMatches("").empty() && codec->prefixSearchSIMD("").empty());
+
+        // A block ref pointing past the payload is refused before anything is read through it
+        std::string damaged = (directory / "damaged.bin").string();
+        fs::copy_file(file, damaged, fs::copy_options::overwrite_existing);
+        {
+            std::fstream corrupt(damaged, std::ios::in | std::ios::out | std::ios::binary);
+            uint64_t index_offset;
+            corrupt.seekg(offsetof(BlockCompression::ColumnFileHeader, index_offset));
+            corrupt.read(reinterpret_cast<char*>(&index_offset), sizeof(index_offset));
+            uint64_t bad_offset = fs::file_size(file);
+            corrupt.seekp(index_offset + offsetof(BlockCompression::BlockRef, offset));
+            corrupt.write(reinterpret_cast<const char*>(&bad_offset), sizeof(bad_offset));
+        }
+        CHECK(throwsRuntimeError([&] { DictionaryCodec broken; broken.loadFromFile(damaged); }));
+        CHECK(throwsRuntimeError([&] { CompressedColumnReader broken(damaged); }));
+
+        truncateFile(file, fs::file_size(file) / 3);
+        CHECK(throwsRuntimeError([&] { DictionaryCodec broken; broken.loadFromFile(file); }));
+    }
+}
+
+// A load that fails part way, in the dictionary or in the blocks, leaves the codec as it was
+// Writers of damaged copies of a valid snapshot into broken: truncated at several points,
+// a bad magic, and a last row whose ID is past the dictionary
+std::vector<std::function<void()>> corruptSnapshots(const std::string& snapshot, const std::string& broken) {
+    auto copy = [snapshot, broken] {
+        fs::copy_file(snapshot, broken, fs::copy_options::overwrite_existing);
+    };
+    auto overwrite = [broken](size_t offset, const void* data, size_t length) {
+        std::fstream file(broken, std::ios::binary | std::ios::in | std::ios::out);
+        file.seekp(offset);
+        file.write(static_cast<const char*>(data), length);
+    };
+    size_t size = fs::file_size(snapshot);
+    std::vector<std::function<void()>> writers;
+    for (size_t cut : {size_t(0), size_t(16), size / 2, size - 4}) {
+        writers.push_back([=] {
+            copy();
+            fs::resize_file(broken, cut);
+        });
+    }
+    writers.push_back([=] {
+        copy();
+        overwrite(0, "XXXX", 4);
+    });
+    writers.push_back([=] {
+        copy();
+        uint32_t past_dictionary = 0xFFFFFFFF;
+        overwrite(size - sizeof(past_dictionary), &past_dictionary, sizeof(past_dictionary));
+    });
+    return writers;
+}
+
+void testFailedLoadKeepsState() {
+    fs::path directory = freshDirectory("failed_load");
+    std::string file = (directory / "column.bin").string();
+    std::string broken = (directory / "broken.bin").string();
+    codecOf(randomRows(300000, 20000, 15))->saveToFile(file);
+    BlockCompression::ColumnFileHeader header;
+    {
+        std::ifstream in(file, std::ios::binary);
+        in.read(reinterpret_cast<char*>(&header), sizeof(header));
+    }
+
+    std::vector<std::string> rows = randomRows(1000, 30, 16);
+    DictionaryCodec codec;
+    codec.appendValues(rows);
+    size_t cut_points[] = {header.dictionary_offset + 100, (header.dictionary_offset + header.index_offset) / 2,
+                           header.index_offset + 8, static_cast<size_t>(fs::file_size(file)) - 100};
+    for (size_t cut : cut_points) {
+        fs::copy_file(file, broken, fs::copy_options::overwrite_existing);
+        fs::resize_file(broken, cut);
+        CHECK(throwsRuntimeError([&] { codec.loadFromFile(broken); }));
+        CHECK(rowsOf(codec) == rows);
+        CHECK(codec.getFrequency(rows[0]) == static_cast<size_t>(std::count(rows.begin(), rows.end(), rows[0])));
+    }
+
+    // New values still get IDs that agree with the arena
+    codec.appendValues({"appended", rows[0]});
+    rows.insert(rows.end(), {"appended", rows[0]});
+    CHECK(rowsOf(codec) == rows);
+    CHECK(codec.countMatches("appended") == 1);
+    CHECK(codec.getReverseDictionary()[codec.getDictionary().at("appended")] == "appended");
+
+    // A corrupt snapshot over a column loaded from a file: the lookups still resolve
+    std::string snapshot = (directory / "snapshot.bin").string();
+    codecOf(randomRows(5000, 300, 17))->saveSnapshot(snapshot);
+    codec.saveToFile(file);
+    DictionaryCodec loaded;
+    loaded.loadFromFile(file);
+    for (const auto& corrupt : corruptSnapshots(snapshot, broken)) {
+        corrupt();
+        CHECK(throwsRuntimeError([&] { loaded.loadSnapshot(broken); }));
+        CHECK(!loaded.isMapped());
+        CHECK(rowsOf(loaded) == rows);
+        CHECK(loaded.findMatches("appended") == std::vector<size_t>{rows.size() - 2});
+        CHECK(loaded.countMatches(rows[0]) == codec.countMatches(rows[0]));
+    }
+}
+
+void testFailedSnapshotLoadKeepsState() {
+    fs::path directory = freshDirectory("failed_snapshot_load");
+    std::string snapshot = (directory / "snapshot.bin").string();
+    std::string broken = (directory / "broken.bin").string();
+    std::vector<std::string> rows = randomRows(20000, 500, 18);
+    auto original = codecOf(rows);
+    original->saveSnapshot(snapshot);
+
+    // Over a mapped snapshot, and over owned rows whose values sit in the dictionary map
+    DictionaryCodec mapped;
+    mapped.loadSnapshot(snapshot);
+    DictionaryCodec owned;
+    owned.appendValues(rows);
+    for (DictionaryCodec* codec : {&mapped, &owned}) {
+        for (const auto& corrupt : corruptSnapshots(snapshot, broken)) {
+            corrupt();
+            bool was_mapped = codec->isMapped();
+            CHECK(throwsRuntimeError([&] { codec->loadSnapshot(broken); }));
+            CHECK(codec->isMapped() == was_mapped);
+            CHECK(rowsOf(*codec) == rows);
+            CHECK(codec->findMatches(rows[7]) == original->findMatches(rows[7]));
+            CHECK(codec->getFrequency(rows[7]) == original->getFrequency(rows[7]));
+            CHECK(codec->getDictionarySize() == original->getDictionarySize());
+        }
+        codec->appendValues({"appended"});
+        CHECK(codec->findMatches("appended") == std::vector<size_t>{rows.size()});
+    }
+}
+
+void testBlockFilters() {
+    // Every filter decision, and the unfiltered path, must decode to the same IDs
+    std::vector<std::vector<uint32_t>> columns(4, std::vector<uint32_t>(100000));
+    std::mt19937 gen(3);
+    for (size_t i = 0; i < columns[0].size(); i++) {
+        columns[0][i] = static_cast<uint32_t>(i);                // Ascending: delta
+        columns[1][i] = 1000000 + gen() % 200;                   // Narrow range: frame of reference
+        columns[2][i] = gen();                                   // Full range
+        columns[3][i] = static_cast<uint32_t>((i * 7919) % 300);
+    }
+    for (const auto& ids : columns) {
+        for (bool choose_filters : {true, false}) {
+            BlockCompression::ColumnFileHeader header{};
+            header.num_rows = ids.size();
+            header.block_rows = 4096;
+            header.num_blocks = BlockCompression::blockCount(ids.size(), header.block_rows);
+
+            std::vector<std::vector<uint8_t>> frames;
+            BlockCompression::compressBlocks(ids.data(), ids.size(), header.block_rows, BlockCompression::DEFAULT_LEVEL,
+                                             0, frames, choose_filters);
+            std::vector<BlockCompression::BlockRef> blocks;
+            std::vector<uint8_t> payload;
+            for (const auto& frame : frames) {
+                blocks.push_back({payload.size(), frame.size()});
+                payload.insert(payload.end(), frame.begin(), frame.end());
+            }
+            std::vector<uint32_t> decoded(ids.size());
+            BlockCompression::decompressBlocks(payload.data(), blocks, header, decoded.data(), 0);
+            CHECK(decoded == ids);
+        }
+    }
+}
+
+void testFrontCodedDictionary() {
+    std::vector<std::string> values = awkwardValues(3000);
+    std::shuffle(values.begin() + 3, values.end(), std::mt19937(4));
+    std::vector<std::string_view> views(values.begin(), values.end());
+    std::vector<uint8_t> section = BlockCompression::encodeDictionary(views, BlockCompression::DEFAULT_LEVEL, 0);
+
+    std::vector<std::string> decoded;
+    BlockCompression::decodeDictionary(section.data(), section.size(), 0, decoded);
+    CHECK(decoded == values);
+
+    CHECK(throwsRuntimeError([&] {
+        std::vector<std::string> partial;
+        BlockCompression::decodeDictionary(section.data(), section.size() / 2, 0, partial);
+    }));
+
+    // Through a saved column as well
+    fs::path directory = freshDirectory("dictionary");
+    auto codec = codecOf(values);
+    codec->saveToFile((directory / "column.bin").string());
+    DictionaryCodec loaded;
+    loaded.loadFromFile((directory / "column.bin").string());
+    CHECK(rowsOf(loaded) == values);
+}
+
+void testLazyIndexLoad() {
+    fs::path directory = freshDirectory("lazy");
+    std::vector<std::string> rows = randomRows(200000, 50000, 5);
+    auto codec = codecOf(rows);
+    std::string file = (directory / "column.bin").string();
+    codec->saveToFile(file);
+
+    // Lookups issued right after the load wait for the background index
+    DictionaryCodec loaded;
+    loaded.loadFromFile(file);
+    for (size_t i = 0; i < rows.size(); i += 997) {
+        CHECK(loaded.countMatches(rows[i]) == codec->countMatches(rows[i]));
+    }
+    CHECK(!loaded.exists("missing"));
+    CHECK(loaded.getDictionary().size() == codec->getDictionarySize());
+
+    // The first mutation switches to the owned dictionary without renumbering
+    loaded.appendValues({rows[0], "brand new"});
+    CHECK(loaded.countMatches(rows[0]) == codec->countMatches(rows[0]) + 1);
+    CHECK(loaded.countMatches("brand new") == 1);
+    CHECK(loaded.getReverseDictionary()[loaded.getDictionary().at(rows[0])] == rows[0]);
+}
+
+void testSnapshotRoundTrip() {
+    fs::path directory = freshDirectory("snapshot");
+    std::vector<std::string> rows = randomRows(50000, 4000, 6);
+    auto codec = codecOf(rows);
+    std::string file = (directory / "snapshot.bin").string();
+    codec->saveSnapshot(file);
+
+    DictionaryCodec loaded;
+    loaded.loadSnapshot(file);
+    CHECK(loaded.isMapped());
+    CHECK(rowsOf(loaded) == rows);
+    CHECK(loaded.getReverseDictionary() == codec->getReverseDictionary());
+
+    // The dictionary copies are readable through a const reference and leave the snapshot
+    // mapped; a copy is a point-in-time view that later appends do not touch
+    const DictionaryCodec& view = loaded;
+    std::unordered_map<std::string, uint32_t> values = view.getDictionary();
+    CHECK(loaded.isMapped());
+    CHECK(values.size() == codec->getDictionarySize());
+    CHECK(view.getReverseDictionary()[values.at(rows[3])] == rows[3]);
+    loaded.appendValues({"later"});
+    CHECK(values.count("later") == 0);
+    CHECK(view.getDictionary().at("later") == values.size());
+
+    // A corrupt value offset must be refused, not followed outside the mapping
+    std::fstream corrupt(file, std::ios::in | std::ios::out | std::ios::binary);
+    uint64_t offsets_section;
+    corrupt.seekg(8 + 4 + 4 + 4 * sizeof(uint64_t));
+    corrupt.read(reinterpret_cast<char*>(&offsets_section), sizeof(offsets_section));
+    uint32_t bad_offset = 0xfffffff0;
+    corrupt.seekp(offsets_section + 10 * sizeof(uint32_t));
+    corrupt.write(reinterpret_cast<const char*>(&bad_offset), sizeof(bad_offset));
+    corrupt.close();
+    CHECK(throwsRuntimeError([&] { DictionaryCodec broken; broken.loadSnapshot(file); }));
+}
+
+// Every load path refuses value IDs past the dictionary instead of counting them
+void testOutOfRangeIds() {
+    fs::path directory = freshDirectory("bad_ids");
+
+    // Snapshot: the ID section's offset is the last section in the header
+    std::string snapshot = (directory / "snapshot.bin").string();
+    codecOf(randomRows(1000, 50, 10))->saveSnapshot(snapshot);
+    {
+        std::fstream corrupt(snapshot, std::ios::in | std::ios::out | std::ios::binary);
+        uint64_t ids_section;
+        corrupt.seekg(8 + 4 + 4 + 4 * sizeof(uint64_t) + 4 * 2 * sizeof(uint64_t));
+        corrupt.read(reinterpret_cast<char*>(&ids_section), sizeof(ids_section));
+        uint32_t bad_id = 50;
+        corrupt.seekp(ids_section + 500 * sizeof(uint32_t));
+        corrupt.write(reinterpret_cast<const char*>(&bad_id), sizeof(bad_id));
+    }
+    CHECK(throwsRuntimeError([&] { DictionaryCodec broken; broken.loadSnapshot(snapshot); }));
+
+    // Files written before block compression: dictionary entries, then one zstd frame
+    std::string legacy = (directory / "legacy.bin").string();
+    {
+        std::ofstream out(legacy, std::ios::binary);
+        size_t dict_size = 2;
+        out.write(reinterpret_cast<const char*>(&dict_size), sizeof(dict_size));
+        for (uint32_t id = 0; id < dict_size; id++) {
+            std::string value = "value" + std::to_string(id);
+            size_t length = value.length();
+            out.write(reinterpret_cast<const char*>(&length), sizeof(length));
+            out.write(value.data(), length);
+            out.write(reinterpret_cast<const char*>(&id), sizeof(id));
+        }
+        std::vector<uint32_t> ids = {0, 1, 1, 0, 7};
+        std::vector<char> frame(ZSTD_compressBound(ids.size() * sizeof(uint32_t)));
+        size_t comp_size = ZSTD_compress(frame.data(), frame.size(), ids.data(), ids.size() * sizeof(uint32_t), 1);
+        out.write(reinterpret_cast<const char*>(&comp_size), sizeof(comp_size));
+        out.write(frame.data(), comp_size);
+    }
+    DictionaryCodec loaded;
+    loaded.appendValues({"before"});
+    CHECK(throwsRuntimeError([&] { loaded.loadFromFile(legacy); }));
+    // The failed load keeps the previous state, not one holding the bad IDs
+    CHECK(rowsOf(loaded) == std::vector<std::string>{"before"});
+    CHECK(loaded.getValueHistogram(0, 1) == std::vector<size_t>{1});
+    CHECK(loaded.countMatches("value0") == 0);
+
+    // Block file: the last block's ref is pointed at a frame, appended to the file, that
+    // holds an ID past the dictionary
+    std::string block_file = (directory / "block.bin").string();
+    std::vector<std::string> rows = randomRows(300000, 50, 13);  // Two blocks
+    codecOf(rows)->saveToFile(block_file);
+    {
+        std::fstream corrupt(block_file, std::ios::in | std::ios::out | std::ios::binary);
+        BlockCompression::ColumnFileHeader header;
+        corrupt.read(reinterpret_cast<char*>(&header), sizeof(header));
+        size_t last = header.num_blocks - 1;
+        std::vector<uint32_t> ids(header.num_rows - last * header.block_rows, 0);
+        ids.back() = static_cast<uint32_t>(header.dict_size);
+        std::vector<std::vector<uint8_t>> frames;
+        BlockCompression::compressBlocks(ids.data(), ids.size(), ids.size(), BlockCompression::DEFAULT_LEVEL, 1,
+                                         frames);
+        BlockCompression::BlockRef ref{fs::file_size(block_file) - header.data_offset, frames[0].size()};
+        corrupt.seekp(0, std::ios::end);
+        corrupt.write(reinterpret_cast<const char*>(frames[0].data()), frames[0].size());
+        corrupt.seekp(header.index_offset + last * sizeof(BlockCompression::BlockRef));
+        corrupt.write(reinterpret_cast<const char*>(&ref), sizeof(ref));
+    }
+    CHECK(throwsRuntimeError([&] { DictionaryCodec broken; broken.loadFromFile(block_file); }));
+    CompressedColumnReader reader(block_file, CompressedColumnReader::DEFAULT_CACHE_BYTES, 0);
+    CHECK(reader.getValue(0) == rows[0]);
+    CHECK(throwsRuntimeError([&] { reader.getValue(rows.size() - 1); }));
+    // The failed block is not left marked as loading, so it fails again instead of hanging
+    CHECK(throwsRuntimeError([&] { reader.countPrefix("value_"); }));
+}
+
+void testWriteAheadLogRecovery() {
+    fs::path directory = freshDirectory("wal");
+    fs::path crashed = freshDirectory("wal_crashed");
+    std::vector<std::string> base = randomRows(10000, 500, 7);
+    auto codec = codecOf(base);
+    // Small checkpoints, so recovery runs over a checkpointed snapshot plus a log tail
+    codec->enableWriteAheadLog(directory.string(), 16 << 10);
+
+    std::vector<std::thread> appenders;
+    for (int t = 0; t < 4; t++) {
+        appenders.emplace_back([&codec, t] {
+            for (int batch = 0; batch < 50; batch++) {
+                codec->appendValues({"thread" + std::to_string(t), "batch" + std::to_string(batch), "shared"});
+            }
+        });
+    }
+    for (auto& appender : appenders) {
+        appender.join();
+    }
+    CHECK(throwsRuntimeError([&] { codec->loadSnapshot((directory / "snapshot.bin").string()); }));
+
+    // Acknowledged appends survive a crash: copy the files while the codec is still running
+    codec->checkpoint();
+    codec->appendValues({"last", "batch"});
+    std::vector<std::string> expected = rowsOf(*codec);
+    copyState(directory, crashed);
+    DictionaryCodec recovered;
+    recovered.loadState(crashed.string());
+    CHECK(rowsOf(recovered) == expected);
+
+    // A torn final record is dropped; the records before it are kept
+    copyState(directory, crashed);
+    truncateFile(crashed / "wal.log", 3);
+    DictionaryCodec torn;
+    torn.loadState(crashed.string());
+    CHECK(rowsOf(torn) == std::vector<std::string>(expected.begin(), expected.end() - 2));
+
+    // Garbage after the last record ends the log
+    copyState(directory, crashed);
+    {
+        std::ofstream log(crashed / "wal.log", std::ios::binary | std::ios::app);
+        log << "not a record";
+    }
+    DictionaryCodec garbage;
+    garbage.loadState(crashed.string());
+    CHECK(rowsOf(garbage) == expected);
+
+    // Reopening the log cuts that tail, so new records follow the last intact one
+    {
+        WriteAheadLog log((crashed / "wal.log").string(), 1 << 30, nullptr);
+        AppendRecord record;
+        record.base_dict_size = garbage.getDictionarySize();
+        record.first_row = garbage.getDataSize();
+        record.entries = {"after reopen"};
+        record.runs = {{static_cast<uint32_t>(garbage.getDictionarySize()), 2}};
+        log.sync(log.append(record));
+    }
+    DictionaryCodec reopened;
+    reopened.loadState(crashed.string());
+    CHECK(reopened.getDataSize() == expected.size() + 2);
+    CHECK(reopened.countMatches("after reopen") == 2);
+}
+
+// Resuming the log over a recovered state must not drop the old log before the new
+// snapshot is committed: here the snapshot write fails on the file size limit
+void testWriteAheadLogResumeFailure() {
+    fs::path directory = freshDirectory("wal_resume");
+    std::vector<std::string> base = randomRows(200000, 1000, 12);
+    auto codec = codecOf(base);
+    codec->enableWriteAheadLog(directory.string());
+    codec->appendValues({"acknowledged", "before", "resume"});
+    std::vector<std::string> expected = rowsOf(*codec);
+    codec->disableWriteAheadLog();
+
+    DictionaryCodec resumed;
+    resumed.loadState(directory.string());
+    CHECK(rowsOf(resumed) == expected);
+
+    rlimit previous;
+    getrlimit(RLIMIT_FSIZE, &previous);
+    rlimit limited = previous;
+    limited.rlim_cur = 64 << 10;
+    auto previous_handler = std::signal(SIGXFSZ, SIG_IGN);
+    setrlimit(RLIMIT_FSIZE, &limited);
+    bool failed = throwsRuntimeError([&] { resumed.enableWriteAheadLog(directory.string()); });
+    setrlimit(RLIMIT_FSIZE, &previous);
+    std::signal(SIGXFSZ, previous_handler);
+    CHECK(failed);
+    CHECK(!fs::exists(directory / "wal.log.new"));
+
+    DictionaryCodec recovered;
+    recovered.loadState(directory.string());
+    CHECK(rowsOf(recovered) == expected);
+
+    // A later resume succeeds and takes over the log
+    resumed.enableWriteAheadLog(directory.string());
+    resumed.appendValues({"after", "resume"});
+    expected.insert(expected.end(), {"after", "resume"});
+    resumed.disableWriteAheadLog();
+    DictionaryCodec reloaded;
+    reloaded.loadState(directory.string());
+    CHECK(rowsOf(reloaded) == expected);
+}
+
+void testOnlineSnapshot() {
+    fs::path directory = freshDirectory("online");
+    std::vector<std::string> rows = randomRows(300000, 20000, 8);
+    auto codec = codecOf(rows);
+
+    // Appends made after the capture are not part of the snapshot
+    std::future<void> saved = codec->saveStateAsync(directory.string());
+    for (int i = 0; i < 100; i++) {
+        codec->appendValues({"later" + std::to_string(i), rows[i]});
+    }
+    saved.get();
+
+    // Leftovers of an interrupted writer do not affect the committed snapshot
+    std::ofstream(directory / "snapshot.bin.tmp.0.0") << "partial";
+    DictionaryCodec loaded;
+    loaded.loadState(directory.string());
+    CHECK(rowsOf(loaded) == rows);
+    CHECK(!loaded.exists("later0"));
+}
+
+void testArrowStream() {
+    fs::path directory = freshDirectory("arrow");
+    std::vector<std::string> rows = randomRows(100000, 3000, 9);
+    std::vector<std::string> awkward = awkwardValues(100);
+    rows.insert(rows.end(), awkward.begin(), awkward.end());
+    auto codec = codecOf(rows);
+    std::string file = (directory / "column.arrow").string();
+    codec->saveArrowStream(file);
+
+    DictionaryCodec loaded;
+    loaded.loadArrowStream(file);
+    CHECK(rowsOf(loaded) == rows);
+    CHECK(loaded.countMatches("") == 1);
+    CHECK(loaded.getReverseDictionary() == codec->getReverseDictionary());
+
+    // A malformed stream, or one with repeated dictionary values (which the value -> ID
+    // index cannot represent), is rejected before it replaces anything
+    std::string truncated = (directory / "truncated.arrow").string();
+    fs::copy_file(file, truncated);
+    truncateFile(truncated, fs::file_size(truncated) / 2);
+    std::string repeated = (directory / "repeated.arrow").string();
+    {
+        const char bytes[] = "applebananaapple";
+        const uint32_t offsets[] = {0, 5, 11, 16};
+        const uint32_t ids[] = {0, 1, 2, 2, 1, 0};
+        std::ofstream out(repeated, std::ios::binary);
+        ArrowIpc::writeDictionaryStream(out, "value", ArrowIpc::DictionaryColumnView{offsets, bytes, 3, ids, 6});
+    }
+    for (const std::string& rejected : {truncated, repeated}) {
+        CHECK(throwsRuntimeError([&] { loaded.loadArrowStream(rejected); }));
+        CHECK(loaded.isMapped());
+        CHECK(rowsOf(loaded) == rows);
+        CHECK(loaded.findMatches(rows[5]) == codec->findMatches(rows[5]));
+        CHECK(loaded.getValueHistogram() == codec->getValueHistogram());
+        CHECK(loaded.getFrequency("apple") == 0);
+        CHECK(loaded.getCompressionRatio() == codec->getCompressionRatio());
+    }
+
+    // Over an empty codec, the rejected stream leaves no rows or figures behind
+    DictionaryCodec empty;
+    CHECK(throwsRuntimeError([&] { empty.loadArrowStream(repeated); }));
+    CHECK(empty.getDataSize() == 0);
+    CHECK(empty.getDictionarySize() == 0);
+    CHECK(empty.getCompressionRatio() == DictionaryCodec().getCompressionRatio());
+    empty.appendValues({"apple", "cherry", "apple"});
+    CHECK(empty.getValueHistogram() == std::vector<size_t>({2, 1}));
+    CHECK(empty.getCompressionRatio() == codecOf({"apple", "cherry", "apple"})->getCompressionRatio());
+
+    loaded.appendValues({"apple", rows[5]});
+    rows.insert(rows.end(), {"apple", rows[5]});
+    CHECK(rowsOf(loaded) == rows);
+    CHECK(loaded.findMatches("apple") == std::vector<size_t>{rows.size() - 2});
+}
+
+void testCsvExport() {
+    fs::path directory = freshDirectory("csv");
+    std::vector<std::string> rows = randomRows(200000, 300, 14);
+    rows.insert(rows.end(), {"with,comma", "with \"quotes\"", ""});
+    auto codec = codecOf(rows);
+
+    // Rows appended while the export runs are not part of it
+    std::thread appender([&codec] {
+        for (int i = 0; i < 100; i++) {
+            codec->appendValues({"during export"});
+        }
+    });
+    codec->saveResults(directory.string(), "export", 3);
+    appender.join();
+
+    std::ifstream csv(directory / "export_results.csv");
+    std::string line;
+    std::getline(csv, line);
+    CHECK(line == "Index,Original,Encoded,Dictionary_ID");
+    std::vector<std::string> lines;
+    while (std::getline(csv, line)) {
+        lines.push_back(line);
+    }
+    size_t exported = lines.size();
+    CHECK(exported >= rows.size() && exported <= rows.size() + 100);
+    std::string id = std::to_string(codec->getDictionary().at(rows[1234]));
+    CHECK(lines[1234] == "1234," + rows[1234] + "," + id + "," + id);
+    CHECK(lines[rows.size() - 3].find(",\"with,comma\",") != std::string::npos);
+    CHECK(lines[rows.size() - 2].find(",\"with \"\"quotes\"\"\",") != std::string::npos);
+
+    std::ifstream summary(directory / "export_summary.txt");
+    std::string summary_text((std::istreambuf_iterator<char>(summary)), std::istreambuf_iterator<char>());
+    CHECK(summary_text.find("Total entries: " + std::to_string(exported) + "\n") != std::string::npos);
+}
+
+void testRewriteFrequencies() {
+    std::vector<std::string> rows;
+    for (size_t i = 0; i < 8000; i++) {
+        rows.push_back(i % 8 < 3 ? "apple" : i % 8 < 5 ? "banana" : "cherry" + std::to_string(i % 11));
+    }
+    auto codec = codecOf(rows);
+
+    // Overwrite existing rows, then run two rows past the end
+    std::vector<std::string> rewrite = {"banana", "date", "apple", "date", "date", "cherry0", "apple", "date"};
+    codec->encodeSingleThread(rewrite, 0);
+    codec->encodeSingleThread({"apple", "date"}, rows.size());
+
+    std::vector<std::string> scanned = rowsOf(*codec);
+    CHECK(scanned.size() == rows.size() + 2);
+    for (const auto& value : {"apple", "banana", "date", "cherry0", "cherry5"}) {
+        size_t expected = std::count(scanned.begin(), scanned.end(), value);
+        CHECK(codec->getFrequency(value) == expected);
+        CHECK(codec->countMatches(value) == expected);
+    }
+    CHECK(codec->getValueHistogram() == codec->getValueHistogram(0, scanned.size()));
+    CHECK(codec->getCompressionRatio() == codecOf(scanned)->getCompressionRatio());
+
+    CHECK(throwsRuntimeError([&] { codec->encodeSingleThread({"gap"}, scanned.size() + 1); }));
+}
+
+void testCachedResultExtension() {
+    auto codec = codecOf(randomRows(20000, 40, 11));
+    codec->enableResultCache(64 << 20);
+    std::string value = "value_7";
+
+    // Unshared results are extended in place; one a caller still holds is left as it was
+    std::shared_ptr<const ResultSet> held = codec->findMatchesCached(value);
+    std::vector<uint32_t> held_positions;
+    held->toPositions(held_positions);
+    const ResultSet* previous = nullptr;
+    for (int round = 0; round < 50; round++) {
+        codec->appendValues({value, "other", value});
+        std::shared_ptr<const ResultSet> extended = codec->findMatchesCached(value);
+        CHECK(extended->size() == codec->countMatches(value));
+        CHECK(extended->getNumRows() == codec->getDataSize());
+        CHECK(extended.get() != held.get());
+        CHECK(round == 0 || extended.get() == previous);
+        previous = extended.get();
+    }
+    std::vector<uint32_t> positions;
+    held->toPositions(positions);
+    CHECK(positions == held_positions);
+    CHECK(held->getNumRows() == 20000);
+
+    std::vector<uint32_t> expected;
+    codec->findMatchesInto(value, expected);
+    codec->findMatchesCached(value)->toPositions(positions);
+    CHECK(positions == expected);
+}
+
+}  // namespace
+
+int main() {
+    std::vector<std::pair<const char*, std::function<void()>>> tests = {
+        {"block column round trip", testBlockColumnRoundTrip},
+        {"failed load keeps state", testFailedLoadKeepsState},
+        {"failed snapshot load keeps state", testFailedSnapshotLoadKeepsState},
+        {"block filters", testBlockFilters},
+        {"front-coded dictionary", testFrontCodedDictionary},
+        {"lazy index load", testLazyIndexLoad},
+        {"snapshot round trip", testSnapshotRoundTrip},
+        {"out-of-range IDs", testOutOfRangeIds},
+        {"write-ahead log recovery", testWriteAheadLogRecovery},
+        {"write-ahead log resume failure", testWriteAheadLogResumeFailure},
+        {"online snapshot", testOnlineSnapshot},
+        {"arrow stream", testArrowStream},
+        {"csv export", testCsvExport},
+        {"rewrite frequencies", testRewriteFrequencies},
+        {"cached result extension", testCachedResultExtension},
+    };
+    for (const auto& [name, test] : tests) {
+        int before = failures;
+        try {
+            test();
+        } catch (const std::exception& e) {
+            std::cerr << name << ": unexpected exception: " << e.what() << "\n";
+            failures++;
+        }
+        std::cout << (failures == before ? "PASS " : "FAIL ") << name << "\n";
+    }
+    fs::remove_all(fs::temp_directory_path() / "dictionary_codec_tests");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,939 @@
+#include "dictionary_codec.h"
+#include "query_executor.h"
+#include "shared_scan.h"
+#include "set_operations.h"
+#include "result_set.h"
+#include <iostream>
+#include <future>
+#include <chrono>
+#include <filesystem>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <functional>
+#include <random>
+#include <vector>
+#include <set>
+#include <map>
+#include <limits>
+#include <algorithm>
+#include <iterator>
+
+// Behavioural checks for the query paths, each compared against a plain reference:
+// std::set_intersection and friends for the SIMD set operations, and findMatches /
+// baselinePrefixSearch for the codec's searches. Run with `make test`.
+
+namespace fs = std::filesystem;
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(condition) check((condition), #condition, __FILE__, __LINE__)
+
+void check(bool ok, const char* condition, const char* file, int line) {
+    if (!ok) {
+        std::cerr << file << ":" << line << ": check failed: " << condition << "\n";
+        failures++;
+    }
+}
+
+std::unique_ptr<DictionaryCodec> codecOf(const std::vector<std::string>& rows) {
+    auto codec = std::make_unique<DictionaryCodec>();
+    codec->appendValues(rows);
+    return codec;
+}
+
+std::vector<std::string> randomRows(size_t count, size_t distinct, uint32_t seed) {
+    std::mt19937 gen(seed);
+    std::uniform_int_distribution<size_t> pick(0, distinct - 1);
+    std::vector<std::string> rows(count);
+    for (auto& row : rows) {
+        row = "value_" + std::to_string(pick(gen));
+    }
+    return rows;
+}
+
+std::vector<uint32_t> narrowed(const std::vector<size_t>& positions) {
+    return std::vector<uint32_t>(positions.begin(), positions.end());
+}
+
+// Every row baselinePrefixSearch finds for prefix, in row order
+std::vector<uint32_t> prefixBaseline(const DictionaryCodec& codec, const std::string& prefix) {
+    std::vector<uint32_t> expected;
+    for (const auto& [value, positions] : codec.baselinePrefixSearch(prefix)) {
+        expected.insert(expected.end(), positions.begin(), positions.end());
+    }
+    std::sort(expected.begin(), expected.end());
+    return expected;
+}
+
+// The positions in [begin_row, end_row), as the row-range queries should return them
+std::vector<uint32_t> inWindow(const std::vector<size_t>& positions, size_t begin_row, size_t end_row) {
+    std::vector<uint32_t> window;
+    for (size_t position : positions) {
+        if (position >= begin_row && position < end_row) {
+            window.push_back(static_cast<uint32_t>(position));
+        }
+    }
+    return window;
+}
+
+// Row windows with unaligned edges, a single row, an empty one and one past the end
+const std::vector<std::pair<size_t, size_t>> WINDOWS = {
+    {0, std::numeric_limits<size_t>::max()}, {0, 1}, {17, 4113}, {4096, 4104}, {50000, 50000}, {60000, 100000}, {500, 100},
+    {1000000, 2000000},
+};
+
+// `count` distinct sorted positions drawn from [0, universe)
+std::vector<uint32_t> sortedSample(size_t count, size_t universe, std::mt19937& gen) {
+    count = std::min(count, universe);
+    std::set<uint32_t> picked;
+    if (count * 2 > universe) {
+        // Dense: drop random positions from the full range instead
+        std::vector<uint32_t> all(universe);
+        for (size_t i = 0; i < universe; i++) {
+            all[i] = static_cast<uint32_t>(i);
+        }
+        std::shuffle(all.begin(), all.end(), gen);
+        all.resize(count);
+        std::sort(all.begin(), all.end());
+        return all;
+    }
+    std::uniform_int_distribution<uint32_t> pick(0, static_cast<uint32_t>(universe - 1));
+    while (picked.size() < count) {
+        picked.insert(pick(gen));
+    }
+    return std::vector<uint32_t>(picked.begin(), picked.end());
+}
+
+struct SetCase {
+    std::vector<uint32_t> a;
+    std::vector<uint32_t> b;
+    size_t universe;
+};
+
+std::vector<SetCase> setCases() {
+    std::mt19937 gen(21);
+    std::vector<SetCase> cases;
+    // Empty inputs and every length around the 8-lane block boundary
+    std::vector<size_t> sizes = {0, 1, 2, 7, 8, 9, 15, 16, 17, 31, 33, 100};
+    for (size_t a_size : sizes) {
+        for (size_t b_size : sizes) {
+            for (size_t universe : {64, 1000}) {
+                cases.push_back({sortedSample(a_size, universe, gen), sortedSample(b_size, universe, gen), universe});
+            }
+        }
+    }
+    // Skewed sizes take the galloping path, in both argument orders
+    for (size_t small : {1, 5, 40}) {
+        std::vector<uint32_t> large = sortedSample(small * SetOperations::GALLOP_RATIO * 4, 1 << 20, gen);
+        std::vector<uint32_t> probe = sortedSample(small, 1 << 20, gen);
+        // Half the probes are taken from the large side, so there is something to find
+        for (size_t i = 0; i < probe.size(); i += 2) {
+            probe[i] = large[(i * 37) % large.size()];
+        }
+        std::sort(probe.begin(), probe.end());
+        probe.erase(std::unique(probe.begin(), probe.end()), probe.end());
+        cases.push_back({probe, large, 1 << 20});
+        cases.push_back({large, probe, 1 << 20});
+    }
+    // Dense inputs, which ResultSet stores as bitmaps
+    for (size_t universe : {100, 4096, 100000}) {
+        cases.push_back({sortedSample(universe * 3 / 4, universe, gen), sortedSample(universe / 2, universe, gen),
+                         universe});
+        cases.push_back({sortedSample(universe, universe, gen), sortedSample(universe / 3, universe, gen), universe});
+    }
+    // Identical inputs and long overlapping runs
+    std::vector<uint32_t> run(5000);
+    for (size_t i = 0; i < run.size(); i++) {
+        run[i] = static_cast<uint32_t>(i * 2);
+    }
+    cases.push_back({run, run, 10000});
+    cases.push_back({run, std::vector<uint32_t>(run.begin() + 1000, run.end() - 1000), 10000});
+    return cases;
+}
+
+using ListOp = void (*)(const std::vector<uint32_t>&, const std::vector<uint32_t>&, std::vector<uint32_t>&);
+using ResultOp = ResultSet (*)(const ResultSet&, const ResultSet&);
+using BitmapOp = void (*)(const std::vector<uint64_t>&, const std::vector<uint64_t>&, std::vector<uint64_t>&);
+
+struct NamedOp {
+    ListOp list;
+    ResultOp result;
+    BitmapOp bitmap;
+    std::function<std::vector<uint32_t>(const std::vector<uint32_t>&, const std::vector<uint32_t>&)> reference;
+};
+
+std::vector<NamedOp> setOps() {
+    auto apply = [](auto algorithm) {
+        return [algorithm](const std::vector<uint32_t>& a, const std::vector<uint32_t>& b) {
+            std::vector<uint32_t> out;
+            algorithm(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(out));
+            return out;
+        };
+    };
+    using It = std::vector<uint32_t>::const_iterator;
+    using Out = std::back_insert_iterator<std::vector<uint32_t>>;
+    return {
+        {SetOperations::intersect, SetOperations::intersect, SetOperations::intersectBitmaps,
+         apply(std::set_intersection<It, It, Out>)},
+        {SetOperations::unite, SetOperations::unite, SetOperations::uniteBitmaps, apply(std::set_union<It, It, Out>)},
+        {SetOperations::subtract, SetOperations::subtract, SetOperations::subtractBitmaps,
+         apply(std::set_difference<It, It, Out>)},
+    };
+}
+
+void testSetOperations() {
+    const ResultEncoding encodings[] = {ResultEncoding::Positions, ResultEncoding::DeltaVarint,
+                                        ResultEncoding::Bitmap};
+    std::vector<uint32_t> out;
+    for (const auto& op : setOps()) {
+        for (const auto& c : setCases()) {
+            std::vector<uint32_t> expected = op.reference(c.a, c.b);
+
+            // Stale contents of the output buffer must not leak into the result
+            out.assign(3, 7);
+            op.list(c.a, c.b, out);
+            CHECK(out == expected);
+
+            for (ResultEncoding a_encoding : encodings) {
+                for (ResultEncoding b_encoding : encodings) {
+                    ResultSet combined = op.result(ResultSet(c.a, c.universe, a_encoding),
+                                                   ResultSet(c.b, c.universe, b_encoding));
+                    combined.toPositions(out);
+                    CHECK(out == expected);
+                    CHECK(combined.size() == expected.size());
+                    CHECK(combined.getNumRows() == c.universe);
+                }
+            }
+
+            // Bitmaps of different lengths: the shorter one is zero-extended
+            std::vector<uint64_t> a_bits;
+            std::vector<uint64_t> b_bits;
+            std::vector<uint64_t> bits;
+            size_t b_rows = c.universe / 2 + 1;
+            std::vector<uint32_t> b_low(c.b.begin(), std::lower_bound(c.b.begin(), c.b.end(), b_rows));
+            ResultConversions::positionsToBitmap(c.a.data(), c.a.size(), c.universe, a_bits);
+            ResultConversions::positionsToBitmap(b_low.data(), b_low.size(), b_rows, b_bits);
+            op.bitmap(a_bits, b_bits, bits);
+            ResultConversions::bitmapToPositions(bits.data(), bits.size(), out);
+            CHECK(out == op.reference(c.a, b_low));
+        }
+    }
+}
+
+void testResultSetEncodings() {
+    std::mt19937 gen(22);
+    const size_t num_rows = 200000;
+    std::vector<std::vector<uint32_t>> shapes = {
+        {},
+        {0},
+        {static_cast<uint32_t>(num_rows - 1)},
+        sortedSample(300, num_rows, gen),             // Sparse
+        sortedSample(num_rows * 3 / 5, num_rows, gen),  // Dense
+    };
+    // Run-heavy: long runs of consecutive rows with gaps past one varint byte
+    std::vector<uint32_t> runs;
+    for (uint32_t start = 5; start + 1000 < num_rows; start += 1000 + gen() % 5000) {
+        for (uint32_t row = start; row < start + 1000; row++) {
+            runs.push_back(row);
+        }
+    }
+    shapes.push_back(runs);
+
+    const ResultEncoding encodings[] = {ResultEncoding::Positions, ResultEncoding::DeltaVarint,
+                                        ResultEncoding::Bitmap};
+    std::vector<uint32_t> out;
+    std::vector<uint64_t> bits;
+    std::vector<uint64_t> expected_bits;
+    for (const auto& positions : shapes) {
+        ResultConversions::positionsToBitmap(positions.data(), positions.size(), num_rows, expected_bits);
+        ResultSet chosen(positions, num_rows);
+        CHECK(chosen.getEncoding() == ResultSet::chooseEncoding(positions.size(), num_rows));
+        for (ResultEncoding encoding : encodings) {
+            ResultSet set(positions, num_rows, encoding);
+            CHECK(set.getEncoding() == encoding);
+            CHECK(set.size() == positions.size());
+            set.toPositions(out);
+            CHECK(out == positions);
+            set.toBitmap(bits);
+            CHECK(bits == expected_bits);
+            for (ResultEncoding target : encodings) {
+                ResultSet converted = set.convertTo(target);
+                CHECK(converted.getEncoding() == target);
+                converted.toPositions(out);
+                CHECK(out == positions);
+            }
+            for (size_t i = 0; i < positions.size(); i += 97) {
+                CHECK(set.contains(positions[i]));
+                CHECK(positions[i] == 0 || set.contains(positions[i] - 1) == std::binary_search(
+                          positions.begin(), positions.end(), positions[i] - 1));
+            }
+            CHECK(ResultSet::fromBitmap(expected_bits, num_rows).size() == positions.size());
+
+            // Split in two and appended back, as the result cache extends results
+            size_t half = positions.size() / 2;
+            size_t split_rows = half > 0 ? positions[half - 1] + 1 : 0;
+            ResultSet grown(std::vector<uint32_t>(positions.begin(), positions.begin() + half), split_rows, encoding);
+            grown.append(positions.data() + half, positions.size() - half, num_rows);
+            grown.toPositions(out);
+            CHECK(out == positions);
+            CHECK(grown.getNumRows() == num_rows);
+        }
+    }
+
+    // Positions past the column are refused rather than encoded
+    bool refused = false;
+    try {
+        ResultSet past(std::vector<uint32_t>{10}, 10);
+    } catch (const std::out_of_range&) {
+        refused = true;
+    }
+    CHECK(refused);
+}
+
+void testSearchResults() {
+    std::vector<std::string> rows = randomRows(100000, 300, 23);
+    rows.insert(rows.end(), 50000, "value_7");  // A dense tail, stored as a bitmap
+    auto codec = codecOf(rows);
+    std::vector<uint32_t> out;
+    for (const std::string target : {"value_7", "value_150", "missing"}) {
+        ResultSet result = codec->findMatchesResult(target);
+        CHECK(result.getNumRows() == rows.size());
+        result.toPositions(out);
+        CHECK(out == narrowed(codec->findMatches(target)));
+
+        codec->findMatchesResult(target, 1000, 60000).toPositions(out);
+        CHECK(out == inWindow(codec->findMatches(target), 1000, 60000));
+    }
+    for (const std::string prefix : {"value_1", "value_", "", "zzz"}) {
+        codec->prefixSearchResult(prefix).toPositions(out);
+        CHECK(out == prefixBaseline(*codec, prefix));
+    }
+
+    // The positions and the row count are read together, so a result never outlives
+    // the column it was computed over, even while a smaller one is loaded meanwhile
+    fs::path directory = fs::temp_directory_path() / "dictionary_codec_query_tests";
+    fs::create_directories(directory);
+    std::string large = (directory / "large.bin").string();
+    std::string small = (directory / "small.bin").string();
+    codec->saveSnapshot(large);
+    codecOf({"value_7", "other"})->saveSnapshot(small);
+    std::atomic<bool> done{false};
+    std::thread loader([&] {
+        for (int i = 0; i < 200; i++) {
+            codec->loadSnapshot(i % 2 ? large : small);
+        }
+        done = true;
+    });
+    while (!done) {
+        ResultSet result = codec->findMatchesResult("value_7");
+        CHECK(result.getNumRows() == 2 || result.getNumRows() == rows.size());
+        CHECK(result.size() <= result.getNumRows());
+    }
+    loader.join();
+    fs::remove_all(directory);
+}
+
+void testQueryExecutor() {
+    // Four slices of 100 values, so a prefix scan is a Long query
+    std::vector<std::string> rows = randomRows(4 * QueryExecutor::SLICE_ROWS, 100, 24);
+    auto codec = codecOf(rows);
+    QueryExecutor executor(*codec, 1);
+
+    auto found = executor.findMatchesAsync("value_3");
+    auto prefixed = executor.prefixSearchAsync("value_1");
+    auto counted = executor.countPrefixAsync("value_1");
+    CHECK(found.get() == narrowed(codec->findMatches("value_3")));
+    CHECK(prefixed.get() == prefixBaseline(*codec, "value_1"));
+    CHECK(counted.get() == codec->countPrefix("value_1"));
+    CHECK(executor.findMatchesAsync("missing").get().empty());
+
+    // With a single worker, a count submitted behind a Long scan runs at its next slice
+    // boundary, while the scan still has slices queued
+    auto slow = executor.prefixSearchAsync("value_");
+    while (executor.getQueuedCount(QueryClass::Long) == 0 && executor.getRunningCount(QueryClass::Long) == 0) {
+        std::this_thread::yield();
+    }
+    auto quick = executor.countMatchesAsync("value_5");
+    CHECK(quick.get() == codec->countMatches("value_5"));
+    CHECK(slow.wait_for(std::chrono::seconds(0)) != std::future_status::ready);
+    CHECK(slow.get().size() == rows.size());
+
+    // A cancelled scan stops at a slice boundary
+    CancellationToken token;
+    auto cancelled = executor.prefixSearchAsync("value_", token);
+    token.cancel();
+    bool stopped = false;
+    try {
+        cancelled.get();
+    } catch (const QueryCancelled&) {
+        stopped = true;
+    }
+    CHECK(stopped);
+
+    // A selective scan over a small column is Short and never enters the Long queue
+    auto small = codecOf(randomRows(1000, 100, 25));
+    QueryExecutor small_executor(*small, 1);
+    small_executor.setClassLimits(QueryClass::Long, 1, 0);
+    CHECK(small_executor.findMatchesAsync("value_3").get() == narrowed(small->findMatches("value_3")));
+
+    // A shorter column loaded between submission and planning: the plan scans the rows of
+    // the column it resolved its IDs in, never up to the row count seen at submission
+    fs::path directory = fs::temp_directory_path() / "dictionary_codec_query_executor_tests";
+    fs::create_directories(directory);
+    std::string large_file = (directory / "large.bin").string();
+    std::string small_file = (directory / "small.bin").string();
+    codec->saveSnapshot(large_file);
+    codecOf({"value_3", "other", "value_3"})->saveSnapshot(small_file);
+    std::vector<uint32_t> large_matches = narrowed(codec->findMatches("value_3"));
+    DictionaryCodec reloaded;
+    QueryExecutor reload_executor(reloaded, 1);
+    for (int i = 0; i < 100; i++) {
+        reloaded.loadSnapshot(large_file);
+        auto pending = reload_executor.findMatchesAsync("value_3");
+        reloaded.loadSnapshot(small_file);
+        try {
+            std::vector<uint32_t> matches = pending.get();
+            CHECK(matches == std::vector<uint32_t>({0, 2}) || matches == large_matches);
+        } catch (const std::runtime_error&) {
+            // Planned over the large column, then failed once it was replaced
+        }
+    }
+    fs::remove_all(directory);
+}
+
+void testSharedScan() {
+    // 64 scan blocks, so later queries attach to a scan in progress and wrap around
+    std::vector<std::string> rows = randomRows(64 * SharedScanScheduler::SCAN_BLOCK_ROWS, 200, 26);
+    auto codec = codecOf(rows);
+    std::vector<std::string> targets;
+    std::vector<std::string> prefixes;
+    std::vector<std::vector<size_t>> target_matches;
+    std::vector<std::vector<size_t>> prefix_matches;
+    for (int i = 0; i < 8; i++) {
+        targets.push_back("value_" + std::to_string(i * 23));
+        target_matches.push_back(codec->findMatches(targets.back()));
+        prefixes.push_back("value_" + std::to_string(i + 1));
+        std::vector<uint32_t> expected = prefixBaseline(*codec, prefixes.back());
+        prefix_matches.emplace_back(expected.begin(), expected.end());
+    }
+
+    {
+        SharedScanScheduler scheduler(*codec, std::chrono::microseconds(0));
+        std::vector<std::thread> threads;
+        std::atomic<int> wrong{0};
+        for (int t = 0; t < 8; t++) {
+            threads.emplace_back([&, t] {
+                // Staggered, so each thread joins the circular scan at a different block
+                while (scheduler.getBlocksScanned() < static_cast<size_t>(t) * 5) {
+                    std::this_thread::yield();
+                }
+                for (int i = 0; i < 8; i++) {
+                    size_t q = (t + i) % 8;
+                    bool ok = i % 2 ? scheduler.prefixMatches(prefixes[q]) == prefix_matches[q]
+                                    : scheduler.findMatches(targets[q]) == target_matches[q];
+                    wrong += !ok;
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        CHECK(wrong == 0);
+        CHECK(scheduler.getQueriesServed() == 64);
+        // Shared: far fewer blocks than 64 separate full scans
+        CHECK(scheduler.getBlocksScanned() < 64 * 64);
+        CHECK(scheduler.prefixMatches("").empty());
+        CHECK(scheduler.findMatches("missing").empty());
+    }
+
+    // Appended rows, ending mid-block and adding new values, are scanned by queries
+    // submitted after the append, concurrently as before
+    {
+        SharedScanScheduler scheduler(*codec, std::chrono::microseconds(0));
+        scheduler.findMatches(targets[0]);
+        codec->appendValues(randomRows(1000, 250, 27));
+        targets.push_back("value_230");
+        prefixes.push_back("value_24");
+        target_matches.resize(targets.size());
+        prefix_matches.resize(prefixes.size());
+        for (size_t q = 0; q < targets.size(); q++) {
+            target_matches[q] = codec->findMatches(targets[q]);
+            std::vector<uint32_t> expected = prefixBaseline(*codec, prefixes[q]);
+            prefix_matches[q].assign(expected.begin(), expected.end());
+        }
+        CHECK(!target_matches.back().empty() && target_matches.back().front() >= rows.size());
+
+        std::vector<std::thread> threads;
+        std::atomic<int> wrong{0};
+        for (size_t t = 0; t < targets.size(); t++) {
+            threads.emplace_back([&, t] {
+                wrong += scheduler.findMatches(targets[t]) != target_matches[t];
+                wrong += scheduler.prefixMatches(prefixes[t]) != prefix_matches[t];
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        CHECK(wrong == 0);
+    }
+
+    // A query planned before a rewrite fails instead of scanning with stale IDs; the long
+    // batch window keeps it waiting to attach until the rewrite has landed
+    {
+        SharedScanScheduler scheduler(*codec, std::chrono::milliseconds(300));
+        std::future<std::vector<size_t>> stale = std::async(std::launch::async, [&] {
+            return scheduler.prefixMatches("value_1");
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        codec->encodeSingleThread({"value_1", "rewritten"}, 0);
+        bool failed = false;
+        try {
+            stale.get();
+        } catch (const std::runtime_error&) {
+            failed = true;
+        }
+        CHECK(failed);
+        // Queries planned after the rewrite see the new rows
+        CHECK(scheduler.findMatches("rewritten") == std::vector<size_t>{1});
+    }
+}
+
+// Whether complete(prefix, k) is a top-k of rows by frequency: the same counts in the same
+// order as a brute-force ranking, each reported correctly. Tied values may come in any order
+bool completesLike(const DictionaryCodec& codec, const std::vector<std::string>& rows,
+                   const std::string& prefix, size_t k) {
+    std::map<std::string, size_t> counts;
+    for (const auto& row : rows) {
+        if (row.compare(0, prefix.length(), prefix) == 0) {
+            counts[row]++;
+        }
+    }
+    std::vector<size_t> expected;
+    for (const auto& [value, count] : counts) {
+        expected.push_back(count);
+    }
+    std::sort(expected.begin(), expected.end(), std::greater<size_t>());
+    expected.resize(std::min({k, expected.size(), CompletionIndex::NODE_TOP_K}));
+
+    std::vector<size_t> reported;
+    std::set<std::string> seen;
+    for (const auto& [value, count] : codec.complete(prefix, k)) {
+        auto it = counts.find(value);
+        if (it == counts.end() || it->second != count || !seen.insert(value).second) {
+            return false;
+        }
+        reported.push_back(count);
+    }
+    return reported == expected;
+}
+
+void testCompletion() {
+    std::vector<std::string> rows = randomRows(20000, 3000, 29);
+    rows.insert(rows.end(), 400, "value_17");
+    rows.insert(rows.end(), 250, "value_1999");
+    auto codec = codecOf(rows);
+    std::vector<std::string> prefixes = {"value_1", "value_12", "value_", "", "value_2999", "zzz"};
+    std::vector<size_t> ks = {0, 1, 5, CompletionIndex::NODE_TOP_K, 40};
+    auto allComplete = [&] {
+        bool ok = true;
+        for (const auto& prefix : prefixes) {
+            for (size_t k : ks) {
+                ok = completesLike(*codec, rows, prefix, k) && ok;
+            }
+        }
+        return ok;
+    };
+    // Rankings trail changes by one background rebuild, so wait for it to land
+    auto eventuallyComplete = [&] {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (!allComplete()) {
+            if (std::chrono::steady_clock::now() > deadline) {
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        return true;
+    };
+
+    // Before any index exists the dictionary is ranked directly, and then from the index
+    CHECK(allComplete());
+    CHECK(eventuallyComplete());
+    for (int i = 0; i < 10; i++) {
+        CHECK(allComplete());
+    }
+
+    // Appends shift the ranking and add values inside an indexed prefix
+    std::vector<std::string> appended(600, "value_1234");
+    appended.insert(appended.end(), 300, "value_1new");
+    codec->appendValues(appended);
+    rows.insert(rows.end(), appended.begin(), appended.end());
+    CHECK(eventuallyComplete());
+
+    // A rewrite drops the old rows' counts and starts a new epoch
+    std::vector<std::string> rewritten(5000, "value_12x");
+    codec->encodeSingleThread(rewritten, 1000);
+    std::copy(rewritten.begin(), rewritten.end(), rows.begin() + 1000);
+    CHECK(eventuallyComplete());
+}
+
+void testCounts() {
+    std::vector<std::string> rows = randomRows(50000, 500, 31);
+    rows.insert(rows.end(), 20000, "value_3");
+    auto codec = codecOf(rows);
+    auto checkCounts = [&] {
+        for (const std::string target : {"value_3", "value_42", "value_499", "missing", ""}) {
+            std::vector<size_t> expected = codec->findMatches(target);
+            CHECK(codec->countMatches(target) == expected.size());
+            CHECK(codec->exists(target) == !expected.empty());
+            for (auto [begin_row, end_row] : WINDOWS) {
+                std::vector<uint32_t> window = inWindow(expected, begin_row, end_row);
+                CHECK(codec->countMatches(target, begin_row, end_row) == window.size());
+                CHECK(codec->exists(target, begin_row, end_row) == !window.empty());
+            }
+        }
+        for (const std::string prefix : {"value_1", "value_49", "value_", "", "zzz"}) {
+            std::vector<uint32_t> expected = prefixBaseline(*codec, prefix);
+            CHECK(codec->countPrefix(prefix) == expected.size());
+            for (auto [begin_row, end_row] : WINDOWS) {
+                std::vector<size_t> wide(expected.begin(), expected.end());
+                CHECK(codec->countPrefix(prefix, begin_row, end_row) == inWindow(wide, begin_row, end_row).size());
+            }
+        }
+    };
+    checkCounts();
+
+    // Appended rows count, including a value new to the dictionary
+    codec->appendValues({"value_42", "value_1new", "value_3"});
+    checkCounts();
+    CHECK(codec->exists("value_1new"));
+    CHECK(codec->exists("value_1new", rows.size(), std::numeric_limits<size_t>::max()));
+    CHECK(!codec->exists("value_1new", 0, rows.size()));
+}
+
+void testHistograms() {
+    std::vector<std::string> rows = randomRows(120000, 40, 32);
+    rows.insert(rows.end(), 5000, "value_rare");
+    auto codec = codecOf(rows);
+    auto checkWindow = [&](size_t begin_row, size_t end_row, int threads) {
+        size_t first = std::min(begin_row, rows.size());
+        size_t last = std::max(first, std::min(end_row, rows.size()));
+        std::map<std::string, size_t> expected;
+        for (size_t row = first; row < last; row++) {
+            expected[rows[row]]++;
+        }
+
+        std::vector<size_t> histogram = codec->getValueHistogram(begin_row, end_row, threads);
+        CHECK(histogram.size() == codec->getDictionarySize());
+        std::vector<size_t> counts;
+        for (size_t count : histogram) {
+            if (count > 0) {
+                counts.push_back(count);
+            }
+        }
+        std::vector<size_t> expected_counts;
+        for (const auto& [value, count] : expected) {
+            expected_counts.push_back(count);
+        }
+        std::sort(counts.begin(), counts.end());
+        std::sort(expected_counts.begin(), expected_counts.end());
+        CHECK(counts == expected_counts);
+
+        // Every group's count is its findMatches rows inside the window, largest first
+        auto top = codec->getTopFrequentValues(expected.size() + 5, begin_row, end_row, threads);
+        CHECK(top.size() == expected.size());
+        for (size_t i = 0; i < top.size(); i++) {
+            const auto& [value, count] = top[i];
+            CHECK(count == inWindow(codec->findMatches(value), begin_row, end_row).size());
+            CHECK(i == 0 || top[i - 1].second >= count);
+        }
+        auto best = codec->getTopFrequentValues(3, begin_row, end_row, threads);
+        CHECK(best.size() == std::min<size_t>(3, top.size()));
+        for (size_t i = 0; i < best.size(); i++) {
+            CHECK(best[i].second == top[i].second);
+        }
+    };
+    for (int threads : {1, 4, 0}) {
+        for (auto [begin_row, end_row] : WINDOWS) {
+            checkWindow(begin_row, end_row, threads);
+        }
+        checkWindow(110000, rows.size(), threads);
+    }
+    CHECK(codec->getValueHistogram() == codec->getValueHistogram(0, rows.size()));
+    CHECK(codec->getTopFrequentValues(5) == codec->getTopFrequentValues(5, 0, rows.size()));
+
+    // Appended rows join their groups, including a group new to the dictionary
+    std::vector<std::string> appended(3000, "value_rare");
+    appended.insert(appended.end(), 100, "value_new");
+    codec->appendValues(appended);
+    rows.insert(rows.end(), appended.begin(), appended.end());
+    checkWindow(0, rows.size(), 0);
+    checkWindow(115000, std::numeric_limits<size_t>::max(), 4);
+    CHECK(codec->getValueHistogram() == codec->getValueHistogram(0, rows.size()));
+    CHECK(codec->getFrequency("value_rare") == 8000);
+    CHECK(codec->getFrequency("value_new") == 100);
+}
+
+// The rows of a grouped prefix search, in row order
+std::vector<uint32_t> flattened(const std::vector<std::pair<std::string, std::vector<size_t>>>& groups) {
+    std::vector<uint32_t> rows;
+    for (const auto& [value, positions] : groups) {
+        rows.insert(rows.end(), positions.begin(), positions.end());
+    }
+    std::sort(rows.begin(), rows.end());
+    return rows;
+}
+
+void testRowRanges() {
+    std::vector<std::string> rows = randomRows(70000, 300, 33);
+    auto codec = codecOf(rows);
+    auto checkRanges = [&] {
+        for (const std::string target : {"value_5", "value_250", "missing"}) {
+            std::vector<size_t> expected = codec->findMatches(target);
+            for (auto [begin_row, end_row] : WINDOWS) {
+                CHECK(narrowed(codec->findMatchesSIMD(target, begin_row, end_row)) ==
+                      inWindow(expected, begin_row, end_row));
+            }
+        }
+        for (const std::string prefix : {"value_2", "value_", "zzz"}) {
+            std::vector<uint32_t> baseline = prefixBaseline(*codec, prefix);
+            std::vector<size_t> expected(baseline.begin(), baseline.end());
+            std::set<std::string> values;
+            for (const auto& group : codec->baselinePrefixSearch(prefix)) {
+                values.insert(group.first);
+            }
+            for (auto [begin_row, end_row] : WINDOWS) {
+                // One group per matching value, as in the baseline, even when it is empty here
+                auto groups = codec->prefixSearchSIMD(prefix, begin_row, end_row);
+                CHECK(flattened(groups) == inWindow(expected, begin_row, end_row));
+                std::set<std::string> grouped;
+                for (const auto& [value, positions] : groups) {
+                    grouped.insert(value);
+                    CHECK(narrowed(positions) == inWindow(codec->findMatches(value), begin_row, end_row));
+                }
+                CHECK(grouped == values);
+            }
+        }
+    };
+    checkRanges();
+
+    // Windows reaching past the old end pick up appended rows
+    std::vector<std::string> appended = randomRows(5000, 400, 34);
+    codec->appendValues(appended);
+    checkRanges();
+    CHECK(narrowed(codec->findMatchesSIMD("value_399", rows.size(), std::numeric_limits<size_t>::max())) ==
+          inWindow(codec->findMatches("value_399"), rows.size(), std::numeric_limits<size_t>::max()));
+}
+
+void testStreamingSearches() {
+    std::vector<std::string> rows = randomRows(90000, 50, 35);
+    auto codec = codecOf(rows);
+    // Every row a sink receives, checking the chunks arrive in ascending order
+    auto collect = [](auto scan) {
+        std::vector<uint32_t> received;
+        bool ascending = true;
+        scan([&](const uint32_t* chunk, size_t count) {
+            for (size_t i = 0; i < count; i++) {
+                ascending = ascending && (received.empty() || received.back() < chunk[i]);
+                received.push_back(chunk[i]);
+            }
+            return true;
+        });
+        CHECK(ascending);
+        return received;
+    };
+    auto checkStreams = [&] {
+        std::vector<uint32_t> out = {7, 7, 7};  // Stale contents are replaced
+        for (const std::string target : {"value_3", "value_49", "missing"}) {
+            std::vector<size_t> expected = codec->findMatches(target);
+            for (auto [begin_row, end_row] : WINDOWS) {
+                std::vector<uint32_t> window = inWindow(expected, begin_row, end_row);
+                CHECK(collect([&](const MatchSink& sink) {
+                    codec->scanMatches(target, sink, begin_row, end_row);
+                }) == window);
+                CHECK(codec->findMatchesInto(target, out, begin_row, end_row) == window.size());
+                CHECK(out == window);
+            }
+        }
+        for (const std::string prefix : {"value_1", "value_", "", "zzz"}) {
+            std::vector<uint32_t> baseline = prefixBaseline(*codec, prefix);
+            std::vector<size_t> expected(baseline.begin(), baseline.end());
+            for (auto [begin_row, end_row] : WINDOWS) {
+                std::vector<uint32_t> window = inWindow(expected, begin_row, end_row);
+                CHECK(collect([&](const MatchSink& sink) {
+                    codec->scanPrefix(prefix, sink, begin_row, end_row);
+                }) == window);
+                CHECK(codec->prefixSearchInto(prefix, out, begin_row, end_row) == window.size());
+                CHECK(out == window);
+            }
+        }
+    };
+    checkStreams();
+
+    // A sink returning false is not called again, and has seen the leading matches
+    std::vector<uint32_t> expected = prefixBaseline(*codec, "value_");
+    std::vector<uint32_t> received;
+    bool called_after_stop = false;
+    codec->scanPrefix("value_", [&](const uint32_t* chunk, size_t count) {
+        called_after_stop = called_after_stop || received.size() >= 100;
+        received.insert(received.end(), chunk, chunk + count);
+        return received.size() < 100;
+    });
+    CHECK(!called_after_stop);
+    CHECK(received.size() >= 100 && received.size() < expected.size());
+    CHECK(std::equal(received.begin(), received.end(), expected.begin()));
+
+    codec->appendValues(randomRows(3000, 60, 36));
+    checkStreams();
+}
+
+// Every page of a paginated search from cursor, concatenated; pages never exceed limit
+template <typename PageFn>
+std::vector<uint32_t> allPages(SearchCursor cursor, size_t limit, PageFn page) {
+    std::vector<uint32_t> rows;
+    std::vector<uint32_t> out;
+    for (int pages = 0; !cursor.done && pages < 1000000; pages++) {
+        size_t returned = page(cursor, limit, out);
+        CHECK(returned == out.size() && returned <= limit);
+        rows.insert(rows.end(), out.begin(), out.end());
+    }
+    CHECK(cursor.done);
+    return rows;
+}
+
+void testPagination() {
+    std::vector<std::string> rows = randomRows(80000, 30, 37);
+    auto codec = codecOf(rows);
+    auto findPage = [&](const std::string& target) {
+        return [&, target](SearchCursor& cursor, size_t limit, std::vector<uint32_t>& out) {
+            return codec->findMatchesPage(target, cursor, limit, out);
+        };
+    };
+    auto prefixPage = [&](const std::string& prefix) {
+        return [&, prefix](SearchCursor& cursor, size_t limit, std::vector<uint32_t>& out) {
+            return codec->prefixSearchPage(prefix, cursor, limit, out);
+        };
+    };
+
+    for (size_t limit : {1, 7, 1000, 100000}) {
+        for (auto [begin_row, end_row] : WINDOWS) {
+            SearchCursor cursor(begin_row, end_row);
+            for (const std::string target : {"value_4", "missing"}) {
+                CHECK(allPages(cursor, limit, findPage(target)) ==
+                      inWindow(codec->findMatches(target), begin_row, end_row));
+            }
+            for (const std::string prefix : {"value_2", "value_", "zzz"}) {
+                std::vector<uint32_t> baseline = prefixBaseline(*codec, prefix);
+                CHECK(allPages(cursor, limit, prefixPage(prefix)) ==
+                      inWindow(std::vector<size_t>(baseline.begin(), baseline.end()), begin_row, end_row));
+            }
+        }
+    }
+
+    // LIMIT/OFFSET: skip matches from the cursor, then resume right after the page
+    std::vector<uint32_t> expected = prefixBaseline(*codec, "value_1");
+    std::vector<uint32_t> out;
+    SearchCursor cursor;
+    CHECK(codec->prefixSearchPage("value_1", cursor, 50, out, 1000) == 50);
+    CHECK(std::equal(out.begin(), out.end(), expected.begin() + 1000));
+    CHECK(codec->prefixSearchPage("value_1", cursor, 50, out, 10) == 50);
+    CHECK(std::equal(out.begin(), out.end(), expected.begin() + 1060));
+    std::vector<size_t> target_rows = codec->findMatches("value_9");
+    SearchCursor target_cursor;
+    CHECK(codec->findMatchesPage("value_9", target_cursor, 5, out, target_rows.size() - 3) == 3);
+    CHECK(std::equal(out.begin(), out.end(), target_rows.end() - 3));
+    CHECK(codec->findMatchesPage("value_9", target_cursor, 5, out, 0) == 0);
+
+    // A cursor finishes over the rows it started on; a fresh one sees appended rows
+    SearchCursor started;
+    codec->findMatchesPage("value_4", started, 10, out);
+    std::vector<size_t> before = codec->findMatches("value_4");
+    codec->appendValues(std::vector<std::string>(100, "value_4"));
+    std::vector<uint32_t> resumed = allPages(started, 1000, findPage("value_4"));
+    CHECK(resumed == std::vector<uint32_t>(before.begin() + 10, before.end()));
+    CHECK(allPages(SearchCursor(), 1000, findPage("value_4")) == narrowed(codec->findMatches("value_4")));
+}
+
+void testMemoAndCacheInvalidation() {
+    std::vector<std::string> rows = randomRows(60000, 2000, 38);
+    auto codec = codecOf(rows);
+    codec->enableResultCache(64 << 20);
+    // Refinements of a memoized prefix start from its IDs, so query them in that order
+    std::vector<std::string> prefixes = {"value_1", "value_12", "value_123", "value_1", "value_", "value_19", "zzz"};
+    std::vector<std::string> targets = {"value_12", "value_1234", "value_7", "missing"};
+    std::vector<uint32_t> out;
+    auto checkAll = [&] {
+        for (const auto& prefix : prefixes) {
+            std::vector<uint32_t> expected = prefixBaseline(*codec, prefix);
+            std::vector<size_t> wide(expected.begin(), expected.end());
+            CHECK(codec->countPrefix(prefix) == expected.size());
+            CHECK(flattened(codec->prefixSearchSIMD(prefix)) == expected);
+            codec->prefixSearchCached(prefix)->toPositions(out);
+            CHECK(out == expected);
+            codec->prefixSearchCached(prefix, 100, 5000)->toPositions(out);
+            CHECK(out == inWindow(wide, 100, 5000));
+        }
+        for (const auto& target : targets) {
+            std::vector<size_t> expected = codec->findMatches(target);
+            codec->findMatchesCached(target)->toPositions(out);
+            CHECK(out == narrowed(expected));
+            codec->findMatchesCached(target, 100, 5000)->toPositions(out);
+            CHECK(out == inWindow(expected, 100, 5000));
+        }
+    };
+    checkAll();
+    checkAll();  // Now served from the memo and the cache
+
+    // Appends add rows to cached results and new values to memoized prefixes
+    codec->appendValues({"value_1new", "value_12", "value_123x", "value_1234", "value_12", "zzz_first"});
+    targets.push_back("value_1new");
+    checkAll();
+    CHECK(codec->countPrefix("value_123") == prefixBaseline(*codec, "value_123").size());
+    CHECK(codec->countPrefix("zzz") == 1);
+
+    // A rewrite moves rows between values, old and new, inside and outside the prefixes
+    std::vector<std::string> rewritten(3000, "value_12");
+    rewritten.insert(rewritten.end(), 2000, "value_1rewritten");
+    rewritten.insert(rewritten.end(), 2000, "other");
+    codec->encodeSingleThread(rewritten, 50);
+    targets.push_back("value_1rewritten");
+    checkAll();
+    CHECK(codec->findMatches("value_1rewritten").size() == 2000);
+
+    // Rewriting past the end extends the column, and the open-ended results with it
+    codec->encodeSingleThread({"value_1tail", "value_7"}, codec->getDataSize());
+    targets.push_back("value_1tail");
+    checkAll();
+}
+
+}  // namespace
+
+int main() {
+    std::vector<std::pair<const char*, std::function<void()>>> tests = {
+        {"set operations", testSetOperations},
+        {"result set encodings", testResultSetEncodings},
+        {"search results", testSearchResults},
+        {"query executor", testQueryExecutor},
+        {"shared scan", testSharedScan},
+        {"completion", testCompletion},
+        {"counts", testCounts},
+        {"histograms", testHistograms},
+        {"row ranges", testRowRanges},
+        {"streaming searches", testStreamingSearches},
+        {"pagination", testPagination},
+        {"prefix memo and cache invalidation", testMemoAndCacheInvalidation},
+    };
+    for (const auto& [name, test] : tests) {
+        int before = failures;
+        try {
+            test();
+        } catch (const std::exception& e) {
+            std::cerr << name << ": unexpected exception: " << e.what() << "\n";
+            failures++;
+        }
+        std::cout << (failures == before ? "PASS " : "FAIL ") << name << "\n";
+    }
+    return failures == 0 ? 0 : 1;
+}